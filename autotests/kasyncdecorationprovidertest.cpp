@@ -0,0 +1,258 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kasyncdecorationprovider.h>
+
+#include <QMutex>
+#include <QSemaphore>
+#include <QSignalSpy>
+#include <QStandardItemModel>
+
+#include <atomic>
+
+namespace
+{
+const int SourceRole = Qt::UserRole + 1;
+}
+
+/*
+ * Checks that decorations are loaded once and then come from the cache, at the size and device
+ * pixel ratio they are asked for, and that cancelled or cleared requests never show up.
+ */
+class KAsyncDecorationProviderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testCaching();
+    void testDevicePixelRatio();
+    void testCancellation();
+    void testSharedSource();
+    void testClear();
+
+private:
+    KAsyncDecorationProvider::Loader loader();
+    QModelIndex index(int row) const;
+    QList<QSize> loadedSizes();
+
+    QStandardItemModel m_model;
+    QMutex m_mutex;
+    QList<QSize> m_loadedSizes;
+    // loads wait for it while blocking
+    std::atomic_bool m_blocking = false;
+    QSemaphore m_gate;
+    std::atomic_int m_runningLoads = 0;
+};
+
+void KAsyncDecorationProviderTest::init()
+{
+    m_model.clear();
+    for (int row = 0; row < 10; ++row) {
+        auto *item = new QStandardItem(QStringLiteral("item %1").arg(row));
+        item->setData(QStringLiteral("source %1").arg(row), SourceRole);
+        m_model.appendRow(item);
+    }
+    m_loadedSizes.clear();
+    m_blocking = false;
+    m_gate.tryAcquire(m_gate.available());
+}
+
+void KAsyncDecorationProviderTest::cleanup()
+{
+    // providers are destroyed at the end of each test, and wait for the loads in progress
+    m_blocking = false;
+    m_gate.release(100);
+}
+
+KAsyncDecorationProvider::Loader KAsyncDecorationProviderTest::loader()
+{
+    return [this](const QVariant &source, const QSize &size) {
+        Q_UNUSED(source)
+        ++m_runningLoads;
+        if (m_blocking) {
+            m_gate.acquire();
+        }
+        {
+            QMutexLocker locker(&m_mutex);
+            m_loadedSizes.append(size);
+        }
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::red);
+        --m_runningLoads;
+        return image;
+    };
+}
+
+QModelIndex KAsyncDecorationProviderTest::index(int row) const
+{
+    return m_model.index(row, 0);
+}
+
+QList<QSize> KAsyncDecorationProviderTest::loadedSizes()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_loadedSizes;
+}
+
+void KAsyncDecorationProviderTest::testCaching()
+{
+    KAsyncDecorationProvider provider(SourceRole, loader());
+    QSignalSpy readySpy(&provider, &KAsyncDecorationProvider::decorationReady);
+
+    // nothing is cached yet, the decoration gets loaded
+    QVERIFY(provider.decoration(index(0), QSize(32, 32), 1).isNull());
+    QVERIFY(provider.cachedDecoration(index(0)).isNull());
+    QTRY_COMPARE(readySpy.count(), 1);
+    QCOMPARE(readySpy.first().first().toModelIndex(), index(0));
+
+    // and is not loaded again
+    const QPixmap pixmap = provider.decoration(index(0), QSize(32, 32), 1);
+    QCOMPARE(pixmap.size(), QSize(32, 32));
+    QCOMPARE(provider.cachedDecoration(index(0)).cacheKey(), pixmap.cacheKey());
+    QCOMPARE(loadedSizes(), QList<QSize>{QSize(32, 32)});
+
+    // items are found in the cache by their source, wherever the model moved them
+    m_model.insertRow(0, new QStandardItem(QStringLiteral("new item")));
+    QCOMPARE(provider.cachedDecoration(index(1)).cacheKey(), pixmap.cacheKey());
+
+    // another size is loaded, and the cached one is used meanwhile
+    QCOMPARE(provider.decoration(index(1), QSize(64, 64), 1).cacheKey(), pixmap.cacheKey());
+    QTRY_COMPARE(readySpy.count(), 2);
+    QCOMPARE(provider.decoration(index(1), QSize(64, 64), 1).size(), QSize(64, 64));
+    QCOMPARE(loadedSizes().count(), 2);
+
+    // items without a source have no decoration
+    QVERIFY(provider.decoration(index(0), QSize(32, 32), 1).isNull());
+    QTest::qWait(50);
+    QCOMPARE(loadedSizes().count(), 2);
+}
+
+void KAsyncDecorationProviderTest::testDevicePixelRatio()
+{
+    KAsyncDecorationProvider provider(SourceRole, loader());
+    QSignalSpy readySpy(&provider, &KAsyncDecorationProvider::decorationReady);
+
+    // the loader is asked for device pixels, and the pixmap has the size asked for in device
+    // independent pixels
+    QVERIFY(provider.decoration(index(0), QSize(32, 32), 2).isNull());
+    QTRY_COMPARE(readySpy.count(), 1);
+    QCOMPARE(loadedSizes(), QList<QSize>{QSize(64, 64)});
+    const QPixmap pixmap = provider.decoration(index(0), QSize(32, 32), 2);
+    QCOMPARE(pixmap.devicePixelRatio(), 2.0);
+    QCOMPARE(pixmap.deviceIndependentSize().toSize(), QSize(32, 32));
+
+    // a view on a screen of another ratio gets its own
+    QCOMPARE(provider.decoration(index(0), QSize(32, 32), 1).cacheKey(), pixmap.cacheKey());
+    QTRY_COMPARE(readySpy.count(), 2);
+    QCOMPARE(provider.decoration(index(0), QSize(32, 32), 1).devicePixelRatio(), 1.0);
+    QCOMPARE(loadedSizes().last(), QSize(32, 32));
+}
+
+void KAsyncDecorationProviderTest::testCancellation()
+{
+    KAsyncDecorationProvider provider(SourceRole, loader());
+    QSignalSpy readySpy(&provider, &KAsyncDecorationProvider::decorationReady);
+
+    m_blocking = true;
+    for (int row = 0; row < 10; ++row) {
+        QVERIFY(provider.decoration(index(row), QSize(16, 16), 1).isNull());
+    }
+
+    // only the first items are still visible. The requests of the others are dropped, even the
+    // ones whose load already started.
+    provider.cancelRequestsOutside(index(0), index(1));
+    m_blocking = false;
+    m_gate.release(100);
+
+    QTRY_COMPARE(readySpy.count(), 2);
+    QTRY_COMPARE(m_runningLoads.load(), 0);
+    QTest::qWait(50);
+    QCOMPARE(readySpy.count(), 2);
+    QCOMPARE(readySpy.at(0).first().toModelIndex().row() + readySpy.at(1).first().toModelIndex().row(), 1);
+    QVERIFY(!provider.cachedDecoration(index(0)).isNull());
+    QVERIFY(!provider.cachedDecoration(index(1)).isNull());
+    for (int row = 2; row < 10; ++row) {
+        QVERIFY(provider.cachedDecoration(index(row)).isNull());
+    }
+
+    // and they are requested again once visible again
+    QVERIFY(provider.decoration(index(5), QSize(16, 16), 1).isNull());
+    QTRY_COMPARE(readySpy.count(), 3);
+    QCOMPARE(readySpy.last().first().toModelIndex(), index(5));
+}
+
+void KAsyncDecorationProviderTest::testSharedSource()
+{
+    m_model.item(1)->setData(QStringLiteral("source 0"), SourceRole);
+    m_model.item(3)->setData(QStringLiteral("source 2"), SourceRole);
+    KAsyncDecorationProvider provider(SourceRole, loader());
+    QSignalSpy readySpy(&provider, &KAsyncDecorationProvider::decorationReady);
+
+    // items asking while the decoration of their source is being loaded wait for the same load,
+    // and are all told when it is ready
+    m_blocking = true;
+    QVERIFY(provider.decoration(index(0), QSize(16, 16), 1).isNull());
+    QVERIFY(provider.decoration(index(1), QSize(16, 16), 1).isNull());
+    QVERIFY(provider.decoration(index(0), QSize(16, 16), 1).isNull());
+    m_blocking = false;
+    m_gate.release(100);
+    QTRY_COMPARE(readySpy.count(), 2);
+    QCOMPARE(readySpy.at(0).first().toModelIndex(), index(0));
+    QCOMPARE(readySpy.at(1).first().toModelIndex(), index(1));
+    QCOMPARE(loadedSizes().count(), 1);
+    QCOMPARE(provider.cachedDecoration(index(1)).cacheKey(), provider.cachedDecoration(index(0)).cacheKey());
+
+    // the load goes on while one of the items is still visible, and only that one is told
+    m_blocking = true;
+    m_gate.tryAcquire(m_gate.available());
+    QVERIFY(provider.decoration(index(2), QSize(16, 16), 1).isNull());
+    QVERIFY(provider.decoration(index(3), QSize(16, 16), 1).isNull());
+    provider.cancelRequestsOutside(index(3), index(9));
+    m_blocking = false;
+    m_gate.release(100);
+    QTRY_COMPARE(readySpy.count(), 3);
+    QCOMPARE(readySpy.last().first().toModelIndex(), index(3));
+    QTRY_COMPARE(m_runningLoads.load(), 0);
+    QTest::qWait(50);
+    QCOMPARE(readySpy.count(), 3);
+}
+
+void KAsyncDecorationProviderTest::testClear()
+{
+    KAsyncDecorationProvider provider(SourceRole, loader());
+    QSignalSpy readySpy(&provider, &KAsyncDecorationProvider::decorationReady);
+
+    QVERIFY(provider.decoration(index(0), QSize(16, 16), 1).isNull());
+    QTRY_COMPARE(readySpy.count(), 1);
+    QVERIFY(!provider.cachedDecoration(index(0)).isNull());
+
+    // cached decorations are thrown away, and so are the ones being loaded
+    m_blocking = true;
+    QVERIFY(provider.decoration(index(1), QSize(16, 16), 1).isNull());
+    provider.clear();
+    m_blocking = false;
+    m_gate.release(100);
+    QVERIFY(provider.cachedDecoration(index(0)).isNull());
+    QTRY_COMPARE(m_runningLoads.load(), 0);
+    QTest::qWait(50);
+    QCOMPARE(readySpy.count(), 1);
+    QVERIFY(provider.cachedDecoration(index(1)).isNull());
+
+    // and loaded again when asked for
+    QVERIFY(provider.decoration(index(0), QSize(16, 16), 1).isNull());
+    QTRY_COMPARE(readySpy.count(), 2);
+    QVERIFY(!provider.cachedDecoration(index(0)).isNull());
+}
+
+QTEST_MAIN(KAsyncDecorationProviderTest)
+
+#include "kasyncdecorationprovidertest.moc"
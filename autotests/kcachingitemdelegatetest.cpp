@@ -0,0 +1,241 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kcachingitemdelegate.h>
+
+#include <QImage>
+#include <QPainter>
+#include <QStandardItemModel>
+#include <QStyledItemDelegate>
+
+/*
+ * Delegate counting how often it is asked to paint and for size hints.
+ */
+class CountingDelegate : public QStyledItemDelegate
+{
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        ++paintCount;
+        painter->fillRect(option.rect, index.data(Qt::BackgroundRole).value<QColor>());
+    }
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        ++sizeHintCount;
+        return QStyledItemDelegate::sizeHint(option, index);
+    }
+
+    mutable int paintCount = 0;
+    mutable int sizeHintCount = 0;
+};
+
+/*
+ * Checks that size hints and painted items are cached, and thrown away when the model, the options
+ * or the caller say that they changed.
+ */
+class KCachingItemDelegateTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testSizeHintCache();
+    void testPixmapCache();
+    void testDataChanged();
+    void testRowsChanged();
+    void testInvalidateIndex();
+    void testCacheLimit();
+
+private:
+    void paint(int row, int width = 100);
+    QSize sizeHint(int row, const QFont &font = QFont());
+
+    QStandardItemModel *m_model = nullptr;
+    CountingDelegate *m_counting = nullptr;
+    KCachingItemDelegate *m_delegate = nullptr;
+    QImage m_image;
+};
+
+void KCachingItemDelegateTest::init()
+{
+    m_model = new QStandardItemModel(this);
+    for (int row = 0; row < 10; ++row) {
+        auto *item = new QStandardItem(QStringLiteral("item %1").arg(row));
+        item->setData(QColor(Qt::red), Qt::BackgroundRole);
+        m_model->appendRow(item);
+    }
+    m_counting = new CountingDelegate;
+    m_delegate = new KCachingItemDelegate(m_counting, this);
+    m_image = QImage(200, 200, QImage::Format_ARGB32_Premultiplied);
+    m_image.fill(Qt::transparent);
+}
+
+void KCachingItemDelegateTest::cleanup()
+{
+    delete m_delegate;
+    delete m_model;
+}
+
+void KCachingItemDelegateTest::paint(int row, int width)
+{
+    QStyleOptionViewItem option;
+    option.rect = QRect(0, 20 * row, width, 20);
+    QPainter painter(&m_image);
+    m_delegate->paint(&painter, option, m_model->index(row, 0));
+}
+
+QSize KCachingItemDelegateTest::sizeHint(int row, const QFont &font)
+{
+    QStyleOptionViewItem option;
+    option.font = font;
+    return m_delegate->sizeHint(option, m_model->index(row, 0));
+}
+
+void KCachingItemDelegateTest::testSizeHintCache()
+{
+    const QSize size = sizeHint(0);
+    QCOMPARE(m_counting->sizeHintCount, 1);
+    QCOMPARE(sizeHint(0), size);
+    QCOMPARE(m_counting->sizeHintCount, 1);
+
+    // other items, and the same item with options the size depends on, are measured
+    sizeHint(1);
+    QCOMPARE(m_counting->sizeHintCount, 2);
+    QFont font;
+    font.setPointSize(font.pointSize() * 2);
+    sizeHint(0, font);
+    QCOMPARE(m_counting->sizeHintCount, 3);
+
+    m_delegate->invalidate();
+    sizeHint(1);
+    QCOMPARE(m_counting->sizeHintCount, 4);
+}
+
+void KCachingItemDelegateTest::testPixmapCache()
+{
+    paint(0);
+    QCOMPARE(m_counting->paintCount, 1);
+    QCOMPARE(m_image.pixelColor(50, 10), QColor(Qt::red));
+
+    // painted from the cache, at the right place
+    m_image.fill(Qt::transparent);
+    paint(0);
+    QCOMPARE(m_counting->paintCount, 1);
+    QCOMPARE(m_image.pixelColor(50, 10), QColor(Qt::red));
+
+    // items of another size are painted again
+    paint(0, 150);
+    QCOMPARE(m_counting->paintCount, 2);
+
+    m_delegate->invalidate();
+    paint(0);
+    QCOMPARE(m_counting->paintCount, 3);
+}
+
+void KCachingItemDelegateTest::testDataChanged()
+{
+    paint(0);
+    paint(1);
+    sizeHint(0);
+    QCOMPARE(m_counting->paintCount, 2);
+    QCOMPARE(m_counting->sizeHintCount, 1);
+
+    // roles that are neither painted nor take space do not invalidate anything
+    m_model->item(0)->setToolTip(QStringLiteral("tool tip"));
+    paint(0);
+    sizeHint(0);
+    QCOMPARE(m_counting->paintCount, 2);
+    QCOMPARE(m_counting->sizeHintCount, 1);
+
+    // colors are painted, but do not take space
+    m_model->item(0)->setData(QColor(Qt::blue), Qt::BackgroundRole);
+    paint(0);
+    sizeHint(0);
+    QCOMPARE(m_counting->paintCount, 3);
+    QCOMPARE(m_counting->sizeHintCount, 1);
+    QCOMPARE(m_image.pixelColor(50, 10), QColor(Qt::blue));
+
+    // text does both, and the other items stay cached
+    m_model->item(0)->setText(QStringLiteral("other text"));
+    paint(0);
+    paint(1);
+    sizeHint(0);
+    QCOMPARE(m_counting->paintCount, 4);
+    QCOMPARE(m_counting->sizeHintCount, 2);
+}
+
+void KCachingItemDelegateTest::testRowsChanged()
+{
+    for (int row = 0; row < 4; ++row) {
+        paint(row);
+    }
+    QCOMPARE(m_counting->paintCount, 4);
+
+    // the items from the inserted row on moved
+    m_model->insertRow(2, new QStandardItem(QStringLiteral("new item")));
+    for (int row = 0; row < 4; ++row) {
+        paint(row);
+    }
+    QCOMPARE(m_counting->paintCount, 6);
+
+    m_model->removeRow(3);
+    for (int row = 0; row < 4; ++row) {
+        paint(row);
+    }
+    QCOMPARE(m_counting->paintCount, 7);
+
+    // sorting changes the layout, which may move any item
+    m_model->sort(0, Qt::DescendingOrder);
+    for (int row = 0; row < 4; ++row) {
+        paint(row);
+    }
+    QCOMPARE(m_counting->paintCount, 11);
+}
+
+void KCachingItemDelegateTest::testInvalidateIndex()
+{
+    paint(0);
+    paint(1);
+    sizeHint(0);
+    QCOMPARE(m_counting->paintCount, 2);
+
+    m_delegate->invalidate(m_model->index(0, 0));
+    paint(0);
+    paint(1);
+    QCOMPARE(m_counting->paintCount, 3);
+
+    // indexes of other models are ignored
+    QStandardItemModel otherModel(1, 1);
+    m_delegate->invalidate(otherModel.index(0, 0));
+    paint(0);
+    QCOMPARE(m_counting->paintCount, 3);
+}
+
+void KCachingItemDelegateTest::testCacheLimit()
+{
+    m_delegate->setPixmapCacheLimit(0);
+    QCOMPARE(m_delegate->pixmapCacheLimit(), 0);
+    paint(0);
+    paint(0);
+    QCOMPARE(m_counting->paintCount, 2);
+
+    // size hints are cached regardless
+    sizeHint(0);
+    sizeHint(0);
+    QCOMPARE(m_counting->sizeHintCount, 1);
+}
+
+QTEST_MAIN(KCachingItemDelegateTest)
+
+#include "kcachingitemdelegatetest.moc"
@@ -0,0 +1,141 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCATEGORIZEDLAYOUTBASELINE_P_H
+#define KCATEGORIZEDLAYOUTBASELINE_P_H
+
+#include "kcategorizedlayout_p.h"
+
+#include <QList>
+
+/*
+ * KCategorizedLayout::layoutItems() as it was before the kernels were specialized, verbatim: every
+ * item checks how the view is configured. The kernels must lay out items exactly like it, and the
+ * benchmark measures them against it.
+ */
+namespace KCategorizedLayoutBaseline
+{
+using KCategorizedLayout::Item;
+using KCategorizedLayout::Params;
+
+inline int layoutItems(const Params &params, Item *items, int count, int from = 0)
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    const int originX = params.blockX + params.leftMargin;
+    const int spacing = params.spacing;
+    const bool hasGrid = params.gridSize.isValid() && !params.gridSize.isNull();
+
+    if (params.topToBottom) {
+        // one item per row, as wide as the viewport. Right to left makes no difference here.
+        for (int i = from; i < count; ++i) {
+            Item &item = items[i];
+            if (hasGrid) {
+                item.topLeft = QPoint(originX, i * params.gridSize.height());
+            } else if (params.uniformItemSizes) {
+                item.topLeft = QPoint(originX, i * item.size.height());
+            } else {
+                const int y = i ? items[i - 1].topLeft.y() + items[i - 1].size.height() + spacing : spacing;
+                item.topLeft = QPoint(originX + spacing, y);
+            }
+            item.size.setWidth(params.viewportWidth);
+        }
+
+        const Item &last = items[count - 1];
+        if (hasGrid) {
+            return count * params.gridSize.height();
+        }
+        if (params.uniformItemSizes) {
+            return last.topLeft.y() + last.size.height();
+        }
+        return last.topLeft.y() + last.size.height() + spacing;
+    }
+
+    // right to left is left to right mirrored inside of the viewport. mirror() is its own inverse,
+    // so it also gives back the left to right position of an item that is already positioned.
+    const auto mirror = [&params, originX](int x, int width) {
+        return params.rightToLeft ? 2 * originX + params.viewportWidth - x - width : x;
+    };
+
+    if (hasGrid || params.uniformItemSizes) {
+        const QSize cellSize = hasGrid ? params.gridSize : items[0].size;
+        const int itemsPerRow = hasGrid ? qMax(params.viewportWidth / cellSize.width(), 1)
+                                        : qMax((params.viewportWidth - spacing) / qMax(cellSize.width() + spacing, 1), 1);
+        for (int i = from; i < count; ++i) {
+            const int x = originX + (i % itemsPerRow) * cellSize.width();
+            items[i].topLeft = QPoint(mirror(x, cellSize.width()), (i / itemsPerRow) * cellSize.height());
+        }
+
+        const int rows = (count - 1) / itemsPerRow + 1;
+        return rows * cellSize.height();
+    }
+
+    // items of different sizes flow into rows as long as they fit. The next row starts under the
+    // highest item of the previous one.
+    int rowTop = spacing;
+    int rowHeight = 0;
+    if (from > 0) {
+        rowTop = items[from - 1].topLeft.y();
+        rowHeight = KCategorizedLayout::lastRowHeight(items, from);
+    }
+
+    const int availableWidth = params.viewportWidth - spacing;
+    for (int i = from; i < count; ++i) {
+        Item &item = items[i];
+        const QSize size = item.size;
+        int x = originX + spacing;
+        if (i > 0) {
+            const Item &previous = items[i - 1];
+            const int previousRight = mirror(previous.topLeft.x(), previous.size.width()) + previous.size.width();
+            if (previousRight + size.width() - params.blockX + spacing > availableWidth) {
+                rowTop += rowHeight + spacing;
+                rowHeight = 0;
+            } else {
+                x = previousRight + spacing;
+            }
+        }
+        item.topLeft = QPoint(mirror(x, size.width()), rowTop);
+        rowHeight = qMax(rowHeight, size.height());
+    }
+
+    return rowTop + rowHeight + spacing;
+}
+
+/*
+ * Returns \a blockCount blocks of \a itemsPerBlock items, all of the same size if \a uniform.
+ */
+inline QList<Item> makeItems(int blockCount, int itemsPerBlock, bool uniform)
+{
+    QList<Item> items(blockCount * itemsPerBlock);
+    for (int i = 0; i < items.size(); ++i) {
+        items[i].size = uniform ? QSize(96, 64) : QSize(40 + (i * 37) % 120, 20 + (i * 13) % 60);
+    }
+    return items;
+}
+
+/*
+ * Returns the parameters of a view laying out items of \a sizing 0 on a grid, 1 all of the same
+ * size, or 2 of different sizes.
+ */
+inline Params makeParams(int sizing, bool rightToLeft, bool topToBottom)
+{
+    Params params;
+    params.blockX = 5;
+    params.leftMargin = 10;
+    params.viewportWidth = 1000;
+    params.spacing = 4;
+    params.gridSize = sizing == 0 ? QSize(110, 90) : QSize();
+    params.uniformItemSizes = sizing == 1;
+    params.rightToLeft = rightToLeft;
+    params.topToBottom = topToBottom;
+    return params;
+}
+}
+
+#endif // KCATEGORIZEDLAYOUTBASELINE_P_H
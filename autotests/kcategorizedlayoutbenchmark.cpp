@@ -0,0 +1,124 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "kcategorizedlayoutbaseline_p.h"
+
+using KCategorizedLayout::Item;
+using KCategorizedLayout::Params;
+
+namespace
+{
+const int s_blockCount = 100;
+const int s_itemsPerBlock = 5000;
+}
+
+/*
+ * Lays out a view of half a million items, in blocks, with the kernel specialized for how the view
+ * is configured and with the per item code it replaced. Then looks for the items in a rect, as
+ * rubber band selection and painting do.
+ */
+class KCategorizedLayoutBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase_data();
+
+    void benchmarkBaseline();
+    void benchmarkKernel();
+    void benchmarkFindItems();
+
+private:
+    static Params params();
+    static QList<Item> items();
+};
+
+void KCategorizedLayoutBenchmark::initTestCase_data()
+{
+    QTest::addColumn<int>("sizing");
+    QTest::addColumn<bool>("rightToLeft");
+    QTest::addColumn<bool>("topToBottom");
+
+    const char *const sizings[] = {"grid", "uniform", "variable"};
+    for (int sizing = 0; sizing < 3; ++sizing) {
+        QTest::addRow("%s, left to right", sizings[sizing]) << sizing << false << false;
+        QTest::addRow("%s, right to left", sizings[sizing]) << sizing << true << false;
+        QTest::addRow("%s, top to bottom", sizings[sizing]) << sizing << false << true;
+    }
+}
+
+Params KCategorizedLayoutBenchmark::params()
+{
+    QFETCH_GLOBAL(int, sizing);
+    QFETCH_GLOBAL(bool, rightToLeft);
+    QFETCH_GLOBAL(bool, topToBottom);
+
+    return KCategorizedLayoutBaseline::makeParams(sizing, rightToLeft, topToBottom);
+}
+
+QList<Item> KCategorizedLayoutBenchmark::items()
+{
+    QFETCH_GLOBAL(int, sizing);
+
+    return KCategorizedLayoutBaseline::makeItems(s_blockCount, s_itemsPerBlock, sizing != 2);
+}
+
+void KCategorizedLayoutBenchmark::benchmarkBaseline()
+{
+    const Params params = this->params();
+    QList<Item> items = this->items();
+
+    QBENCHMARK {
+        for (int block = 0; block < s_blockCount; ++block) {
+            KCategorizedLayoutBaseline::layoutItems(params, items.data() + block * s_itemsPerBlock, s_itemsPerBlock);
+        }
+    }
+}
+
+void KCategorizedLayoutBenchmark::benchmarkKernel()
+{
+    const Params params = this->params();
+    QList<Item> items = this->items();
+
+    QBENCHMARK {
+        const KCategorizedLayout::Kernel kernel = KCategorizedLayout::kernelFor(params);
+        for (int block = 0; block < s_blockCount; ++block) {
+            kernel(params, items.data() + block * s_itemsPerBlock, s_itemsPerBlock, 0);
+        }
+    }
+}
+
+void KCategorizedLayoutBenchmark::benchmarkFindItems()
+{
+    const Params params = this->params();
+    QList<Item> items = this->items();
+    int height = 0;
+    for (int block = 0; block < s_blockCount; ++block) {
+        height = qMax(height, KCategorizedLayout::layoutItems(params, items.data() + block * s_itemsPerBlock, s_itemsPerBlock));
+    }
+
+    // selecting everything but the leftmost column, the worst case for spans
+    const QRect rect(params.blockX + params.leftMargin + 150, 0, params.viewportWidth, height);
+    QList<KCategorizedLayout::Span> spans;
+    QBENCHMARK {
+        spans.clear();
+        for (int block = 0; block < s_blockCount; ++block) {
+            KCategorizedLayout::findItems(items.constData() + block * s_itemsPerBlock,
+                                          s_itemsPerBlock,
+                                          rect,
+                                          params.gridSize,
+                                          KCategorizedLayout::Match::Intersects,
+                                          spans);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(KCategorizedLayoutBenchmark)
+
+#include "kcategorizedlayoutbenchmark.moc"
@@ -0,0 +1,122 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "kcategorizedlayoutengine_p.h"
+
+#include <QList>
+
+using KCategorizedLayout::Params;
+
+namespace
+{
+const int s_blockCount = 100;
+const int s_rowsPerBlock = 5000;
+}
+
+/*
+ * Measures how long a model of half a million items in a hundred categories takes to be laid out
+ * from scratch, and after changes.
+ */
+class KCategorizedLayoutEngineBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkRebuild();
+    void benchmarkInsert();
+    void benchmarkResize();
+
+private:
+    void setUp(KCategorizedLayoutEngine &engine);
+    // inserts the rows of every category at once, as KCategorizedView does when rebuilding
+    void fill(KCategorizedLayoutEngine &engine);
+
+    QList<QSize> m_sizes;
+};
+
+void KCategorizedLayoutEngineBenchmark::initTestCase()
+{
+    m_sizes.reserve(s_blockCount * s_rowsPerBlock);
+    for (int i = 0; i < s_blockCount * s_rowsPerBlock; ++i) {
+        m_sizes.append(QSize(40 + (i * 37) % 120, 20 + (i * 13) % 60));
+    }
+}
+
+void KCategorizedLayoutEngineBenchmark::setUp(KCategorizedLayoutEngine &engine)
+{
+    engine.setSizeHintFunction([this](int row) {
+        return m_sizes[row];
+    });
+    engine.setHeaderHeightFunction([](int firstRow) {
+        return 20 + (firstRow / s_rowsPerBlock) % 3;
+    });
+
+    Params params;
+    params.blockX = 5;
+    params.leftMargin = 3;
+    params.viewportWidth = 700;
+    params.spacing = 2;
+    engine.setParams(params);
+}
+
+void KCategorizedLayoutEngineBenchmark::fill(KCategorizedLayoutEngine &engine)
+{
+    for (int block = 0; block < s_blockCount; ++block) {
+        engine.insertRows(block * s_rowsPerBlock, s_rowsPerBlock, block);
+    }
+}
+
+void KCategorizedLayoutEngineBenchmark::benchmarkRebuild()
+{
+    QBENCHMARK {
+        KCategorizedLayoutEngine engine;
+        setUp(engine);
+        fill(engine);
+        engine.layout();
+    }
+}
+
+void KCategorizedLayoutEngineBenchmark::benchmarkInsert()
+{
+    KCategorizedLayoutEngine engine;
+    setUp(engine);
+    fill(engine);
+    engine.layout();
+
+    // in the last block, so that only the trailing items move
+    const int row = m_sizes.count() - 100;
+    QBENCHMARK {
+        m_sizes.insert(row, QSize(60, 30));
+        engine.insertRows(row, 1, s_blockCount - 1);
+        engine.layout();
+        m_sizes.remove(row);
+        engine.removeRows(row, 1);
+        engine.layout();
+    }
+}
+
+void KCategorizedLayoutEngineBenchmark::benchmarkResize()
+{
+    KCategorizedLayoutEngine engine;
+    setUp(engine);
+    fill(engine);
+    engine.layout();
+
+    // in the first block, so that all blocks move
+    QBENCHMARK {
+        engine.resizeRows(4000, 4010);
+        engine.layout();
+    }
+}
+
+QTEST_GUILESS_MAIN(KCategorizedLayoutEngineBenchmark)
+
+#include "kcategorizedlayoutenginebenchmark.moc"
@@ -0,0 +1,949 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "kcategorizedlayoutengine_p.h"
+
+#include <QList>
+#include <QRandomGenerator>
+#include <QtEndian>
+
+using KCategorizedLayout::Params;
+
+namespace
+{
+struct Row {
+    int category;
+    QSize size;
+};
+
+QSize randomSize(QRandomGenerator &random)
+{
+    return QSize(20 + random.bounded(150), 10 + random.bounded(70));
+}
+
+// the size of all items of even categories, when they are declared to have the same size
+QSize fixedSize(int category)
+{
+    return category % 2 ? QSize() : QSize(30 + category * 7, 20 + category * 3);
+}
+}
+
+/*
+ * Checks that patching the layout engine with insertions, removals and size changes gives the
+ * same layout as building it again from scratch.
+ */
+class KCategorizedLayoutEngineTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testChanges_data();
+    void testChanges();
+    void testRefusesSplittingBlocks();
+    void testCollapsedBlocks();
+    void testSizesAreAskedOnce();
+    void testFixedSizeBlocks();
+    void testEviction();
+    void testSnapshot();
+    void testNavigation_data();
+    void testNavigation();
+    void testHiddenRows_data();
+    void testHiddenRows();
+    void testRowLimit_data();
+    void testRowLimit();
+
+private:
+    void setUp(KCategorizedLayoutEngine &engine, const Params &params, bool fixedSizeBlocks = false);
+    // inserts the rows of every category at once, as KCategorizedView does when rebuilding
+    void fill(KCategorizedLayoutEngine &engine);
+    void fillBig(int blockCount, int rowsPerBlock);
+    static Params params();
+
+    QList<Row> m_rows;
+    int m_askedSizes = 0;
+};
+
+void KCategorizedLayoutEngineTest::init()
+{
+    m_rows.clear();
+    m_askedSizes = 0;
+}
+
+void KCategorizedLayoutEngineTest::setUp(KCategorizedLayoutEngine &engine, const Params &params, bool fixedSizeBlocks)
+{
+    engine.setSizeHintFunction([this](int row) {
+        ++m_askedSizes;
+        return m_rows[row].size;
+    });
+    engine.setHeaderHeightFunction([this](int firstRow) {
+        return 20 + m_rows[firstRow].category % 3;
+    });
+    if (fixedSizeBlocks) {
+        engine.setBlockItemSizeFunction([this](int firstRow) {
+            return fixedSize(m_rows[firstRow].category);
+        });
+    }
+    engine.setParams(params);
+}
+
+void KCategorizedLayoutEngineTest::fill(KCategorizedLayoutEngine &engine)
+{
+    int first = 0;
+    while (first < m_rows.count()) {
+        int last = first;
+        while (last + 1 < m_rows.count() && m_rows[last + 1].category == m_rows[first].category) {
+            ++last;
+        }
+        QVERIFY(engine.insertRows(first, last - first + 1, m_rows[first].category));
+        first = last + 1;
+    }
+}
+
+void KCategorizedLayoutEngineTest::fillBig(int blockCount, int rowsPerBlock)
+{
+    m_rows.reserve(blockCount * rowsPerBlock);
+    for (int i = 0; i < blockCount * rowsPerBlock; ++i) {
+        m_rows.append({i / rowsPerBlock, QSize(40 + (i * 37) % 120, 20 + (i * 13) % 60)});
+    }
+}
+
+Params KCategorizedLayoutEngineTest::params()
+{
+    Params params;
+    params.blockX = 5;
+    params.leftMargin = 3;
+    params.viewportWidth = 700;
+    params.spacing = 2;
+    return params;
+}
+
+void KCategorizedLayoutEngineTest::testChanges_data()
+{
+    QTest::addColumn<QSize>("gridSize");
+    QTest::addColumn<bool>("uniformItemSizes");
+    QTest::addColumn<bool>("rightToLeft");
+    QTest::addColumn<bool>("topToBottom");
+    QTest::addColumn<bool>("fixedSizeBlocks");
+    QTest::addColumn<int>("memoryBudget");
+
+    QTest::newRow("variable") << QSize() << false << false << false << false << 0;
+    QTest::newRow("grid") << QSize(100, 80) << false << false << false << false << 0;
+    QTest::newRow("uniform") << QSize() << true << false << false << false << 0;
+    QTest::newRow("right to left") << QSize() << false << true << false << false << 0;
+    QTest::newRow("top to bottom") << QSize() << false << false << true << false << 0;
+    QTest::newRow("variable, fixed size blocks") << QSize() << false << false << false << true << 0;
+    QTest::newRow("grid, fixed size blocks") << QSize(100, 80) << false << false << false << true << 0;
+    QTest::newRow("right to left, fixed size blocks") << QSize() << false << true << false << true << 0;
+    QTest::newRow("top to bottom, fixed size blocks") << QSize() << false << false << true << true << 0;
+    QTest::newRow("variable, memory budget") << QSize() << false << false << false << false << 1000;
+    QTest::newRow("grid, memory budget") << QSize(100, 80) << false << false << false << false << 1000;
+    QTest::newRow("top to bottom, memory budget") << QSize() << false << false << true << false << 1000;
+}
+
+void KCategorizedLayoutEngineTest::testChanges()
+{
+    QFETCH(QSize, gridSize);
+    QFETCH(bool, uniformItemSizes);
+    QFETCH(bool, rightToLeft);
+    QFETCH(bool, topToBottom);
+    QFETCH(bool, fixedSizeBlocks);
+    QFETCH(int, memoryBudget);
+
+    Params params = this->params();
+    params.gridSize = gridSize;
+    params.uniformItemSizes = uniformItemSizes;
+    params.rightToLeft = rightToLeft;
+    params.topToBottom = topToBottom;
+
+    QRandomGenerator random(7);
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params, fixedSizeBlocks);
+    engine.setMemoryBudget(memoryBudget);
+    engine.setVisibleRect(QRect(0, 0, 700, 500));
+    // items of blocks declared to have the same size really have it
+    const auto sizeFor = [&](int category) {
+        if (uniformItemSizes) {
+            return QSize(50, 40);
+        }
+        return fixedSizeBlocks && fixedSize(category).isValid() ? fixedSize(category) : randomSize(random);
+    };
+
+    for (int step = 0; step < 300; ++step) {
+        const int operation = m_rows.isEmpty() ? 0 : random.bounded(4);
+        if (operation < 2) {
+            // a run of rows next to the other rows of its category, or between two blocks
+            const int category = random.bounded(12);
+            const int count = 1 + random.bounded(40);
+            int first = -1;
+            int last = -1;
+            for (int i = 0; i < m_rows.count(); ++i) {
+                if (m_rows[i].category == category) {
+                    first = first == -1 ? i : first;
+                    last = i;
+                }
+            }
+            int row;
+            if (first != -1) {
+                row = first + random.bounded(last - first + 2);
+            } else {
+                QList<int> boundaries = {0};
+                for (int i = 1; i <= m_rows.count(); ++i) {
+                    if (i == m_rows.count() || m_rows[i].category != m_rows[i - 1].category) {
+                        boundaries.append(i);
+                    }
+                }
+                row = boundaries[random.bounded(int(boundaries.count()))];
+            }
+
+            QVERIFY(engine.insertRows(row, count, category));
+            for (int i = 0; i < count; ++i) {
+                m_rows.insert(row, {category, sizeFor(category)});
+            }
+        } else if (operation == 2) {
+            const int row = random.bounded(int(m_rows.count()));
+            const int count = 1 + random.bounded(qMin(60, int(m_rows.count()) - row));
+            engine.removeRows(row, count);
+            m_rows.remove(row, count);
+        } else {
+            const int first = random.bounded(int(m_rows.count()));
+            const int last = qMin(first + random.bounded(30), int(m_rows.count()) - 1);
+            for (int i = first; i <= last; ++i) {
+                m_rows[i].size = sizeFor(m_rows[i].category);
+            }
+            engine.resizeRows(first, last);
+        }
+
+        if (step % 10) {
+            continue;
+        }
+
+        // measuring every item gives the same layout
+        KCategorizedLayoutEngine expected;
+        setUp(expected, params);
+        fill(expected);
+
+        QCOMPARE(engine.rowCount(), expected.rowCount());
+        QCOMPARE(engine.blockCount(), expected.blockCount());
+        for (int block = 0; block < expected.blockCount(); ++block) {
+            QCOMPARE(engine.blockFirstRow(block), expected.blockFirstRow(block));
+            QCOMPARE(engine.blockPosition(block), expected.blockPosition(block));
+            QCOMPARE(engine.blockHeight(block), expected.blockHeight(block));
+        }
+        for (int row = 0; row < expected.rowCount(); ++row) {
+            QCOMPARE(engine.itemRect(row), expected.itemRect(row));
+        }
+
+        const QRect rect(random.bounded(800) - 50, random.bounded(5000), 1 + random.bounded(400), 1 + random.bounded(800));
+        QList<bool> found(engine.rowCount(), false);
+        const QList<KCategorizedLayoutEngine::RowSpan> spans = engine.findRows(rect);
+        for (const KCategorizedLayoutEngine::RowSpan &span : spans) {
+            QCOMPARE(engine.blockForRow(span.first), span.block);
+            QCOMPARE(engine.blockForRow(span.last), span.block);
+            std::fill(found.begin() + span.first, found.begin() + span.last + 1, true);
+        }
+        for (int row = 0; row < engine.rowCount(); ++row) {
+            QCOMPARE(found[row], rect.intersects(engine.itemRect(row)));
+        }
+    }
+}
+
+void KCategorizedLayoutEngineTest::testRefusesSplittingBlocks()
+{
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params());
+    m_rows = {{0, QSize(10, 10)}, {0, QSize(10, 10)}, {1, QSize(10, 10)}, {1, QSize(10, 10)}, {2, QSize(10, 10)}};
+    fill(engine);
+    QCOMPARE(engine.blockCount(), 3);
+
+    // rows of category 0 after those of category 1
+    QVERIFY(!engine.insertRows(4, 1, 0));
+    // a new category in the middle of category 1
+    QVERIFY(!engine.insertRows(3, 1, 3));
+    QCOMPARE(engine.rowCount(), 5);
+    QCOMPARE(engine.blockCount(), 3);
+
+    // on either end of category 1, or between blocks
+    QVERIFY(engine.insertRows(2, 1, 1));
+    QVERIFY(engine.insertRows(5, 1, 1));
+    QVERIFY(engine.insertRows(6, 1, 3));
+    QCOMPARE(engine.blockCount(), 4);
+    QCOMPARE(engine.blockRowCount(1), 4);
+    QCOMPARE(engine.blockForRow(6), 2);
+    QCOMPARE(engine.blockForCategory(2), 3);
+
+    engine.removeRows(2, 4);
+    QCOMPARE(engine.blockCount(), 3);
+    QCOMPARE(engine.blockForCategory(1), -1);
+    QCOMPARE(engine.blockForCategory(2), 2);
+    QCOMPARE(engine.blockFirstRow(2), 3);
+}
+
+void KCategorizedLayoutEngineTest::testCollapsedBlocks()
+{
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params());
+    for (int i = 0; i < 30; ++i) {
+        m_rows.append({i / 10, QSize(50, 30)});
+    }
+    fill(engine);
+
+    const int height = engine.blockHeight(1);
+    const QPoint below = engine.blockPosition(2);
+    QVERIFY(height > 0);
+
+    engine.setBlockCollapsed(1, true);
+    QCOMPARE(engine.blockHeight(1), 0);
+    QCOMPARE(engine.blockPosition(2), below - QPoint(0, height));
+    QCOMPARE(engine.itemRect(15).height(), 0);
+
+    const QList<KCategorizedLayoutEngine::RowSpan> spans = engine.findRows(QRect(0, 0, 1000, 10000));
+    QCOMPARE(spans.count(), 2);
+    QCOMPARE(spans[0].last, 9);
+    QCOMPARE(spans[1].first, 20);
+
+    engine.setBlockCollapsed(1, false);
+    QCOMPARE(engine.blockPosition(2), below);
+}
+
+void KCategorizedLayoutEngineTest::testSizesAreAskedOnce()
+{
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params());
+    fillBig(10, 100);
+    fill(engine);
+
+    engine.layout();
+    QCOMPARE(m_askedSizes, 1000);
+
+    // only the width changes, items keep their size
+    Params params = this->params();
+    params.viewportWidth = 500;
+    engine.setParams(params);
+    QVERIFY(!engine.isLaidOut());
+    engine.layout();
+    QCOMPARE(m_askedSizes, 1000);
+
+    // only the resized rows are asked for again
+    engine.resizeRows(150, 249);
+    engine.layout();
+    QCOMPARE(m_askedSizes, 1100);
+
+    // inserted rows too
+    m_rows.insert(500, {5, QSize(10, 10)});
+    QVERIFY(engine.insertRows(500, 1, 5));
+    engine.layout();
+    QCOMPARE(m_askedSizes, 1101);
+}
+
+void KCategorizedLayoutEngineTest::testFixedSizeBlocks()
+{
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params(), true);
+    fillBig(10, 100);
+    for (Row &row : m_rows) {
+        row.size = fixedSize(row.category).isValid() ? fixedSize(row.category) : row.size;
+    }
+    fill(engine);
+
+    // only the items of odd categories are measured
+    engine.layout();
+    QCOMPARE(m_askedSizes, 500);
+    const int height = engine.blockHeight(2);
+
+    // a block no longer declared to have the same size gets measured
+    m_rows[200].category = 11;
+    engine.resizeRows(200, 200);
+    QCOMPARE(engine.blockHeight(2), height);
+    QCOMPARE(m_askedSizes, 600);
+
+    // and the other way around
+    m_rows[200].category = 2;
+    engine.resizeRows(250, 250);
+    QCOMPARE(engine.blockHeight(2), height);
+    QCOMPARE(m_askedSizes, 600);
+}
+
+void KCategorizedLayoutEngineTest::testEviction()
+{
+    fillBig(20, 500);
+    KCategorizedLayoutEngine expected;
+    setUp(expected, params());
+    fill(expected);
+    expected.layout();
+    m_askedSizes = 0;
+
+    // nothing is evicted until the engine knows what is shown
+    KCategorizedLayoutEngine unseen;
+    setUp(unseen, params());
+    fill(unseen);
+    unseen.setMemoryBudget(5 * 500 * sizeof(KCategorizedLayout::Item));
+    unseen.layout();
+    QVERIFY(unseen.visibleRect().isNull());
+    QCOMPARE(unseen.cacheStatistics().evictedBlocks, 0);
+    m_askedSizes = 0;
+
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params());
+    fill(engine);
+    engine.setMemoryBudget(5 * 500 * sizeof(KCategorizedLayout::Item));
+    engine.setVisibleRect(QRect(0, 0, 700, 500));
+    engine.layout();
+    QCOMPARE(m_askedSizes, 10000);
+
+    // blocks get evicted, the farthest first, and keep their geometry
+    KCategorizedLayoutEngine::CacheStatistics statistics = engine.cacheStatistics();
+    QVERIFY(statistics.bytes <= engine.memoryBudget());
+    QVERIFY(statistics.evictedBlocks >= 15);
+    QCOMPARE(statistics.evictions, quint64(statistics.evictedBlocks));
+    QCOMPARE(statistics.reloads, quint64(0));
+    QCOMPARE(engine.findRows(engine.visibleRect()).count(), 1);
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        QCOMPARE(engine.blockPosition(block), expected.blockPosition(block));
+        QCOMPARE(engine.blockHeight(block), expected.blockHeight(block));
+        QCOMPARE(engine.lastRowHeight(block), expected.lastRowHeight(block));
+    }
+    QCOMPARE(engine.cacheStatistics().reloads, quint64(0));
+
+    // looking at the bottom evicts the top
+    const QRect bottom(0, engine.blockPosition(19).y(), 700, engine.blockHeight(19));
+    engine.setVisibleRect(bottom);
+    QCOMPARE(engine.findRows(bottom).count(), expected.findRows(bottom).count());
+    statistics = engine.cacheStatistics();
+    QVERIFY(statistics.bytes <= engine.memoryBudget());
+    QCOMPARE(statistics.reloads, quint64(1));
+    QCOMPARE(engine.itemRect(0), expected.itemRect(0));
+    statistics = engine.cacheStatistics();
+    QCOMPARE(statistics.reloads, quint64(2));
+    QVERIFY(statistics.bytes <= engine.memoryBudget());
+    QCOMPARE(m_askedSizes, 11000);
+
+    // rects of rows do not lay evicted blocks out again, and cover their items
+    const QRect firstBlock = engine.rowsRect(0, 499);
+    QCOMPARE(firstBlock.top(), engine.blockPosition(0).y());
+    QCOMPARE(firstBlock.height(), engine.blockHeight(0));
+    QVERIFY(firstBlock.contains(expected.itemRect(0)));
+    QCOMPARE(engine.cacheStatistics().reloads, quint64(2));
+    for (const auto &[first, last] : {std::pair(9500, 9500), std::pair(9500, 9501), std::pair(9503, 9740), std::pair(9500, 9999)}) {
+        const QRect rect = engine.rowsRect(first, last);
+        for (int row = first; row <= last; ++row) {
+            QVERIFY(rect.contains(expected.itemRect(row)));
+        }
+        QCOMPARE(rect.top(), expected.itemRect(first).top());
+    }
+    QCOMPARE(engine.rowsRect(9500, 9500), expected.itemRect(9500));
+    QCOMPARE(engine.cacheStatistics().reloads, quint64(2));
+
+    // another width lays all blocks out again. Evicted ones are measured again and stay evicted,
+    // so that they never all take memory at once.
+    Params narrower = params();
+    narrower.viewportWidth = 500;
+    expected.setParams(narrower);
+    expected.layout();
+    const int evictedBlocks = engine.cacheStatistics().evictedBlocks;
+    m_askedSizes = 0;
+    engine.setParams(narrower);
+    engine.layout();
+    statistics = engine.cacheStatistics();
+    QVERIFY(statistics.evictedBlocks >= evictedBlocks);
+    QCOMPARE(statistics.reloads, quint64(2));
+    QVERIFY(statistics.bytes <= engine.memoryBudget());
+    QCOMPARE(m_askedSizes, evictedBlocks * 500);
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        QCOMPARE(engine.blockPosition(block), expected.blockPosition(block));
+        QCOMPARE(engine.blockHeight(block), expected.blockHeight(block));
+        QCOMPARE(engine.lastRowHeight(block), expected.lastRowHeight(block));
+    }
+
+    // and so does forgetting all sizes
+    const int evictedBlocksBefore = statistics.evictedBlocks;
+    m_askedSizes = 0;
+    engine.invalidate();
+    engine.layout();
+    QCOMPARE(m_askedSizes, 10000);
+    QCOMPARE(engine.cacheStatistics().evictedBlocks, evictedBlocksBefore);
+    QCOMPARE(engine.cacheStatistics().reloads, quint64(2));
+
+    // changes to the rows of evicted blocks are no reloads either
+    engine.resizeRows(0, 0);
+    engine.layout();
+    QCOMPARE(engine.cacheStatistics().reloads, quint64(2));
+
+    // unlimited again, nothing gets evicted anymore
+    engine.setMemoryBudget(0);
+    for (int row = 0; row < engine.rowCount(); ++row) {
+        QCOMPARE(engine.itemRect(row), expected.itemRect(row));
+    }
+    QCOMPARE(engine.cacheStatistics().evictedBlocks, 0);
+}
+
+void KCategorizedLayoutEngineTest::testSnapshot()
+{
+    fillBig(20, 100);
+    for (Row &row : m_rows) {
+        row.size = fixedSize(row.category).isValid() && row.category % 4 ? fixedSize(row.category) : row.size;
+    }
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params());
+    engine.setBlockItemSizeFunction([this](int firstRow) {
+        return m_rows[firstRow].category % 4 ? fixedSize(m_rows[firstRow].category) : QSize();
+    });
+    fill(engine);
+    engine.setBlockCollapsed(3, true);
+    engine.setMemoryBudget(4 * 100 * sizeof(KCategorizedLayout::Item));
+    engine.setVisibleRect(QRect(0, 0, 700, 500));
+    engine.layout();
+    QVERIFY(engine.cacheStatistics().evictedBlocks > 0);
+
+    const QByteArray snapshot = engine.saveSnapshot(42, "user data");
+
+    // nothing is measured again
+    KCategorizedLayoutEngine restored;
+    setUp(restored, params());
+    m_askedSizes = 0;
+    QByteArray userData;
+    QVERIFY(restored.restoreSnapshot(snapshot, 42, &userData));
+    QCOMPARE(userData, QByteArray("user data"));
+    QCOMPARE(restored.rowCount(), engine.rowCount());
+    QCOMPARE(restored.blockCount(), engine.blockCount());
+    QCOMPARE(restored.cacheStatistics().evictedBlocks, engine.cacheStatistics().evictedBlocks);
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        QCOMPARE(restored.blockCategory(block), engine.blockCategory(block));
+        QCOMPARE(restored.isBlockCollapsed(block), engine.isBlockCollapsed(block));
+        QCOMPARE(restored.blockPosition(block), engine.blockPosition(block));
+        QCOMPARE(restored.blockHeight(block), engine.blockHeight(block));
+        QCOMPARE(restored.lastRowHeight(block), engine.lastRowHeight(block));
+    }
+    // the first blocks were not evicted
+    const QRect rect(0, 0, 700, engine.blockPosition(2).y());
+    QVERIFY(!restored.findRows(rect).isEmpty());
+    QCOMPARE(restored.findRows(rect).count(), engine.findRows(rect).count());
+    QCOMPARE(m_askedSizes, 0);
+
+    // evicted blocks are measured when their items are needed
+    for (int row = 0; row < engine.rowCount(); ++row) {
+        QCOMPARE(restored.itemRect(row), engine.itemRect(row));
+    }
+
+    // snapshots of something else, or corrupt ones, change nothing
+    QVERIFY(!restored.restoreSnapshot(snapshot, 43));
+    for (const qsizetype size : {0, 10, 100, 1000, int(snapshot.size()) - 1}) {
+        QVERIFY(!restored.restoreSnapshot(snapshot.left(size), 42));
+    }
+    QByteArray corrupt = snapshot;
+    corrupt[17 * 4] = char(0x7f);
+    QVERIFY(!restored.restoreSnapshot(corrupt, 42));
+
+    // nothing has a negative size, and the rows of evicted blocks go down within their block
+    const auto word = [&snapshot](int index) {
+        return qFromLittleEndian<qint32>(snapshot.constData() + index * 4);
+    };
+    const auto corrupted = [&snapshot](int index, qint32 value) {
+        QByteArray corrupt = snapshot;
+        qToLittleEndian(value, corrupt.data() + index * 4);
+        return corrupt;
+    };
+    // the block table follows the header, the params, the row count and the block count
+    const int blockTable = 16;
+    const int blockWords = 9;
+    int data = blockTable + engine.blockCount() * blockWords;
+    int evictedRows = -1;
+    int evictedHeight = 0;
+    int itemSizes = -1;
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        const int flags = word(blockTable + block * blockWords + 5);
+        const int dataCount = word(blockTable + block * blockWords + 8);
+        if (flags & 0x2 && dataCount > 1 && evictedRows == -1) {
+            evictedRows = data;
+            evictedHeight = word(blockTable + block * blockWords + 3);
+        } else if (!(flags & 0x2) && dataCount && itemSizes == -1) {
+            itemSizes = data;
+        }
+        data += 2 * dataCount;
+    }
+    QVERIFY(evictedRows != -1 && itemSizes != -1);
+    QVERIFY(restored.restoreSnapshot(corrupted(evictedRows, word(evictedRows)), 42));
+    const QList<std::pair<int, qint32>> corruptions = {
+        // height and header height of the first block
+        {blockTable + 3, -1},
+        {blockTable + 4, -1},
+        // a row of an evicted block above the one before it, and one below the block
+        {evictedRows + 2, word(evictedRows) - 1},
+        {evictedRows, evictedHeight},
+        {evictedRows + 1, -1},
+        // an item without a width
+        {itemSizes, -1},
+        {itemSizes + 1, -5},
+    };
+    for (const auto &[index, value] : corruptions) {
+        QVERIFY(!restored.restoreSnapshot(corrupted(index, value), 42));
+    }
+    QCOMPARE(restored.rowCount(), engine.rowCount());
+    QCOMPARE(restored.blockCount(), engine.blockCount());
+}
+
+void KCategorizedLayoutEngineTest::testNavigation_data()
+{
+    QTest::addColumn<QSize>("gridSize");
+    QTest::addColumn<bool>("rightToLeft");
+    QTest::addColumn<bool>("topToBottom");
+    QTest::addColumn<bool>("fixedSizeBlocks");
+    QTest::addColumn<int>("memoryBudget");
+
+    QTest::newRow("variable") << QSize() << false << false << false << 0;
+    QTest::newRow("grid") << QSize(100, 80) << false << false << false << 0;
+    QTest::newRow("right to left") << QSize() << true << false << false << 0;
+    QTest::newRow("top to bottom") << QSize() << false << true << false << 0;
+    QTest::newRow("fixed size blocks") << QSize() << false << false << true << 0;
+    QTest::newRow("right to left, fixed size blocks") << QSize() << true << false << true << 0;
+    QTest::newRow("memory budget") << QSize() << false << false << false << 1000;
+}
+
+void KCategorizedLayoutEngineTest::testNavigation()
+{
+    QFETCH(QSize, gridSize);
+    QFETCH(bool, rightToLeft);
+    QFETCH(bool, topToBottom);
+    QFETCH(bool, fixedSizeBlocks);
+    QFETCH(int, memoryBudget);
+
+    Params params = this->params();
+    params.gridSize = gridSize;
+    params.rightToLeft = rightToLeft;
+    params.topToBottom = topToBottom;
+
+    QRandomGenerator random(11);
+    for (int i = 0; i < 2000; ++i) {
+        const int category = i / 100;
+        m_rows.append({category, fixedSizeBlocks && fixedSize(category).isValid() ? fixedSize(category) : randomSize(random)});
+    }
+
+    KCategorizedLayoutEngine expected;
+    setUp(expected, params, fixedSizeBlocks);
+    fill(expected);
+    expected.setBlockCollapsed(3, true);
+    expected.setBlockCollapsed(4, true);
+    expected.setBlockCollapsed(19, true);
+    expected.layout();
+
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params, fixedSizeBlocks);
+    fill(engine);
+    engine.setBlockCollapsed(3, true);
+    engine.setBlockCollapsed(4, true);
+    engine.setBlockCollapsed(19, true);
+    engine.setMemoryBudget(memoryBudget);
+    engine.setVisibleRect(QRect(0, 0, 700, 500));
+    engine.layout();
+
+    // the closest item of the nearest line, looking at every item
+    const auto closest = [&](int x, int y, bool below) {
+        int best = -1;
+        int bestTop = 0;
+        int bestDistance = 0;
+        for (int row = 0; row < expected.rowCount(); ++row) {
+            if (expected.isBlockCollapsed(expected.blockForRow(row))) {
+                continue;
+            }
+            const QRect rect = expected.itemRect(row);
+            const int top = rect.top();
+            if (below ? top <= y : top >= y) {
+                continue;
+            }
+            const int left = gridSize.isValid() ? rect.left() - (gridSize.width() - rect.width()) / 2 : rect.left();
+            const int distance = qAbs(left + (gridSize.isValid() ? gridSize.width() : rect.width()) / 2 - x);
+            if (best == -1 || (below ? top < bestTop : top > bestTop) || (top == bestTop && distance < bestDistance)) {
+                best = row;
+                bestTop = top;
+                bestDistance = distance;
+            }
+        }
+        return best;
+    };
+
+    const int height = expected.blockPosition(19).y() + expected.blockHeight(18) + 100;
+    for (int i = 0; i < 300; ++i) {
+        const int x = random.bounded(750);
+        const int y = random.bounded(-50, height);
+        QCOMPARE(engine.rowBelow(x, y), closest(x, y, true));
+        QCOMPARE(engine.rowAbove(x, y), closest(x, y, false));
+    }
+
+    // from an item to the next line and back
+    const int row = 250;
+    const QRect rect = engine.itemRect(row);
+    const int below = engine.rowBelow(rect.center().x(), rect.top());
+    QVERIFY(below > row);
+    const int above = engine.rowAbove(rect.center().x(), engine.itemRect(below).top());
+    QCOMPARE(engine.itemRect(above).top(), rect.top());
+
+    // collapsed blocks are skipped
+    const QRect lastOfBlock2 = engine.itemRect(299);
+    QCOMPARE(engine.blockForRow(engine.rowBelow(lastOfBlock2.center().x(), lastOfBlock2.top())), 5);
+    QCOMPARE(engine.rowBelow(0, expected.blockPosition(18).y() + expected.blockHeight(18)), -1);
+
+    // blocks are found from their header on, collapsed ones too
+    QCOMPARE(engine.blockAt(engine.blockPosition(0).y() - engine.blockHeaderHeight(0) - 1), -1);
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        const int top = engine.blockPosition(block).y() - engine.blockHeaderHeight(block);
+        QCOMPARE(engine.blockAt(top), block);
+        QCOMPARE(engine.blockAt(engine.blockPosition(block).y() + engine.blockHeight(block)), block);
+    }
+}
+
+void KCategorizedLayoutEngineTest::testHiddenRows_data()
+{
+    QTest::addColumn<QSize>("gridSize");
+    QTest::addColumn<bool>("uniformItemSizes");
+    QTest::addColumn<bool>("fixedSizeBlocks");
+    QTest::addColumn<int>("memoryBudget");
+
+    QTest::newRow("variable") << QSize() << false << false << 0;
+    QTest::newRow("grid") << QSize(100, 80) << false << false << 0;
+    QTest::newRow("uniform item sizes") << QSize() << true << false << 0;
+    QTest::newRow("fixed size blocks") << QSize() << false << true << 0;
+    QTest::newRow("memory budget") << QSize() << false << false << 1000;
+}
+
+void KCategorizedLayoutEngineTest::testHiddenRows()
+{
+    QFETCH(QSize, gridSize);
+    QFETCH(bool, uniformItemSizes);
+    QFETCH(bool, fixedSizeBlocks);
+    QFETCH(int, memoryBudget);
+
+    Params params = this->params();
+    params.gridSize = gridSize;
+    params.uniformItemSizes = uniformItemSizes;
+
+    QRandomGenerator random(5);
+    for (int i = 0; i < 1000; ++i) {
+        const int category = i / 100;
+        QSize size = uniformItemSizes ? QSize(50, 30) : randomSize(random);
+        if (fixedSizeBlocks && fixedSize(category).isValid()) {
+            size = fixedSize(category);
+        }
+        m_rows.append({category, size});
+    }
+    const QList<Row> rows = m_rows;
+    const auto isHidden = [](int row) {
+        // the first row, every third row of the second block, most of the third one, and a whole block
+        return row == 0 || (row >= 100 && row < 200 && row % 3 == 0) || (row >= 200 && row < 290) || (row >= 500 && row < 600);
+    };
+
+    // the same rows, without the hidden ones but with their blocks
+    QList<int> expectedRows(rows.count(), -1);
+    m_rows.clear();
+    for (int row = 0; row < rows.count(); ++row) {
+        if (!isHidden(row)) {
+            expectedRows[row] = m_rows.count();
+            m_rows.append(rows[row]);
+        }
+    }
+    KCategorizedLayoutEngine expected;
+    setUp(expected, params, fixedSizeBlocks);
+    fill(expected);
+    expected.layout();
+    m_rows = rows;
+
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params, fixedSizeBlocks);
+    fill(engine);
+    engine.setMemoryBudget(memoryBudget);
+    engine.setVisibleRect(QRect(0, 0, 700, 500));
+    QList<QRect> shownRects;
+    for (int row = 0; row < engine.rowCount(); ++row) {
+        shownRects.append(engine.itemRect(row));
+    }
+
+    for (int row = 0; row < engine.rowCount(); ++row) {
+        if (isHidden(row)) {
+            engine.setRowsHidden(row, row, true);
+        }
+    }
+    QCOMPARE(engine.blockHiddenRowCount(2), 90);
+    QCOMPARE(engine.blockHiddenRowCount(5), 100);
+    QCOMPARE(engine.blockHeight(5), 0);
+
+    // the blocks above the fully hidden one are laid out as if the hidden rows were not there
+    const int y = engine.blockPosition(5).y();
+    for (int row = 0; row < 500; ++row) {
+        QCOMPARE(engine.isRowHidden(row), isHidden(row));
+        if (isHidden(row)) {
+            QVERIFY(!engine.itemRect(row).isValid());
+        } else {
+            QCOMPARE(engine.itemRect(row), expected.itemRect(expectedRows[row]));
+        }
+    }
+
+    // and hidden rows are never found, nor navigated to
+    const QList<KCategorizedLayoutEngine::RowSpan> spans = engine.findRows(QRect(0, 0, 1000, y));
+    for (const KCategorizedLayoutEngine::RowSpan &span : spans) {
+        for (int row = span.first; row <= span.last; ++row) {
+            QVERIFY(!isHidden(row));
+        }
+    }
+    for (int i = 0; i < 200; ++i) {
+        const int x = random.bounded(750);
+        const int top = random.bounded(-50, y);
+        const int below = engine.rowBelow(x, top);
+        QVERIFY(below != -1 && !isHidden(below));
+        QCOMPARE(expectedRows[below], expected.rowBelow(x, top));
+        const int above = engine.rowAbove(x, top);
+        QVERIFY(above == -1 || !isHidden(above));
+        QCOMPARE(above == -1 ? -1 : expectedRows[above], expected.rowAbove(x, top));
+    }
+    QCOMPARE(engine.shownRow(0, true), 1);
+    QCOMPARE(engine.shownRow(0, false), -1);
+    QCOMPARE(engine.shownRow(520, true), 600);
+    QCOMPARE(engine.shownRow(520, false), 499);
+
+    // hidden rows move with the rows around them
+    m_rows.insert(150, {1, QSize(10, 10)});
+    QVERIFY(engine.insertRows(150, 1, 1));
+    QVERIFY(!engine.isRowHidden(150));
+    QVERIFY(engine.isRowHidden(151));
+    m_rows.remove(100, 10);
+    engine.removeRows(100, 10);
+    QCOMPARE(engine.blockHiddenRowCount(1), 30);
+    QVERIFY(engine.isRowHidden(141));
+    QVERIFY(!engine.isRowHidden(140));
+
+    m_rows.remove(140);
+    engine.removeRows(140, 1);
+    for (int row = 109; row >= 100; --row) {
+        m_rows.insert(100, rows[row]);
+    }
+    QVERIFY(engine.insertRows(100, 10, 1));
+
+    // showing all rows again gives back the whole layout
+    engine.setRowsHidden(0, engine.rowCount() - 1, false);
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        QCOMPARE(engine.blockHiddenRowCount(block), 0);
+    }
+    for (int row = 0; row < engine.rowCount(); ++row) {
+        QCOMPARE(engine.itemRect(row), shownRects[row]);
+    }
+}
+
+void KCategorizedLayoutEngineTest::testRowLimit_data()
+{
+    QTest::addColumn<bool>("uniformItemSizes");
+    QTest::addColumn<bool>("fixedSizeBlocks");
+    QTest::addColumn<int>("memoryBudget");
+
+    QTest::newRow("variable") << false << false << 0;
+    QTest::newRow("uniform item sizes") << true << false << 0;
+    QTest::newRow("fixed size blocks") << false << true << 0;
+    QTest::newRow("memory budget") << false << false << 1000;
+}
+
+void KCategorizedLayoutEngineTest::testRowLimit()
+{
+    QFETCH(bool, uniformItemSizes);
+    QFETCH(bool, fixedSizeBlocks);
+    QFETCH(int, memoryBudget);
+
+    Params params = this->params();
+    params.uniformItemSizes = uniformItemSizes;
+
+    QRandomGenerator random(6);
+    for (int i = 0; i < 1000; ++i) {
+        const int category = i / 100;
+        QSize size = uniformItemSizes ? QSize(50, 30) : randomSize(random);
+        if (fixedSizeBlocks && fixedSize(category).isValid()) {
+            size = fixedSize(category);
+        }
+        m_rows.append({category, size});
+    }
+
+    KCategorizedLayoutEngine engine;
+    setUp(engine, params, fixedSizeBlocks);
+    engine.setRowLimit(10);
+    fill(engine);
+    engine.setMemoryBudget(memoryBudget);
+    engine.setVisibleRect(QRect(0, 0, 700, 500));
+    engine.layout();
+
+    // capped rows are not even measured
+    QVERIFY(m_askedSizes <= 10 * 10);
+    QCOMPARE(engine.blockCappedRowCount(0), 90);
+    QVERIFY(engine.isRowCapped(10));
+    QVERIFY(!engine.isRowCapped(9));
+    QVERIFY(!engine.itemRect(10).isValid());
+
+    // the engine lays the blocks out as if they only had their first rows, or all of them when
+    // they are unlimited
+    const auto check = [&](int limit) {
+        const QList<Row> rows = m_rows;
+        QList<int> expectedRows(rows.count(), -1);
+        m_rows.clear();
+        for (int row = 0; row < rows.count(); ++row) {
+            const int block = engine.blockForRow(row);
+            if (!limit || engine.isBlockUnlimited(block) || row - engine.blockFirstRow(block) < limit) {
+                expectedRows[row] = m_rows.count();
+                m_rows.append(rows[row]);
+            }
+        }
+        KCategorizedLayoutEngine expected;
+        setUp(expected, params, fixedSizeBlocks);
+        fill(expected);
+        expected.layout();
+        m_rows = rows;
+
+        QCOMPARE(engine.blockCount(), expected.blockCount());
+        for (int block = 0; block < engine.blockCount(); ++block) {
+            QCOMPARE(engine.blockPosition(block), expected.blockPosition(block));
+            QCOMPARE(engine.blockHeight(block), expected.blockHeight(block));
+        }
+        for (int row = 0; row < rows.count(); ++row) {
+            QCOMPARE(engine.isRowCapped(row), expectedRows[row] == -1);
+            QCOMPARE(engine.itemRect(row), expectedRows[row] == -1 ? QRect() : expected.itemRect(expectedRows[row]));
+        }
+    };
+    check(10);
+
+    const int askedSizes = m_askedSizes;
+    engine.setBlockUnlimited(3, true);
+    QCOMPARE(engine.blockCappedRowCount(3), 0);
+    check(10);
+    QVERIFY(uniformItemSizes || fixedSizeBlocks || m_askedSizes > askedSizes);
+
+    // rows pushed beyond the limit lose their item, and rows pulled within it get one
+    for (int i = 0; i < 5; ++i) {
+        m_rows.insert(100, {1, QSize(10, 10)});
+    }
+    QVERIFY(engine.insertRows(100, 5, 1));
+    check(10);
+    m_rows.remove(203, 8);
+    engine.removeRows(203, 8);
+    check(10);
+    m_rows.remove(305, 20);
+    engine.removeRows(305, 20);
+    check(10);
+
+    // the limit and the unlimited blocks survive a snapshot
+    KCategorizedLayoutEngine restored;
+    setUp(restored, params, fixedSizeBlocks);
+    QVERIFY(restored.restoreSnapshot(engine.saveSnapshot(1), 1));
+    QCOMPARE(restored.rowLimit(), 10);
+    for (int row = 0; row < engine.rowCount(); ++row) {
+        QCOMPARE(restored.itemRect(row), engine.itemRect(row));
+    }
+
+    engine.setRowLimit(3);
+    check(3);
+    engine.setRowLimit(0);
+    check(0);
+}
+
+QTEST_GUILESS_MAIN(KCategorizedLayoutEngineTest)
+
+#include "kcategorizedlayoutenginetest.moc"
@@ -0,0 +1,139 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "kcategorizedlayoutbaseline_p.h"
+
+#include <algorithm>
+
+using KCategorizedLayout::Item;
+using KCategorizedLayout::Params;
+
+namespace
+{
+const int s_blockCount = 10;
+const int s_itemsPerBlock = 5000;
+}
+
+/*
+ * Checks that the kernels specialized for how the view is configured lay out items exactly like
+ * the per item code they replaced, and that looking for the items in a rect finds the right ones.
+ */
+class KCategorizedLayoutTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase_data();
+
+    void testSameLayout();
+    void testFindItems();
+
+private:
+    static Params params();
+};
+
+void KCategorizedLayoutTest::initTestCase_data()
+{
+    QTest::addColumn<int>("sizing");
+    QTest::addColumn<bool>("rightToLeft");
+    QTest::addColumn<bool>("topToBottom");
+
+    const char *const sizings[] = {"grid", "uniform", "variable"};
+    for (int sizing = 0; sizing < 3; ++sizing) {
+        QTest::addRow("%s, left to right", sizings[sizing]) << sizing << false << false;
+        QTest::addRow("%s, right to left", sizings[sizing]) << sizing << true << false;
+        QTest::addRow("%s, top to bottom", sizings[sizing]) << sizing << false << true;
+    }
+}
+
+Params KCategorizedLayoutTest::params()
+{
+    QFETCH_GLOBAL(int, sizing);
+    QFETCH_GLOBAL(bool, rightToLeft);
+    QFETCH_GLOBAL(bool, topToBottom);
+
+    return KCategorizedLayoutBaseline::makeParams(sizing, rightToLeft, topToBottom);
+}
+
+void KCategorizedLayoutTest::testSameLayout()
+{
+    QFETCH_GLOBAL(int, sizing);
+
+    const Params params = this->params();
+    QList<Item> expected = KCategorizedLayoutBaseline::makeItems(s_blockCount, s_itemsPerBlock, sizing != 2);
+    QList<Item> actual = expected;
+
+    for (int block = 0; block < s_blockCount; ++block) {
+        const int first = block * s_itemsPerBlock;
+        QCOMPARE(KCategorizedLayout::layoutItems(params, actual.data() + first, s_itemsPerBlock),
+                 KCategorizedLayoutBaseline::layoutItems(params, expected.data() + first, s_itemsPerBlock));
+    }
+
+    for (int i = 0; i < expected.size(); ++i) {
+        QCOMPARE(actual[i].topLeft, expected[i].topLeft);
+        QCOMPARE(actual[i].size, expected[i].size);
+    }
+
+    // Resuming after the first items gives the same layout as laying out everything at once.
+    const int from = s_itemsPerBlock / 3;
+    const KCategorizedLayout::Kernel kernel = KCategorizedLayout::kernelFor(params);
+    QCOMPARE(kernel(params, actual.data(), s_itemsPerBlock, from), kernel(params, actual.data(), s_itemsPerBlock, 0));
+    for (int i = 0; i < s_itemsPerBlock; ++i) {
+        QCOMPARE(actual[i].topLeft, expected[i].topLeft);
+    }
+}
+
+void KCategorizedLayoutTest::testFindItems()
+{
+    QFETCH_GLOBAL(int, sizing);
+
+    const Params params = this->params();
+    QList<Item> items = KCategorizedLayoutBaseline::makeItems(1, s_itemsPerBlock, sizing != 2);
+    const int height = KCategorizedLayout::layoutItems(params, items.data(), s_itemsPerBlock);
+
+    // items as KCategorizedView::visualRect() returns them
+    QList<QRect> rects;
+    for (const Item &item : std::as_const(items)) {
+        QRect rect(item.topLeft, item.size);
+        if (params.gridSize.isValid()) {
+            rect.setSize(item.size.boundedTo(params.gridSize));
+            rect.moveLeft(item.topLeft.x() + (params.gridSize.width() - rect.width()) / 2);
+        }
+        rects.append(rect);
+    }
+
+    const QList<QRect> scanned = {
+        QRect(0, 0, 2000, height),
+        QRect(300, height / 2, 250, 600),
+        QRect(params.blockX, 0, 1, 1),
+        QRect(-100, height - 10, 50, 50),
+    };
+    for (const QRect &rect : scanned) {
+        for (const KCategorizedLayout::Match match : {KCategorizedLayout::Match::Intersects, KCategorizedLayout::Match::Contained}) {
+            QList<KCategorizedLayout::Span> spans;
+            KCategorizedLayout::findItems(items.constData(), s_itemsPerBlock, rect, params.gridSize, match, spans);
+
+            QList<bool> found(s_itemsPerBlock, false);
+            for (int i = 0; i < spans.count(); ++i) {
+                QVERIFY(spans[i].first <= spans[i].last);
+                // spans are sorted, and not adjacent to each other
+                QVERIFY(i == 0 || spans[i - 1].last + 1 < spans[i].first);
+                std::fill(found.begin() + spans[i].first, found.begin() + spans[i].last + 1, true);
+            }
+            for (int i = 0; i < s_itemsPerBlock; ++i) {
+                const bool expected = match == KCategorizedLayout::Match::Intersects ? rect.intersects(rects[i]) : rect.contains(rects[i]);
+                QCOMPARE(found[i], expected);
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(KCategorizedLayoutTest)
+
+#include "kcategorizedlayouttest.moc"
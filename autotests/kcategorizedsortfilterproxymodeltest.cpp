@@ -0,0 +1,199 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kcategorizedsortfilterproxymodel.h>
+
+#include <QAbstractItemModelTester>
+#include <QStandardItemModel>
+#include <QStringListModel>
+
+/*
+ * List of "category/name" strings, the category of each being the part before the slash. Unlike
+ * QStandardItemModel, it can move rows.
+ */
+class CategoryListModel : public QStringListModel
+{
+public:
+    using QStringListModel::QStringListModel;
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (role == KCategorizedSortFilterProxyModel::CategorySortRole || role == KCategorizedSortFilterProxyModel::CategoryDisplayRole) {
+            return QStringListModel::data(index, Qt::DisplayRole).toString().section(QLatin1Char('/'), 0, 0);
+        }
+        return QStringListModel::data(index, role);
+    }
+};
+
+/*
+ * Checks that the rows are sorted by category, then by name, after the changes of the source model
+ * the cached category keys have to follow.
+ */
+class KCategorizedSortFilterProxyModelTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testOrder();
+    void testDataChanged();
+    void testRowsInserted();
+    void testRowsRemoved();
+    void testRowsMoved();
+    void testNaturalComparison();
+
+private:
+    static QStandardItem *makeItem(const QString &name, const QString &category);
+    static QString order(const QAbstractItemModel *model);
+    void setCategory(int sourceRow, const QString &category);
+
+    QStandardItemModel *m_model = nullptr;
+    KCategorizedSortFilterProxyModel *m_proxy = nullptr;
+    QAbstractItemModelTester *m_tester = nullptr;
+};
+
+void KCategorizedSortFilterProxyModelTest::initTestCase()
+{
+    // natural comparison depends on the collation of the locale
+    QLocale::setDefault(QLocale(QLocale::English, QLocale::UnitedStates));
+}
+
+void KCategorizedSortFilterProxyModelTest::init()
+{
+    m_model = new QStandardItemModel(this);
+    m_model->appendRow(makeItem(QStringLiteral("apple"), QStringLiteral("cat10")));
+    m_model->appendRow(makeItem(QStringLiteral("banana"), QStringLiteral("cat9")));
+    m_model->appendRow(makeItem(QStringLiteral("cherry"), QStringLiteral("cat10")));
+    m_model->appendRow(makeItem(QStringLiteral("date"), QStringLiteral("cat9")));
+    m_model->appendRow(makeItem(QStringLiteral("elder"), QStringLiteral("cat1")));
+
+    m_proxy = new KCategorizedSortFilterProxyModel(this);
+    m_proxy->setSourceModel(m_model);
+    m_proxy->setCategorizedModel(true);
+    m_proxy->sort(0);
+    m_tester = new QAbstractItemModelTester(m_proxy, QAbstractItemModelTester::FailureReportingMode::QtTest, this);
+}
+
+void KCategorizedSortFilterProxyModelTest::cleanup()
+{
+    delete m_tester;
+    delete m_proxy;
+    delete m_model;
+}
+
+QStandardItem *KCategorizedSortFilterProxyModelTest::makeItem(const QString &name, const QString &category)
+{
+    auto *item = new QStandardItem(name);
+    item->setData(category, KCategorizedSortFilterProxyModel::CategorySortRole);
+    item->setData(category, KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+    return item;
+}
+
+QString KCategorizedSortFilterProxyModelTest::order(const QAbstractItemModel *model)
+{
+    QStringList names;
+    for (int row = 0; row < model->rowCount(); ++row) {
+        names.append(model->index(row, 0).data().toString());
+    }
+    return names.join(QLatin1Char(' '));
+}
+
+void KCategorizedSortFilterProxyModelTest::setCategory(int sourceRow, const QString &category)
+{
+    // only the category roles change, which the proxy has to sort again by itself
+    m_model->item(sourceRow)->setData(category, KCategorizedSortFilterProxyModel::CategorySortRole);
+    m_model->item(sourceRow)->setData(category, KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+}
+
+void KCategorizedSortFilterProxyModelTest::testOrder()
+{
+    QCOMPARE(order(m_proxy), QStringLiteral("elder banana date apple cherry"));
+
+    m_proxy->sort(0, Qt::DescendingOrder);
+    QCOMPARE(order(m_proxy), QStringLiteral("cherry apple date banana elder"));
+}
+
+void KCategorizedSortFilterProxyModelTest::testDataChanged()
+{
+    setCategory(0, QStringLiteral("cat1"));
+    QCOMPARE(order(m_proxy), QStringLiteral("apple elder banana date cherry"));
+
+    // the name alone changes, in the same category
+    m_model->item(3)->setText(QStringLiteral("avocado"));
+    QCOMPARE(order(m_proxy), QStringLiteral("apple elder avocado banana cherry"));
+}
+
+void KCategorizedSortFilterProxyModelTest::testRowsInserted()
+{
+    m_model->appendRow(makeItem(QStringLiteral("fig"), QStringLiteral("cat9")));
+    QCOMPARE(order(m_proxy), QStringLiteral("elder banana date fig apple cherry"));
+
+    m_model->insertRow(0, makeItem(QStringLiteral("aaa"), QStringLiteral("cat10")));
+    QCOMPARE(order(m_proxy), QStringLiteral("elder banana date fig aaa apple cherry"));
+
+    // the keys of the rows after the inserted one moved with them
+    setCategory(4, QStringLiteral("cat1"));
+    QCOMPARE(order(m_proxy), QStringLiteral("date elder banana fig aaa apple cherry"));
+}
+
+void KCategorizedSortFilterProxyModelTest::testRowsRemoved()
+{
+    m_model->removeRow(1);
+    QCOMPARE(order(m_proxy), QStringLiteral("elder date apple cherry"));
+
+    // the keys of the rows after the removed one moved with them
+    setCategory(1, QStringLiteral("cat9"));
+    QCOMPARE(order(m_proxy), QStringLiteral("elder cherry date apple"));
+}
+
+void KCategorizedSortFilterProxyModelTest::testRowsMoved()
+{
+    CategoryListModel model(QStringLiteral("cat10/apple cat9/banana cat10/cherry cat9/date cat1/elder").split(QLatin1Char(' ')));
+    KCategorizedSortFilterProxyModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.setCategorizedModel(true);
+    proxy.sort(0);
+    QAbstractItemModelTester tester(&proxy, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QCOMPARE(order(&proxy), QStringLiteral("cat1/elder cat9/banana cat9/date cat10/apple cat10/cherry"));
+
+    QVERIFY(model.moveRows(QModelIndex(), 4, 1, QModelIndex(), 0));
+    QCOMPARE(order(&proxy), QStringLiteral("cat1/elder cat9/banana cat9/date cat10/apple cat10/cherry"));
+
+    // sorting the changed row again compares the categories of the rows where they are now
+    QVERIFY(model.setData(model.index(4), QStringLiteral("cat9/aaa")));
+    QCOMPARE(order(&proxy), QStringLiteral("cat1/elder cat9/aaa cat9/banana cat10/apple cat10/cherry"));
+
+    // the model only tells about the text, which the category is derived from
+    QVERIFY(model.setData(model.index(1), QStringLiteral("cat9/apple")));
+    QCOMPARE(order(&proxy), QStringLiteral("cat1/elder cat9/aaa cat9/apple cat9/banana cat10/cherry"));
+    QVERIFY(model.setData(model.index(0), QStringLiteral("cat10/elder")));
+    QCOMPARE(order(&proxy), QStringLiteral("cat9/aaa cat9/apple cat9/banana cat10/cherry cat10/elder"));
+}
+
+void KCategorizedSortFilterProxyModelTest::testNaturalComparison()
+{
+    QVERIFY(m_proxy->sortCategoriesByNaturalComparison());
+
+    m_proxy->setSortCategoriesByNaturalComparison(false);
+    QCOMPARE(order(m_proxy), QStringLiteral("elder apple cherry banana date"));
+
+    // the keys are made again for the new comparison when the categories change
+    setCategory(4, QStringLiteral("cat11"));
+    QCOMPARE(order(m_proxy), QStringLiteral("apple cherry elder banana date"));
+
+    m_proxy->setSortCategoriesByNaturalComparison(true);
+    QCOMPARE(order(m_proxy), QStringLiteral("banana date apple cherry elder"));
+}
+
+QTEST_MAIN(KCategorizedSortFilterProxyModelTest)
+
+#include "kcategorizedsortfilterproxymodeltest.moc"
@@ -0,0 +1,375 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kcategorizedsortfilterproxymodel.h>
+#include <kcategorizedview.h>
+#include <kcategorydrawer.h>
+
+#include <QListView>
+#include <QStandardItemModel>
+
+#include <memory>
+
+// counts the headers the view measures, that is, the blocks it lays out
+class CountingCategoryDrawer : public KCategoryDrawer
+{
+public:
+    using KCategoryDrawer::KCategoryDrawer;
+
+    int categoryHeight(const QModelIndex &index, const QStyleOption &option) const override
+    {
+        ++heightRequests;
+        return KCategoryDrawer::categoryHeight(index, option);
+    }
+
+    mutable int heightRequests = 0;
+};
+
+/*
+ * Checks the layout of KCategorizedView against views laid out from scratch, through the model
+ * changes and view settings it has to follow.
+ */
+class KCategorizedViewTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testLayoutSharing();
+    void testKeyboardSearch();
+    void testKeyboardSearchInBlock();
+    void testKeyboardSearchAfterChanges();
+    void testStructuralChanges();
+
+private:
+    static QStandardItem *makeItem(const QString &name, const QString &category);
+    std::unique_ptr<KCategorizedView> makeView();
+    void compareLayouts(KCategorizedView *view, KCategorizedView *reference);
+    // whether showing all rows of the first category in view shows them in other too
+    bool sharesLayout(KCategorizedView *view, KCategorizedView *other);
+    // a view whose items all fit in the viewport, with its drawer
+    std::pair<std::unique_ptr<KCategorizedView>, CountingCategoryDrawer *> makeCountingView();
+    // checks that view lays its items out like a view created from scratch
+    void compareWithFreshView(KCategorizedView *view);
+    // replaces the items with fruits, in three categories
+    void fillFruits();
+    QModelIndex indexOf(const QString &name) const;
+    // types input in view from start on, as a new search
+    static void type(QAbstractItemView *view, const QModelIndex &start, const QString &input);
+    // checks that view finds the same items as an uncategorized QListView for all inputs
+    void compareSearches(KCategorizedView *view, const QStringList &inputs);
+
+    QStandardItemModel *m_model = nullptr;
+    KCategorizedSortFilterProxyModel *m_proxy = nullptr;
+};
+
+void KCategorizedViewTest::init()
+{
+    m_model = new QStandardItemModel(this);
+    for (int row = 0; row < 15; ++row) {
+        m_model->appendRow(makeItem(QStringLiteral("item %1").arg(row, 2, 10, QLatin1Char('0')), QStringLiteral("category %1").arg(row % 3)));
+    }
+
+    m_proxy = new KCategorizedSortFilterProxyModel(this);
+    m_proxy->setSourceModel(m_model);
+    m_proxy->setCategorizedModel(true);
+    m_proxy->sort(0);
+}
+
+void KCategorizedViewTest::cleanup()
+{
+    delete m_proxy;
+    delete m_model;
+}
+
+QStandardItem *KCategorizedViewTest::makeItem(const QString &name, const QString &category)
+{
+    auto *item = new QStandardItem(name);
+    item->setData(category, KCategorizedSortFilterProxyModel::CategorySortRole);
+    item->setData(category, KCategorizedSortFilterProxyModel::CategoryDisplayRole);
+    return item;
+}
+
+std::unique_ptr<KCategorizedView> KCategorizedViewTest::makeView()
+{
+    auto view = std::make_unique<KCategorizedView>();
+    view->setModel(m_proxy);
+    view->setCategoryDrawer(new KCategoryDrawer(view.get()));
+    view->setCategoryRowLimit(3);
+    view->resize(300, 400);
+    view->show();
+    if (!QTest::qWaitForWindowExposed(view.get())) {
+        qWarning() << "view not exposed";
+    }
+    return view;
+}
+
+void KCategorizedViewTest::compareLayouts(KCategorizedView *view, KCategorizedView *reference)
+{
+    QCOMPARE(m_proxy->rowCount(), view->model()->rowCount());
+    for (int row = 0; row < m_proxy->rowCount(); ++row) {
+        const QModelIndex index = m_proxy->index(row, 0);
+        QCOMPARE(view->visualRect(index), reference->visualRect(index));
+    }
+}
+
+bool KCategorizedViewTest::sharesLayout(KCategorizedView *view, KCategorizedView *other)
+{
+    const QModelIndex representative = m_proxy->index(0, 0);
+    view->setShowAllRows(representative, true);
+    // lays the pending changes out
+    other->visualRect(representative);
+    const bool shared = other->cappedRowCount(representative) == 0;
+    view->setShowAllRows(representative, false);
+    return shared;
+}
+
+std::pair<std::unique_ptr<KCategorizedView>, CountingCategoryDrawer *> KCategorizedViewTest::makeCountingView()
+{
+    std::unique_ptr<KCategorizedView> view = makeView();
+    auto *drawer = new CountingCategoryDrawer(view.get());
+    view->setCategoryDrawer(drawer);
+    view->setCategoryRowLimit(0);
+    // a scroll bar showing up would lay all blocks out again
+    view->resize(300, 1000);
+    view->visualRect(m_proxy->index(0, 0));
+    QCoreApplication::processEvents();
+    return {std::move(view), drawer};
+}
+
+void KCategorizedViewTest::compareWithFreshView(KCategorizedView *view)
+{
+    const std::unique_ptr<KCategorizedView> fresh = makeCountingView().first;
+    compareLayouts(view, fresh.get());
+}
+
+void KCategorizedViewTest::fillFruits()
+{
+    m_model->removeRows(0, m_model->rowCount());
+    const QStringList fruits{QStringLiteral("apple"),
+                             QStringLiteral("apricot"),
+                             QStringLiteral("avocado"),
+                             QStringLiteral("banana"),
+                             QStringLiteral("blueberry"),
+                             QStringLiteral("blackberry"),
+                             QStringLiteral("cherry"),
+                             QStringLiteral("Cranberry"),
+                             QStringLiteral("date"),
+                             QStringLiteral("aubergine")};
+    for (int row = 0; row < fruits.count(); ++row) {
+        m_model->appendRow(makeItem(fruits[row], QStringLiteral("category %1").arg(row % 3)));
+    }
+}
+
+QModelIndex KCategorizedViewTest::indexOf(const QString &name) const
+{
+    return m_proxy->match(m_proxy->index(0, 0), Qt::DisplayRole, name, 1, Qt::MatchExactly).value(0);
+}
+
+void KCategorizedViewTest::type(QAbstractItemView *view, const QModelIndex &start, const QString &input)
+{
+    // an empty search starts a new one
+    view->keyboardSearch(QString());
+    view->setCurrentIndex(start);
+    for (const QChar character : input) {
+        view->keyboardSearch(QString(character));
+    }
+}
+
+void KCategorizedViewTest::compareSearches(KCategorizedView *view, const QStringList &inputs)
+{
+    QListView list;
+    list.setModel(m_proxy);
+    for (int row = 0; row < m_proxy->rowCount(); ++row) {
+        for (const QString &input : inputs) {
+            const QModelIndex start = m_proxy->index(row, 0);
+            type(view, start, input);
+            type(&list, start, input);
+            QCOMPARE(view->currentIndex(), list.currentIndex());
+        }
+    }
+}
+
+void KCategorizedViewTest::testLayoutSharing()
+{
+    std::unique_ptr<KCategorizedView> leader = makeView();
+    std::unique_ptr<KCategorizedView> follower = makeView();
+    const std::unique_ptr<KCategorizedView> reference = makeView();
+    reference->visualRect(m_proxy->index(0, 0));
+    QVERIFY(reference->cappedRowCount(m_proxy->index(0, 0)) > 0);
+
+    QVERIFY(follower->shareLayoutWith(leader.get()));
+    QVERIFY(sharesLayout(leader.get(), follower.get()));
+    QVERIFY(sharesLayout(follower.get(), leader.get()));
+    QVERIFY(!sharesLayout(leader.get(), reference.get()));
+
+    // model changes are processed once, by the leader, for both views
+    m_model->appendRow(makeItem(QStringLiteral("item 15"), QStringLiteral("category 0")));
+    m_model->insertRow(0, makeItem(QStringLiteral("item 16"), QStringLiteral("category 3")));
+    m_model->removeRows(4, 3);
+    compareLayouts(leader.get(), reference.get());
+    compareLayouts(follower.get(), reference.get());
+
+    // a setting the layout depends on diverges, the view lays its items out on its own
+    follower->setSpacing(7);
+    QTRY_VERIFY(!sharesLayout(leader.get(), follower.get()));
+    reference->setSpacing(7);
+    QTRY_COMPARE(reference->visualRect(m_proxy->index(1, 0)), follower->visualRect(m_proxy->index(1, 0)));
+    compareLayouts(follower.get(), reference.get());
+
+    // and shares the layout again once it matches again
+    follower->setSpacing(leader->spacing());
+    QTRY_VERIFY(sharesLayout(leader.get(), follower.get()));
+    reference->setSpacing(leader->spacing());
+    QTRY_COMPARE(reference->visualRect(m_proxy->index(1, 0)), follower->visualRect(m_proxy->index(1, 0)));
+    compareLayouts(follower.get(), reference.get());
+
+    // the follower takes over from the leader, with the changes it had not applied yet
+    m_model->appendRow(makeItem(QStringLiteral("item 17"), QStringLiteral("category 1")));
+    leader.reset();
+    m_model->removeRow(2);
+    compareLayouts(follower.get(), reference.get());
+    QVERIFY(!sharesLayout(follower.get(), reference.get()));
+}
+
+void KCategorizedViewTest::testKeyboardSearch()
+{
+    fillFruits();
+    const std::unique_ptr<KCategorizedView> view = makeView();
+    view->setCategoryRowLimit(0);
+    // capped items are not found, unlike in QListView
+    view->setCategoryRowLimit(0);
+
+    // typing the same key again goes to the next item starting with it, wrapping around
+    compareSearches(view.get(),
+                    {QStringLiteral("a"),
+                     QStringLiteral("aa"),
+                     QStringLiteral("aaaa"),
+                     QStringLiteral("ap"),
+                     QStringLiteral("apr"),
+                     QStringLiteral("AV"),
+                     QStringLiteral("b"),
+                     QStringLiteral("bl"),
+                     QStringLiteral("bla"),
+                     QStringLiteral("c"),
+                     QStringLiteral("cr"),
+                     QStringLiteral("d"),
+                     QStringLiteral("x"),
+                     QStringLiteral("ax")});
+}
+
+void KCategorizedViewTest::testKeyboardSearchInBlock()
+{
+    fillFruits();
+    const std::unique_ptr<KCategorizedView> view = makeView();
+    view->setCategoryRowLimit(0);
+    view->setKeyboardSearchInBlock(true);
+
+    // the block of blueberry holds apricot, blueberry and Cranberry
+    type(view.get(), indexOf(QStringLiteral("apricot")), QStringLiteral("b"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("blueberry")));
+    type(view.get(), indexOf(QStringLiteral("blueberry")), QStringLiteral("a"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("apricot")));
+    type(view.get(), indexOf(QStringLiteral("blueberry")), QStringLiteral("bb"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("blueberry")));
+    type(view.get(), indexOf(QStringLiteral("blueberry")), QStringLiteral("d"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("blueberry")));
+
+    // all items otherwise
+    view->setKeyboardSearchInBlock(false);
+    type(view.get(), indexOf(QStringLiteral("blueberry")), QStringLiteral("d"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("date")));
+}
+
+void KCategorizedViewTest::testKeyboardSearchAfterChanges()
+{
+    fillFruits();
+    const std::unique_ptr<KCategorizedView> view = makeView();
+    view->setCategoryRowLimit(0);
+    const QStringList inputs{QStringLiteral("a"), QStringLiteral("ap"), QStringLiteral("b"), QStringLiteral("d"), QStringLiteral("k"), QStringLiteral("z")};
+    compareSearches(view.get(), inputs);
+
+    // the display text of an item changes
+    m_model->findItems(QStringLiteral("date")).constFirst()->setText(QStringLiteral("zucchini"));
+    type(view.get(), m_proxy->index(0, 0), QStringLiteral("z"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("zucchini")));
+    type(view.get(), m_proxy->index(0, 0), QStringLiteral("d"));
+    QCOMPARE(view->currentIndex(), m_proxy->index(0, 0));
+    compareSearches(view.get(), inputs);
+
+    // rows are inserted
+    m_model->insertRow(2, makeItem(QStringLiteral("kiwi"), QStringLiteral("category 1")));
+    type(view.get(), m_proxy->index(0, 0), QStringLiteral("k"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("kiwi")));
+    compareSearches(view.get(), inputs);
+
+    // rows are removed
+    m_model->removeRow(m_model->findItems(QStringLiteral("apple")).constFirst()->row());
+    type(view.get(), m_proxy->index(0, 0), QStringLiteral("ap"));
+    QCOMPARE(view->currentIndex(), indexOf(QStringLiteral("apricot")));
+    compareSearches(view.get(), inputs);
+}
+
+void KCategorizedViewTest::testStructuralChanges()
+{
+    const auto [view, drawer] = makeCountingView();
+    const auto removeItem = [this](const QString &name) {
+        m_model->removeRow(m_model->findItems(name).constFirst()->row());
+    };
+    // the last block is the only one laid out again when it alone changes
+    const int blockCount = 3;
+    const QString lastCategory = QStringLiteral("category 2");
+
+    // a few rows in the middle of the last block are patched, in a single pass once the burst is over
+    drawer->heightRequests = 0;
+    m_model->appendRow(makeItem(QStringLiteral("item 03a"), lastCategory));
+    m_model->appendRow(makeItem(QStringLiteral("item 06a"), lastCategory));
+    removeItem(QStringLiteral("item 08"));
+    QCOMPARE(drawer->heightRequests, 0);
+    QCoreApplication::processEvents();
+    view->visualRect(m_proxy->index(0, 0));
+    QCOMPARE(drawer->heightRequests, 1);
+    compareWithFreshView(view.get());
+
+    // more than a quarter of the rows changing rebuilds all blocks instead, once
+    drawer->heightRequests = 0;
+    for (const QString &name : {QStringLiteral("item 02a"),
+                                QStringLiteral("item 02b"),
+                                QStringLiteral("item 02c"),
+                                QStringLiteral("item 02d"),
+                                QStringLiteral("item 02e"),
+                                QStringLiteral("item 02f")}) {
+        m_model->appendRow(makeItem(name, lastCategory));
+    }
+    removeItem(QStringLiteral("item 11"));
+    QCOMPARE(drawer->heightRequests, 0);
+    QCoreApplication::processEvents();
+    view->visualRect(m_proxy->index(0, 0));
+    QCOMPARE(drawer->heightRequests, blockCount);
+    compareWithFreshView(view.get());
+
+    // a hidden view only records that it has to rebuild its blocks, and does when shown again
+    view->hide();
+    drawer->heightRequests = 0;
+    m_model->appendRow(makeItem(QStringLiteral("item 09a"), lastCategory));
+    removeItem(QStringLiteral("item 05"));
+    QCoreApplication::processEvents();
+    QCOMPARE(drawer->heightRequests, 0);
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view.get()));
+    view->visualRect(m_proxy->index(0, 0));
+    QCOMPARE(drawer->heightRequests, blockCount);
+    compareWithFreshView(view.get());
+}
+
+QTEST_MAIN(KCategorizedViewTest)
+
+#include "kcategorizedviewtest.moc"
@@ -0,0 +1,227 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kasyncdecorationprovider.h"
+
+#include <QCache>
+#include <QHash>
+#include <QPersistentModelIndex>
+#include <QThreadPool>
+
+#include <atomic>
+
+class KAsyncDecorationProviderPrivate
+{
+public:
+    struct CachedDecoration {
+        QPixmap pixmap;
+        QSize size;
+        qreal devicePixelRatio;
+    };
+
+    struct Request {
+        quint64 id;
+        // the items waiting for the decoration, which usually is just one
+        QList<QPersistentModelIndex> indexes;
+        QSize size;
+        qreal devicePixelRatio;
+        std::shared_ptr<std::atomic_bool> cancelled;
+    };
+
+    KAsyncDecorationProviderPrivate(KAsyncDecorationProvider *qq, int sourceRole, const KAsyncDecorationProvider::Loader &loader)
+        : q(qq)
+        , sourceRole(sourceRole)
+        , loader(loader)
+    {
+        cache.setMaxCost(65536);
+    }
+
+    void request(const QString &key, const QVariant &source, const QList<QPersistentModelIndex> &indexes, const QSize &size, qreal devicePixelRatio);
+    void finished(const QString &key, quint64 id, const QImage &image);
+
+    KAsyncDecorationProvider *const q;
+    const int sourceRole;
+    const KAsyncDecorationProvider::Loader loader;
+
+    QThreadPool threadPool;
+    QCache<QString, CachedDecoration> cache;
+    QHash<QString, Request> requests;
+    quint64 lastRequestId = 0;
+    QPixmap placeholder;
+};
+
+void KAsyncDecorationProviderPrivate::request(const QString &key,
+                                              const QVariant &source,
+                                              const QList<QPersistentModelIndex> &indexes,
+                                              const QSize &size,
+                                              qreal devicePixelRatio)
+{
+    const QSize pixelSize = size * devicePixelRatio;
+
+    const Request request{++lastRequestId, indexes, size, devicePixelRatio, std::make_shared<std::atomic_bool>(false)};
+    requests.insert(key, request);
+
+    // The job only captures values and this private class, which outlives every job since the
+    // destructor waits for the pool. Cancelled jobs stay queued, but return right away.
+    const quint64 id = request.id;
+    const std::shared_ptr<std::atomic_bool> cancelled = request.cancelled;
+    threadPool.start([this, key, id, source, pixelSize, cancelled]() {
+        if (*cancelled) {
+            return;
+        }
+        const QImage image = loader(source, pixelSize);
+        if (*cancelled) {
+            return;
+        }
+        QMetaObject::invokeMethod(
+            q,
+            [this, key, id, image]() {
+                finished(key, id, image);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void KAsyncDecorationProviderPrivate::finished(const QString &key, quint64 id, const QImage &image)
+{
+    const auto it = requests.constFind(key);
+    if (it == requests.constEnd() || it->id != id) {
+        return;
+    }
+    const QList<QPersistentModelIndex> indexes = it->indexes;
+    const QSize size = it->size;
+    const qreal devicePixelRatio = it->devicePixelRatio;
+    requests.erase(it);
+
+    // Failed loads are cached as null pixmaps too, so that they are not requested over and over
+    // again while painting. The cost is in kilobytes.
+    QPixmap pixmap = QPixmap::fromImage(image);
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    const int cost = qMax(1, int(qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8 / 1024));
+    cache.insert(key, new CachedDecoration{pixmap, size, devicePixelRatio}, cost);
+
+    if (pixmap.isNull()) {
+        return;
+    }
+    for (const QPersistentModelIndex &index : indexes) {
+        if (index.isValid()) {
+            Q_EMIT q->decorationReady(index);
+        }
+    }
+}
+
+KAsyncDecorationProvider::KAsyncDecorationProvider(int sourceRole, const Loader &loader, QObject *parent)
+    : QObject(parent)
+    , d(new KAsyncDecorationProviderPrivate(this, sourceRole, loader))
+{
+}
+
+KAsyncDecorationProvider::~KAsyncDecorationProvider()
+{
+    for (auto it = d->requests.begin(); it != d->requests.end(); ++it) {
+        *it->cancelled = true;
+    }
+    d->threadPool.clear();
+    d->threadPool.waitForDone();
+}
+
+int KAsyncDecorationProvider::sourceRole() const
+{
+    return d->sourceRole;
+}
+
+QPixmap KAsyncDecorationProvider::decoration(const QModelIndex &index, const QSize &size, qreal devicePixelRatio)
+{
+    if (!index.isValid() || !size.isValid() || devicePixelRatio <= 0) {
+        return QPixmap();
+    }
+
+    const QVariant source = index.data(d->sourceRole);
+    const QString key = source.toString();
+    if (key.isEmpty()) {
+        return QPixmap();
+    }
+
+    const KAsyncDecorationProviderPrivate::CachedDecoration *cached = d->cache.object(key);
+    if (cached && cached->size == size && cached->devicePixelRatio == devicePixelRatio) {
+        return cached->pixmap;
+    }
+
+    // items sharing their source wait for the same request
+    const auto it = d->requests.find(key);
+    if (it == d->requests.end()) {
+        d->request(key, source, {QPersistentModelIndex(index)}, size, devicePixelRatio);
+    } else if (it->size != size || it->devicePixelRatio != devicePixelRatio) {
+        *it->cancelled = true;
+        QList<QPersistentModelIndex> indexes = it->indexes;
+        if (!indexes.contains(index)) {
+            indexes.append(index);
+        }
+        d->request(key, source, indexes, size, devicePixelRatio);
+    } else if (!it->indexes.contains(index)) {
+        it->indexes.append(index);
+    }
+
+    return cached ? cached->pixmap : QPixmap();
+}
+
+QPixmap KAsyncDecorationProvider::cachedDecoration(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return QPixmap();
+    }
+
+    const KAsyncDecorationProviderPrivate::CachedDecoration *cached = d->cache.object(index.data(d->sourceRole).toString());
+    return cached ? cached->pixmap : QPixmap();
+}
+
+void KAsyncDecorationProvider::cancelRequestsOutside(const QModelIndex &first, const QModelIndex &last)
+{
+    for (auto it = d->requests.begin(); it != d->requests.end();) {
+        it->indexes.removeIf([&first, &last](const QPersistentModelIndex &index) {
+            return !index.isValid() || !first.isValid() || !last.isValid() || index.parent() != first.parent() || index.row() < first.row()
+                || index.row() > last.row();
+        });
+        if (!it->indexes.isEmpty()) {
+            ++it;
+        } else {
+            *it->cancelled = true;
+            it = d->requests.erase(it);
+        }
+    }
+}
+
+QPixmap KAsyncDecorationProvider::placeholder() const
+{
+    return d->placeholder;
+}
+
+void KAsyncDecorationProvider::setPlaceholder(const QPixmap &placeholder)
+{
+    d->placeholder = placeholder;
+}
+
+int KAsyncDecorationProvider::cacheLimit() const
+{
+    return d->cache.maxCost();
+}
+
+void KAsyncDecorationProvider::setCacheLimit(int kilobytes)
+{
+    d->cache.setMaxCost(kilobytes);
+}
+
+void KAsyncDecorationProvider::clear()
+{
+    for (auto it = d->requests.begin(); it != d->requests.end(); ++it) {
+        *it->cancelled = true;
+    }
+    d->requests.clear();
+    d->cache.clear();
+}
+
+#include "moc_kasyncdecorationprovider.cpp"
@@ -0,0 +1,142 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KASYNCDECORATIONPROVIDER_H
+#define KASYNCDECORATIONPROVIDER_H
+
+#include <kitemviews_export.h>
+
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <functional>
+#include <memory>
+
+class KAsyncDecorationProviderPrivate;
+
+class QModelIndex;
+
+/*!
+ * \class KAsyncDecorationProvider
+ * \inmodule KItemViews
+ *
+ * \brief Loads the decorations of items on a thread pool, and caches them.
+ *
+ * Models whose decorations are expensive to produce, like thumbnails that have to be read from
+ * disk and decoded, block the GUI thread when the delegate asks for Qt::DecorationRole while
+ * painting. A KAsyncDecorationProvider moves that work to a thread pool instead.
+ *
+ * For every item, the provider reads the role sourceRole() on the GUI thread, for example a file
+ * path, and passes its value to the loader function on a worker thread. The value converted to a
+ * string also identifies the item in a bounded least recently used cache of pixmaps, so cached
+ * decorations survive items being moved around by the model.
+ *
+ * Until the decoration of an item is ready, placeholder() is returned. When it is ready,
+ * decorationReady() is emitted.
+ *
+ * \note The model should not return anything for Qt::DecorationRole for the items whose
+ *       decoration comes from this provider, since delegates prefer the data of the model over
+ *       the decoration the view passes in QStyleOptionViewItem::icon.
+ *
+ * \sa KCategorizedView::setDecorationProvider()
+ *
+ * \since 6.28
+ */
+class KITEMVIEWS_EXPORT KAsyncDecorationProvider : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * Function loading the decoration for the item whose sourceRole() is \a source, scaled to fit
+     * in \a size device pixels.
+     *
+     * \warning it is called on a worker thread, so it must not access the model, nor any other
+     *          object living on the GUI thread.
+     */
+    using Loader = std::function<QImage(const QVariant &source, const QSize &size)>;
+
+    /*!
+     * Creates a provider that loads decorations with \a loader from the data of the items for
+     * role \a sourceRole.
+     */
+    KAsyncDecorationProvider(int sourceRole, const Loader &loader, QObject *parent = nullptr);
+
+    /*!
+     * Destroys the provider, waiting for the decorations that are being loaded at the moment.
+     */
+    ~KAsyncDecorationProvider() override;
+
+    /*!
+     * Returns the role whose data is passed to the loader, and identifies items in the cache.
+     */
+    int sourceRole() const;
+
+    /*!
+     * Returns the decoration of \a index, fitting in \a size, for a widget whose device pixel
+     * ratio is \a devicePixelRatio, usually QWidget::devicePixelRatioF() of the view painting it.
+     * The loader is asked for \a size times \a devicePixelRatio device pixels.
+     *
+     * If the decoration is not in the cache yet, it is requested, and a null pixmap is returned.
+     * If only a decoration of another size or device pixel ratio is cached, that one is returned
+     * while the right one gets loaded.
+     */
+    QPixmap decoration(const QModelIndex &index, const QSize &size, qreal devicePixelRatio);
+
+    /*!
+     * Returns the decoration of \a index if it is in the cache, or a null pixmap otherwise. Never
+     * requests anything.
+     */
+    QPixmap cachedDecoration(const QModelIndex &index) const;
+
+    /*!
+     * Cancels the requests for items that are not between \a first and \a last, as they are no
+     * longer visible. A request for items sharing their source is kept while one of them is
+     * still between them. Requests that are already being loaded are not interrupted.
+     */
+    void cancelRequestsOutside(const QModelIndex &first, const QModelIndex &last);
+
+    /*!
+     * Returns the pixmap to draw while the decoration of an item is being loaded.
+     */
+    QPixmap placeholder() const;
+
+    /*!
+     * Sets the pixmap to draw while the decoration of an item is being loaded. A null pixmap by
+     * default, which leaves the space of the decoration empty.
+     */
+    void setPlaceholder(const QPixmap &placeholder);
+
+    /*!
+     * Returns the maximum size of the cache, in kilobytes.
+     */
+    int cacheLimit() const;
+
+    /*!
+     * Sets the maximum size of the cache to \a kilobytes. 65536 by default.
+     */
+    void setCacheLimit(int kilobytes);
+
+    /*!
+     * Throws away all cached decorations and pending requests. Call this when the decorations of
+     * the items changed without their sourceRole() changing.
+     */
+    void clear();
+
+Q_SIGNALS:
+    /*!
+     * Emitted when the decoration of \a index has been loaded, once for every item that asked for
+     * it while it was being loaded.
+     */
+    void decorationReady(const QModelIndex &index);
+
+private:
+    friend class KAsyncDecorationProviderPrivate;
+    std::unique_ptr<KAsyncDecorationProviderPrivate> const d;
+};
+
+#endif // KASYNCDECORATIONPROVIDER_H
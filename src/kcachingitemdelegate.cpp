@@ -0,0 +1,374 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kcachingitemdelegate.h"
+#include "kitemdatachange_p.h"
+
+#include <QCache>
+#include <QEvent>
+#include <QHash>
+#include <QPainter>
+#include <QPixmap>
+#include <QPointer>
+#include <QWidget>
+
+#include <algorithm>
+#include <limits>
+
+class KCachingItemDelegatePrivate
+{
+public:
+    struct ItemKey {
+        int row;
+        int column;
+        quintptr id;
+
+        friend bool operator==(const ItemKey &left, const ItemKey &right) noexcept
+        {
+            return left.row == right.row && left.column == right.column && left.id == right.id;
+        }
+
+        friend size_t qHash(const ItemKey &key, size_t seed = 0) noexcept
+        {
+            return qHashMulti(seed, key.row, key.column, key.id);
+        }
+    };
+
+    struct PixmapKey {
+        ItemKey item;
+        int state;
+        int features;
+        int position;
+        QSize size;
+        qreal devicePixelRatio;
+
+        friend bool operator==(const PixmapKey &left, const PixmapKey &right) noexcept
+        {
+            return left.item == right.item && left.state == right.state && left.features == right.features && left.position == right.position
+                && left.size == right.size && left.devicePixelRatio == right.devicePixelRatio;
+        }
+
+        friend size_t qHash(const PixmapKey &key, size_t seed = 0) noexcept
+        {
+            return qHashMulti(seed, key.item, key.state, key.features, key.position, key.size.width(), key.size.height(), key.devicePixelRatio);
+        }
+    };
+
+    struct SizeHint {
+        QSize size;
+        size_t optionKey;
+    };
+
+    KCachingItemDelegatePrivate(KCachingItemDelegate *qq, QAbstractItemDelegate *delegate)
+        : q(qq)
+        , delegate(delegate)
+    {
+        pixmaps.setMaxCost(16384);
+    }
+
+    static ItemKey itemKey(const QModelIndex &index);
+
+    /*!
+     * Returns a key for the parts of \a option that the size hint of an item depends on.
+     */
+    static size_t sizeHintOptionKey(const QStyleOptionViewItem &option);
+
+    /*!
+     * Starts watching the model of \a index and the widget of \a option for changes that
+     * invalidate the cache, if not done yet.
+     */
+    void watch(const QStyleOptionViewItem &option, const QModelIndex &index);
+
+    bool isWatching(const QObject *widget) const;
+
+    /*!
+     * Throws away the cached data of the rows from \a first to \a last, depending on whether
+     * \a roles affect the size hint or what is painted.
+     */
+    void invalidateRows(int first, int last, const QList<int> &roles = QList<int>());
+
+    void clear();
+
+    KCachingItemDelegate *const q;
+    QAbstractItemDelegate *const delegate;
+
+    QPointer<const QAbstractItemModel> model;
+    QList<QMetaObject::Connection> modelConnections;
+    QList<QPointer<const QWidget>> widgets;
+
+    QHash<ItemKey, SizeHint> sizeHints;
+    QCache<PixmapKey, QPixmap> pixmaps;
+};
+
+KCachingItemDelegatePrivate::ItemKey KCachingItemDelegatePrivate::itemKey(const QModelIndex &index)
+{
+    // row, column and internal id identify an index within its model, as QModelIndex::operator==
+    // does, without asking the model for the parent
+    return ItemKey{index.row(), index.column(), index.internalId()};
+}
+
+size_t KCachingItemDelegatePrivate::sizeHintOptionKey(const QStyleOptionViewItem &option)
+{
+    const int wrapWidth = option.features & QStyleOptionViewItem::WrapText ? option.rect.width() : -1;
+    return qHashMulti(0,
+                      option.font,
+                      option.decorationSize.width(),
+                      option.decorationSize.height(),
+                      int(option.decorationPosition),
+                      int(option.displayAlignment),
+                      int(option.features),
+                      wrapWidth);
+}
+
+void KCachingItemDelegatePrivate::watch(const QStyleOptionViewItem &option, const QModelIndex &index)
+{
+    const QAbstractItemModel *indexModel = index.model();
+    if (indexModel != model) {
+        for (const QMetaObject::Connection &connection : std::as_const(modelConnections)) {
+            QObject::disconnect(connection);
+        }
+        modelConnections.clear();
+        clear();
+
+        model = indexModel;
+        if (model) {
+            const auto invalidateFrom = [this](const QModelIndex &, int first) {
+                invalidateRows(first, std::numeric_limits<int>::max());
+            };
+            const auto invalidateAll = [this]() {
+                clear();
+            };
+            modelConnections = {
+                QObject::connect(model,
+                                 &QAbstractItemModel::dataChanged,
+                                 q,
+                                 [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                                     invalidateRows(topLeft.row(), bottomRight.row(), roles);
+                                 }),
+                QObject::connect(model, &QAbstractItemModel::rowsInserted, q, invalidateFrom),
+                QObject::connect(model, &QAbstractItemModel::rowsRemoved, q, invalidateFrom),
+                QObject::connect(model, &QAbstractItemModel::rowsMoved, q, invalidateAll),
+                QObject::connect(model, &QAbstractItemModel::columnsInserted, q, invalidateAll),
+                QObject::connect(model, &QAbstractItemModel::columnsRemoved, q, invalidateAll),
+                QObject::connect(model, &QAbstractItemModel::columnsMoved, q, invalidateAll),
+                QObject::connect(model, &QAbstractItemModel::layoutChanged, q, invalidateAll),
+                QObject::connect(model, &QAbstractItemModel::modelReset, q, invalidateAll),
+            };
+        }
+    }
+
+    if (option.widget && !isWatching(option.widget)) {
+        widgets.removeIf([](const QPointer<const QWidget> &widget) {
+            return widget.isNull();
+        });
+        widgets.append(option.widget);
+        const_cast<QWidget *>(option.widget)->installEventFilter(q);
+    }
+}
+
+bool KCachingItemDelegatePrivate::isWatching(const QObject *widget) const
+{
+    return std::any_of(widgets.cbegin(), widgets.cend(), [widget](const QPointer<const QWidget> &watched) {
+        return watched.data() == widget;
+    });
+}
+
+void KCachingItemDelegatePrivate::invalidateRows(int first, int last, const QList<int> &roles)
+{
+    const KItemDataChange::Effect effect = KItemDataChange::effectOf(roles);
+    const bool affectsPainting = effect != KItemDataChange::Effect::None;
+    const bool affectsSizeHint = effect == KItemDataChange::Effect::Geometry;
+
+    if (affectsSizeHint) {
+        sizeHints.removeIf([first, last](const std::pair<const ItemKey &, SizeHint &> &entry) {
+            return entry.first.row >= first && entry.first.row <= last;
+        });
+    }
+
+    if (affectsPainting) {
+        const QList<PixmapKey> keys = pixmaps.keys();
+        for (const PixmapKey &key : keys) {
+            if (key.item.row >= first && key.item.row <= last) {
+                pixmaps.remove(key);
+            }
+        }
+    }
+}
+
+void KCachingItemDelegatePrivate::clear()
+{
+    sizeHints.clear();
+    pixmaps.clear();
+}
+
+KCachingItemDelegate::KCachingItemDelegate(QAbstractItemDelegate *delegate, QObject *parent)
+    : QAbstractItemDelegate(parent)
+    , d(new KCachingItemDelegatePrivate(this, delegate))
+{
+    Q_ASSERT(delegate);
+    delegate->setParent(this);
+
+    connect(delegate, &QAbstractItemDelegate::commitData, this, &QAbstractItemDelegate::commitData);
+    connect(delegate, &QAbstractItemDelegate::closeEditor, this, &QAbstractItemDelegate::closeEditor);
+    connect(delegate, &QAbstractItemDelegate::sizeHintChanged, this, [this](const QModelIndex &index) {
+        d->invalidateRows(index.row(), index.row());
+        Q_EMIT sizeHintChanged(index);
+    });
+}
+
+KCachingItemDelegate::~KCachingItemDelegate()
+{
+    for (const QMetaObject::Connection &connection : std::as_const(d->modelConnections)) {
+        disconnect(connection);
+    }
+}
+
+QAbstractItemDelegate *KCachingItemDelegate::delegate() const
+{
+    return d->delegate;
+}
+
+int KCachingItemDelegate::pixmapCacheLimit() const
+{
+    return d->pixmaps.maxCost();
+}
+
+void KCachingItemDelegate::setPixmapCacheLimit(int kilobytes)
+{
+    d->pixmaps.setMaxCost(qMax(0, kilobytes));
+}
+
+void KCachingItemDelegate::invalidate()
+{
+    d->clear();
+}
+
+void KCachingItemDelegate::invalidate(const QModelIndex &index)
+{
+    if (index.isValid() && index.model() == d->model) {
+        d->invalidateRows(index.row(), index.row(), {Qt::DecorationRole});
+    }
+}
+
+void KCachingItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const QSize size = option.rect.size();
+    if (!index.isValid() || size.isEmpty() || d->pixmaps.maxCost() <= 0 || (option.state & QStyle::State_Editing)) {
+        d->delegate->paint(painter, option, index);
+        return;
+    }
+
+    d->watch(option, index);
+
+    const qreal devicePixelRatio = painter->device() ? painter->device()->devicePixelRatio() : qreal(1);
+    const KCachingItemDelegatePrivate::PixmapKey key{KCachingItemDelegatePrivate::itemKey(index),
+                                                     int(option.state),
+                                                     int(option.features),
+                                                     int(option.viewItemPosition),
+                                                     size,
+                                                     devicePixelRatio};
+    if (const QPixmap *cached = d->pixmaps.object(key)) {
+        painter->drawPixmap(option.rect.topLeft(), *cached);
+        return;
+    }
+
+    QPixmap pixmap(size * devicePixelRatio);
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    pixmap.fill(Qt::transparent);
+    {
+        QPainter pixmapPainter(&pixmap);
+        pixmapPainter.setRenderHints(painter->renderHints());
+        QStyleOptionViewItem pixmapOption(option);
+        pixmapOption.rect.moveTopLeft(QPoint(0, 0));
+        d->delegate->paint(&pixmapPainter, pixmapOption, index);
+    }
+    painter->drawPixmap(option.rect.topLeft(), pixmap);
+
+    // the cost is in kilobytes
+    const int cost = qMax(1, int(qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8 / 1024));
+    d->pixmaps.insert(key, new QPixmap(pixmap), cost);
+}
+
+QSize KCachingItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return d->delegate->sizeHint(option, index);
+    }
+
+    d->watch(option, index);
+
+    const KCachingItemDelegatePrivate::ItemKey key = KCachingItemDelegatePrivate::itemKey(index);
+    const size_t optionKey = KCachingItemDelegatePrivate::sizeHintOptionKey(option);
+    const auto it = d->sizeHints.constFind(key);
+    if (it != d->sizeHints.constEnd() && it->optionKey == optionKey) {
+        return it->size;
+    }
+
+    const QSize size = d->delegate->sizeHint(option, index);
+    d->sizeHints.insert(key, {size, optionKey});
+    return size;
+}
+
+QWidget *KCachingItemDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    return d->delegate->createEditor(parent, option, index);
+}
+
+void KCachingItemDelegate::destroyEditor(QWidget *editor, const QModelIndex &index) const
+{
+    d->delegate->destroyEditor(editor, index);
+}
+
+void KCachingItemDelegate::setEditorData(QWidget *editor, const QModelIndex &index) const
+{
+    d->delegate->setEditorData(editor, index);
+}
+
+void KCachingItemDelegate::setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const
+{
+    d->delegate->setModelData(editor, model, index);
+}
+
+void KCachingItemDelegate::updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    d->delegate->updateEditorGeometry(editor, option, index);
+}
+
+bool KCachingItemDelegate::editorEvent(QEvent *event, QAbstractItemModel *model, const QStyleOptionViewItem &option, const QModelIndex &index)
+{
+    return d->delegate->editorEvent(event, model, option, index);
+}
+
+bool KCachingItemDelegate::helpEvent(QHelpEvent *event, QAbstractItemView *view, const QStyleOptionViewItem &option, const QModelIndex &index)
+{
+    return d->delegate->helpEvent(event, view, option, index);
+}
+
+bool KCachingItemDelegate::eventFilter(QObject *watched, QEvent *event)
+{
+    if (!d->isWatching(watched)) {
+        // views install their delegate as event filter on editors. Let the wrapped delegate handle
+        // those events, as it would without us in between.
+        return static_cast<QObject *>(d->delegate)->eventFilter(watched, event);
+    }
+
+    switch (event->type()) {
+    case QEvent::StyleChange:
+    case QEvent::PaletteChange:
+    case QEvent::FontChange:
+    case QEvent::LayoutDirectionChange:
+    case QEvent::LocaleChange:
+        d->clear();
+        break;
+    default:
+        break;
+    }
+
+    return QAbstractItemDelegate::eventFilter(watched, event);
+}
+
+#include "moc_kcachingitemdelegate.cpp"
@@ -0,0 +1,117 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCACHINGITEMDELEGATE_H
+#define KCACHINGITEMDELEGATE_H
+
+#include <kitemviews_export.h>
+
+#include <QAbstractItemDelegate>
+#include <memory>
+
+class KCachingItemDelegatePrivate;
+
+/*!
+ * \class KCachingItemDelegate
+ * \inmodule KItemViews
+ *
+ * \brief Wraps another delegate, caching its size hints and what it paints.
+ *
+ * Views ask for the size hint of the same item many times while laying out, and repaint the same
+ * items over and over while scrolling. For delegates like QStyledItemDelegate that means shaping
+ * the same text again every time. KCachingItemDelegate remembers the size hint of every item, and
+ * keeps what the wrapped delegate painted for an item as a pixmap in a bounded cache, keyed by
+ * the row and column of the item, the state and features of the style option, the size of the
+ * item and the device pixel ratio.
+ *
+ * Cached data of an item is thrown away when the model reports that its data changed, and
+ * everything is thrown away when rows are inserted, removed or moved, when the model is reset or
+ * when the style, palette or font of the view change. Editing is forwarded to the wrapped
+ * delegate as is.
+ *
+ * \code
+ *     view->setItemDelegate(new KCachingItemDelegate(new QStyledItemDelegate(view), view));
+ * \endcode
+ *
+ * \note what the wrapped delegate paints is clipped to the rect of the item. Delegates that paint
+ *       depending on anything else than the data of the item and the style option, like the
+ *       position of the mouse inside of the item, should not be wrapped.
+ *
+ * \since 6.28
+ */
+class KITEMVIEWS_EXPORT KCachingItemDelegate : public QAbstractItemDelegate
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a delegate that caches what \a delegate does. The wrapped delegate is reparented to
+     * this one.
+     */
+    explicit KCachingItemDelegate(QAbstractItemDelegate *delegate, QObject *parent = nullptr);
+    ~KCachingItemDelegate() override;
+
+    /*!
+     * Returns the wrapped delegate.
+     */
+    QAbstractItemDelegate *delegate() const;
+
+    /*!
+     * Returns the maximum size of the cache of painted items, in kilobytes.
+     */
+    int pixmapCacheLimit() const;
+
+    /*!
+     * Sets the maximum size of the cache of painted items to \a kilobytes. 0 disables caching
+     * what the wrapped delegate paints. 16384 by default.
+     */
+    void setPixmapCacheLimit(int kilobytes);
+
+    /*!
+     * Throws away all cached size hints and painted items. Call this when something the wrapped
+     * delegate depends on changed, and the model did not report it.
+     */
+    void invalidate();
+
+    /*!
+     * Throws away the cached size hint and painted pixmaps of \a index. Call this when what the
+     * wrapped delegate paints for the item changed, and the model did not report it, for example
+     * when the view passes a decoration it got from elsewhere than the model in the style option.
+     *
+     * \sa KAsyncDecorationProvider
+     *
+     * \since 6.28
+     */
+    void invalidate(const QModelIndex &index);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    void destroyEditor(QWidget *editor, const QModelIndex &index) const override;
+
+    void setEditorData(QWidget *editor, const QModelIndex &index) const override;
+
+    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override;
+
+    void updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    bool editorEvent(QEvent *event, QAbstractItemModel *model, const QStyleOptionViewItem &option, const QModelIndex &index) override;
+
+    bool helpEvent(QHelpEvent *event, QAbstractItemView *view, const QStyleOptionViewItem &option, const QModelIndex &index) override;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    friend class KCachingItemDelegatePrivate;
+    std::unique_ptr<KCachingItemDelegatePrivate> const d;
+};
+
+#endif // KCACHINGITEMDELEGATE_H
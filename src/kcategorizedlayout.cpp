@@ -0,0 +1,609 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kcategorizedlayout_p.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KCATEGORIZEDLAYOUT_SSE2 1
+#endif
+
+namespace
+{
+using KCategorizedLayout::Item;
+using KCategorizedLayout::Match;
+using KCategorizedLayout::Params;
+using KCategorizedLayout::Span;
+
+// the scans load items as four consecutive ints: x, y, width and height
+static_assert(sizeof(Item) == 4 * sizeof(int), "Item is expected to hold four ints");
+
+enum class Sizing {
+    Grid,
+    Uniform,
+    Variable,
+};
+
+// Right to left is left to right mirrored inside of the viewport, around \a axis. Mirroring is its
+// own inverse, so this also gives back the left to right position of an item already positioned.
+template<bool rightToLeft>
+inline int mirrored(int x, int width, int axis)
+{
+    if constexpr (rightToLeft) {
+        return axis - x - width;
+    } else {
+        Q_UNUSED(width);
+        Q_UNUSED(axis);
+        return x;
+    }
+}
+
+// One item per row, as wide as the viewport. Right to left makes no difference here.
+template<Sizing sizing>
+int layoutTopToBottom(const Params &params, Item *items, int count, int from)
+{
+    const int x = params.blockX + params.leftMargin;
+    const int viewportWidth = params.viewportWidth;
+
+    if constexpr (sizing == Sizing::Variable) {
+        const int spacing = params.spacing;
+        int y = from ? items[from - 1].topLeft.y() + items[from - 1].size.height() + spacing : spacing;
+        for (int i = from; i < count; ++i) {
+            Item &item = items[i];
+            item.topLeft = QPoint(x + spacing, y);
+            y += item.size.height() + spacing;
+            item.size.setWidth(viewportWidth);
+        }
+        return y;
+    } else {
+        const int rowHeight = sizing == Sizing::Grid ? params.gridSize.height() : items[0].size.height();
+        int y = from * rowHeight;
+        for (int i = from; i < count; ++i) {
+            Item &item = items[i];
+            item.topLeft = QPoint(x, y);
+            y += rowHeight;
+            item.size.setWidth(viewportWidth);
+        }
+        return count * rowHeight;
+    }
+}
+
+// Items of the same size, or grid cells, filling rows.
+template<Sizing sizing, bool rightToLeft>
+int layoutCells(const Params &params, Item *items, int count, int from)
+{
+    const int originX = params.blockX + params.leftMargin;
+    const int axis = 2 * originX + params.viewportWidth;
+    const QSize cellSize = sizing == Sizing::Grid ? params.gridSize : items[0].size;
+    const int cellWidth = qMax(cellSize.width(), 1);
+    const int cellHeight = cellSize.height();
+    const int itemsPerRow = sizing == Sizing::Grid ? qMax(params.viewportWidth / cellWidth, 1)
+                                                   : qMax((params.viewportWidth - params.spacing) / qMax(cellWidth + params.spacing, 1), 1);
+
+    int column = from % itemsPerRow;
+    int y = (from / itemsPerRow) * cellHeight;
+    for (int i = from; i < count; ++i) {
+        items[i].topLeft = QPoint(mirrored<rightToLeft>(originX + column * cellSize.width(), cellSize.width(), axis), y);
+        if (++column == itemsPerRow) {
+            column = 0;
+            y += cellHeight;
+        }
+    }
+
+    return ((count - 1) / itemsPerRow + 1) * cellHeight;
+}
+
+// Items of different sizes flowing into rows as long as they fit. The next row starts under the
+// highest item of the previous one.
+template<bool rightToLeft>
+int layoutFlow(const Params &params, Item *items, int count, int from)
+{
+    const int blockX = params.blockX;
+    const int spacing = params.spacing;
+    const int originX = blockX + params.leftMargin;
+    const int axis = 2 * originX + params.viewportWidth;
+    const int availableWidth = params.viewportWidth - spacing;
+
+    int rowTop = spacing;
+    int rowHeight = 0;
+    int previousRight = 0;
+    if (from > 0) {
+        const Item &previous = items[from - 1];
+        rowTop = previous.topLeft.y();
+        rowHeight = KCategorizedLayout::lastRowHeight(items, from);
+        previousRight = mirrored<rightToLeft>(previous.topLeft.x(), previous.size.width(), axis) + previous.size.width();
+    }
+
+    for (int i = from; i < count; ++i) {
+        Item &item = items[i];
+        const int width = item.size.width();
+        int x = originX + spacing;
+        if (i > 0) {
+            if (previousRight + width - blockX + spacing > availableWidth) {
+                rowTop += rowHeight + spacing;
+                rowHeight = 0;
+            } else {
+                x = previousRight + spacing;
+            }
+        }
+        item.topLeft = QPoint(mirrored<rightToLeft>(x, width, axis), rowTop);
+        rowHeight = qMax(rowHeight, item.size.height());
+        previousRight = x + width;
+    }
+
+    return rowTop + rowHeight + spacing;
+}
+
+Sizing sizingFor(const Params &params)
+{
+    if (params.gridSize.isValid() && !params.gridSize.isNull()) {
+        return Sizing::Grid;
+    }
+    return params.uniformItemSizes ? Sizing::Uniform : Sizing::Variable;
+}
+
+// Divisions rounding towards negative and positive infinity, for positive divisors.
+inline int floorDiv(int dividend, int divisor)
+{
+    return dividend >= 0 ? dividend / divisor : -((divisor - dividend - 1) / divisor);
+}
+
+inline int ceilDiv(int dividend, int divisor)
+{
+    return -floorDiv(-dividend, divisor);
+}
+
+// BEGIN: scans
+// The rect scanned for, with exclusive right and bottom, and the grid the items are bounded to.
+struct Bounds {
+    int left;
+    int top;
+    int right;
+    int bottom;
+    int gridWidth;
+    int gridHeight;
+};
+
+template<Match match, bool grid>
+inline bool matches(const Item &item, const Bounds &bounds)
+{
+    int left = item.topLeft.x();
+    const int top = item.topLeft.y();
+    int width = item.size.width();
+    int height = item.size.height();
+    if constexpr (grid) {
+        width = qMin(width, bounds.gridWidth);
+        height = qMin(height, bounds.gridHeight);
+        left += (bounds.gridWidth - width) >> 1;
+    }
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    const int right = left + width;
+    const int bottom = top + height;
+    if constexpr (match == Match::Intersects) {
+        return left < bounds.right && right > bounds.left && top < bounds.bottom && bottom > bounds.top;
+    } else {
+        return left >= bounds.left && right <= bounds.right && top >= bounds.top && bottom <= bounds.bottom;
+    }
+}
+
+#ifdef KCATEGORIZEDLAYOUT_SSE2
+// Four items at a time. SSE2 only has a signed greater than, and no minimum of 32 bit integers.
+struct Sse2 {
+    using Vector = __m128i;
+    static constexpr int lanes = 4;
+
+    // loads the items starting at items, and transposes them into their x, y, width and height
+    static void load(const Item *items, Vector &x, Vector &y, Vector &width, Vector &height)
+    {
+        const __m128i *data = reinterpret_cast<const __m128i *>(items);
+        const __m128i r0 = _mm_loadu_si128(data);
+        const __m128i r1 = _mm_loadu_si128(data + 1);
+        const __m128i r2 = _mm_loadu_si128(data + 2);
+        const __m128i r3 = _mm_loadu_si128(data + 3);
+        const __m128i xy01 = _mm_unpacklo_epi32(r0, r1);
+        const __m128i xy23 = _mm_unpacklo_epi32(r2, r3);
+        const __m128i wh01 = _mm_unpackhi_epi32(r0, r1);
+        const __m128i wh23 = _mm_unpackhi_epi32(r2, r3);
+        x = _mm_unpacklo_epi64(xy01, xy23);
+        y = _mm_unpackhi_epi64(xy01, xy23);
+        width = _mm_unpacklo_epi64(wh01, wh23);
+        height = _mm_unpackhi_epi64(wh01, wh23);
+    }
+
+    static Vector broadcast(int value)
+    {
+        return _mm_set1_epi32(value);
+    }
+    static Vector add(Vector a, Vector b)
+    {
+        return _mm_add_epi32(a, b);
+    }
+    static Vector sub(Vector a, Vector b)
+    {
+        return _mm_sub_epi32(a, b);
+    }
+    static Vector half(Vector a)
+    {
+        return _mm_srai_epi32(a, 1);
+    }
+    static Vector greaterThan(Vector a, Vector b)
+    {
+        return _mm_cmpgt_epi32(a, b);
+    }
+    static Vector both(Vector a, Vector b)
+    {
+        return _mm_and_si128(a, b);
+    }
+    // b where a is not set
+    static Vector unless(Vector a, Vector b)
+    {
+        return _mm_andnot_si128(a, b);
+    }
+    static Vector min(Vector a, Vector b)
+    {
+        const __m128i greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+    }
+    static unsigned mask(Vector a)
+    {
+        return unsigned(_mm_movemask_ps(_mm_castsi128_ps(a)));
+    }
+};
+#endif
+
+// Returns a bit per item starting at items, set if the item matches. Same as matches().
+template<typename Simd, Match match, bool grid>
+inline unsigned matchMask(const Item *items, const Bounds &bounds)
+{
+    using Vector = typename Simd::Vector;
+
+    Vector x;
+    Vector y;
+    Vector width;
+    Vector height;
+    Simd::load(items, x, y, width, height);
+
+    if constexpr (grid) {
+        const Vector gridWidth = Simd::broadcast(bounds.gridWidth);
+        width = Simd::min(width, gridWidth);
+        height = Simd::min(height, Simd::broadcast(bounds.gridHeight));
+        x = Simd::add(x, Simd::half(Simd::sub(gridWidth, width)));
+    }
+
+    const Vector zero = Simd::broadcast(0);
+    const Vector right = Simd::add(x, width);
+    const Vector bottom = Simd::add(y, height);
+    Vector result = Simd::both(Simd::greaterThan(width, zero), Simd::greaterThan(height, zero));
+    if constexpr (match == Match::Intersects) {
+        result = Simd::both(result, Simd::greaterThan(Simd::broadcast(bounds.right), x));
+        result = Simd::both(result, Simd::greaterThan(right, Simd::broadcast(bounds.left)));
+        result = Simd::both(result, Simd::greaterThan(Simd::broadcast(bounds.bottom), y));
+        result = Simd::both(result, Simd::greaterThan(bottom, Simd::broadcast(bounds.top)));
+    } else {
+        result = Simd::unless(Simd::greaterThan(Simd::broadcast(bounds.left), x), result);
+        result = Simd::unless(Simd::greaterThan(right, Simd::broadcast(bounds.right)), result);
+        result = Simd::unless(Simd::greaterThan(Simd::broadcast(bounds.top), y), result);
+        result = Simd::unless(Simd::greaterThan(bottom, Simd::broadcast(bounds.bottom)), result);
+    }
+    return Simd::mask(result);
+}
+
+// Turns the bits of matching items into spans of consecutive items.
+class SpanCollector
+{
+public:
+    explicit SpanCollector(QList<Span> &spans)
+        : m_spans(spans)
+    {
+    }
+
+    // mask has a bit for each of the lanes items from first on
+    void add(unsigned mask, int first, int lanes)
+    {
+        if (mask == (1u << lanes) - 1) {
+            if (m_start == -1) {
+                m_start = first;
+            }
+            return;
+        }
+        if (!mask) {
+            finish(first - 1);
+            return;
+        }
+        for (int lane = 0; lane < lanes; ++lane) {
+            if (mask & (1u << lane)) {
+                if (m_start == -1) {
+                    m_start = first + lane;
+                }
+            } else {
+                finish(first + lane - 1);
+            }
+        }
+    }
+
+    // closes the current span at last, if any
+    void finish(int last)
+    {
+        if (m_start != -1) {
+            m_spans.append({m_start, last});
+            m_start = -1;
+        }
+    }
+
+private:
+    QList<Span> &m_spans;
+    int m_start = -1;
+};
+
+template<Match match, bool grid>
+void scan(const Item *items, int first, int last, const Bounds &bounds, QList<Span> &spans)
+{
+    SpanCollector collector(spans);
+    int i = first;
+#ifdef KCATEGORIZEDLAYOUT_SSE2
+    for (; i + Sse2::lanes <= last; i += Sse2::lanes) {
+        collector.add(matchMask<Sse2, match, grid>(items + i, bounds), i, Sse2::lanes);
+    }
+#endif
+    for (; i < last; ++i) {
+        collector.add(matches<match, grid>(items[i], bounds), i, 1);
+    }
+    collector.finish(last - 1);
+}
+// END: scans
+}
+
+namespace KCategorizedLayout
+{
+int lastRowHeight(const Item *items, int count)
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    const int lastRowTop = items[count - 1].topLeft.y();
+    int height = 0;
+    for (int i = count - 1; i >= 0 && items[i].topLeft.y() == lastRowTop; --i) {
+        height = qMax(height, items[i].size.height());
+    }
+    return height;
+}
+
+Kernel kernelFor(const Params &params)
+{
+    const Sizing sizing = sizingFor(params);
+
+    if (params.topToBottom) {
+        switch (sizing) {
+        case Sizing::Grid:
+            return &layoutTopToBottom<Sizing::Grid>;
+        case Sizing::Uniform:
+            return &layoutTopToBottom<Sizing::Uniform>;
+        case Sizing::Variable:
+            return &layoutTopToBottom<Sizing::Variable>;
+        }
+    }
+
+    switch (sizing) {
+    case Sizing::Grid:
+        return params.rightToLeft ? &layoutCells<Sizing::Grid, true> : &layoutCells<Sizing::Grid, false>;
+    case Sizing::Uniform:
+        return params.rightToLeft ? &layoutCells<Sizing::Uniform, true> : &layoutCells<Sizing::Uniform, false>;
+    case Sizing::Variable:
+        break;
+    }
+    return params.rightToLeft ? &layoutFlow<true> : &layoutFlow<false>;
+}
+
+int layoutItems(const Params &params, Item *items, int count, int from)
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    return kernelFor(params)(params, items, count, from);
+}
+
+void findItems(const Item *items, int count, const QRect &rect, const QSize &gridSize, Match match, QList<Span> &spans)
+{
+    if (count <= 0 || rect.isEmpty()) {
+        return;
+    }
+
+    // items are sorted by their top, and rows do not overlap. So the first item that can match
+    // starts the row at or above the top of rect, and the last one is above its bottom.
+    const auto aboveY = [](const Item &item, int y) {
+        return item.topLeft.y() < y;
+    };
+    const auto belowY = [](int y, const Item &item) {
+        return y < item.topLeft.y();
+    };
+    int first = std::upper_bound(items, items + count, rect.top(), belowY) - items;
+    if (first > 0) {
+        first = std::lower_bound(items, items + first, items[first - 1].topLeft.y(), aboveY) - items;
+    }
+    const int last = std::upper_bound(items + first, items + count, rect.bottom(), belowY) - items;
+
+    const Bounds bounds{rect.left(), rect.top(), rect.right() + 1, rect.bottom() + 1, gridSize.width(), gridSize.height()};
+    const bool grid = gridSize.isValid() && !gridSize.isNull();
+    if (match == Match::Intersects) {
+        if (grid) {
+            scan<Match::Intersects, true>(items, first, last, bounds, spans);
+        } else {
+            scan<Match::Intersects, false>(items, first, last, bounds, spans);
+        }
+    } else if (grid) {
+        scan<Match::Contained, true>(items, first, last, bounds, spans);
+    } else {
+        scan<Match::Contained, false>(items, first, last, bounds, spans);
+    }
+}
+
+FixedSizeLayout::FixedSizeLayout(const Params &params, const QSize &itemSize)
+    : size(itemSize)
+{
+    const Sizing sizing = sizingFor(params);
+    const int originX = params.blockX + params.leftMargin;
+    const int spacing = params.spacing;
+    if (sizing == Sizing::Grid) {
+        gridSize = params.gridSize;
+    }
+
+    // the same as the kernels do, see layoutTopToBottom(), layoutCells() and layoutFlow()
+    if (params.topToBottom) {
+        size.setWidth(params.viewportWidth);
+        if (sizing == Sizing::Variable) {
+            x = originX + spacing;
+            y = spacing;
+            rowStep = itemSize.height() + spacing;
+        } else {
+            x = originX;
+            rowStep = sizing == Sizing::Grid ? gridSize.height() : itemSize.height();
+        }
+        return;
+    }
+
+    rightToLeft = params.rightToLeft;
+    axis = 2 * originX + params.viewportWidth;
+    switch (sizing) {
+    case Sizing::Grid:
+        columns = qMax(params.viewportWidth / qMax(gridSize.width(), 1), 1);
+        x = originX;
+        columnStep = gridSize.width();
+        rowStep = gridSize.height();
+        mirrorWidth = gridSize.width();
+        break;
+    case Sizing::Uniform:
+        columns = qMax((params.viewportWidth - spacing) / qMax(qMax(itemSize.width(), 1) + spacing, 1), 1);
+        x = originX;
+        columnStep = itemSize.width();
+        rowStep = itemSize.height();
+        mirrorWidth = itemSize.width();
+        break;
+    case Sizing::Variable: {
+        // the item after k others still fits in their row if
+        // leftMargin + k * (width + spacing) + width + 2 * spacing <= viewportWidth
+        const int step = itemSize.width() + spacing;
+        const int room = params.viewportWidth - params.leftMargin - itemSize.width() - 2 * spacing;
+        if (room < 0) {
+            columns = 1;
+        } else {
+            columns = step > 0 ? room / step + 1 : std::numeric_limits<int>::max();
+        }
+        x = originX + spacing;
+        y = spacing;
+        columnStep = step;
+        rowStep = itemSize.height() + spacing;
+        mirrorWidth = itemSize.width();
+        break;
+    }
+    }
+}
+
+int FixedSizeLayout::height(int count) const
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    return y + ((count - 1) / columns + 1) * rowStep;
+}
+
+Item FixedSizeLayout::item(int index) const
+{
+    int left = x + (index % columns) * columnStep;
+    if (rightToLeft) {
+        left = axis - left - mirrorWidth;
+    }
+    return {QPoint(left, y + (index / columns) * rowStep), size};
+}
+
+void FixedSizeLayout::findItems(int count, const QRect &rect, Match match, QList<Span> &spans) const
+{
+    if (count <= 0 || rect.isEmpty()) {
+        return;
+    }
+
+    // all items have the same rect, relative to their cell
+    int width = size.width();
+    int height = size.height();
+    int offset = 0;
+    if (gridSize.isValid() && !gridSize.isNull()) {
+        width = qMin(width, gridSize.width());
+        height = qMin(height, gridSize.height());
+        offset = (gridSize.width() - width) >> 1;
+    }
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    const int left = rect.left();
+    const int top = rect.top();
+    const int right = rect.right() + 1;
+    const int bottom = rect.bottom() + 1;
+
+    // BEGIN: rows matching vertically
+    const int step = qMax(rowStep, 1);
+    int firstRow;
+    int lastRow;
+    if (match == Match::Intersects) {
+        firstRow = floorDiv(top - height - y, step) + 1;
+        lastRow = ceilDiv(bottom - y, step) - 1;
+    } else {
+        firstRow = ceilDiv(top - y, step);
+        lastRow = floorDiv(bottom - height - y, step);
+    }
+    firstRow = qMax(firstRow, 0);
+    lastRow = qMin(lastRow, (count - 1) / columns);
+    if (firstRow > lastRow) {
+        return;
+    }
+    // END: rows matching vertically
+
+    // BEGIN: columns matching horizontally
+    // columns are sorted horizontally, one way or the other, so the matching ones are consecutive
+    const int usedColumns = qMin(columns, count);
+    int firstColumn = -1;
+    int lastColumn = -1;
+    for (int column = 0; column < usedColumns; ++column) {
+        const int itemLeft = item(column).topLeft.x() + offset;
+        const int itemRight = itemLeft + width;
+        const bool matches = match == Match::Intersects ? itemLeft < right && itemRight > left : itemLeft >= left && itemRight <= right;
+        if (matches) {
+            firstColumn = firstColumn == -1 ? column : firstColumn;
+            lastColumn = column;
+        } else if (firstColumn != -1) {
+            break;
+        }
+    }
+    if (firstColumn == -1) {
+        return;
+    }
+    // END: columns matching horizontally
+
+    if (firstColumn == 0 && lastColumn == usedColumns - 1) {
+        spans.append({firstRow * columns, qMin(lastRow * columns + lastColumn, count - 1)});
+        return;
+    }
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const int first = row * columns + firstColumn;
+        if (first >= count) {
+            break;
+        }
+        spans.append({first, qMin(row * columns + lastColumn, count - 1)});
+    }
+}
+}
@@ -0,0 +1,176 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCATEGORIZEDLAYOUT_P_H
+#define KCATEGORIZEDLAYOUT_P_H
+
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+
+/*!
+ * \internal
+ *
+ * Lays out the items of a block of KCategorizedView. Items of different blocks do not depend on
+ * each other, and everything here only works on plain sizes and positions, so blocks can be laid
+ * out on worker threads once the size hints have been collected on the GUI thread.
+ */
+namespace KCategorizedLayout
+{
+struct Item {
+    // x is absolute, y is relative to the top of the block
+    QPoint topLeft;
+    QSize size;
+};
+
+/*!
+ * \internal
+ *
+ * What the layout depends on, read from the view once per layout pass.
+ */
+struct Params {
+    // x of all blocks, that is, the category spacing. Blocks are that far apart vertically too.
+    int blockX = 0;
+    // left margin of the category drawer
+    int leftMargin = 0;
+    int viewportWidth = 0;
+    int spacing = 0;
+    // invalid if the view has no grid
+    QSize gridSize;
+    bool uniformItemSizes = false;
+    bool rightToLeft = false;
+    bool topToBottom = false;
+
+    friend bool operator==(const Params &left, const Params &right) noexcept
+    {
+        return left.blockX == right.blockX && left.leftMargin == right.leftMargin && left.viewportWidth == right.viewportWidth
+            && left.spacing == right.spacing && left.gridSize == right.gridSize && left.uniformItemSizes == right.uniformItemSizes
+            && left.rightToLeft == right.rightToLeft && left.topToBottom == right.topToBottom;
+    }
+    friend bool operator!=(const Params &left, const Params &right) noexcept
+    {
+        return !(left == right);
+    }
+};
+
+/*!
+ * Positions the \a count items of a block starting at \a items, from the item \a from on. The
+ * items before \a from must have been positioned already, and the size of all items must be set.
+ * Returns the height of the block. \a count must be greater than 0.
+ *
+ * Kernels are specialized at compile time for every combination of grid, uniform or variable
+ * item sizes, left to right or right to left, and flow, so that their loops do not branch on the
+ * configuration of the view.
+ *
+ * Kernels are thread-safe.
+ *
+ * Complexity: O(count - from), plus the length of the row holding item \a from.
+ */
+using Kernel = int (*)(const Params &params, Item *items, int count, int from);
+
+/*!
+ * Returns the kernel laying out items with \a params. Choose it once per layout pass.
+ */
+Kernel kernelFor(const Params &params);
+
+/*!
+ * Convenience function running the kernel for \a params on \a items. Returns 0 if \a count is
+ * 0.
+ */
+int layoutItems(const Params &params, Item *items, int count, int from = 0);
+
+/*!
+ * Returns the height of the highest of the \a count items starting at \a items that are in the
+ * last row.
+ */
+int lastRowHeight(const Item *items, int count);
+
+/*!
+ * \internal
+ *
+ * A run of consecutive items, from \a first to \a last inclusive.
+ */
+struct Span {
+    int first;
+    int last;
+};
+
+/*!
+ * \internal
+ *
+ * How the rect of an item has to relate to the rect scanned for.
+ */
+enum class Match {
+    Intersects,
+    Contained,
+};
+
+/*!
+ * Appends to \a spans the runs of items among the \a count laid out items starting at \a items
+ * whose rect intersects \a rect, or is contained in it, depending on \a match. \a rect is in
+ * block terms, like the items, and must be normalized. Spans are relative to \a items.
+ *
+ * With a valid \a gridSize, the rect of an item is its size bounded to the grid, centered
+ * horizontally in its cell, as KCategorizedView::visualRect() does. Items with an empty rect never
+ * match.
+ *
+ * Only the rows around \a rect are looked at, found by binary search. Those are scanned with
+ * SSE2, four items at a time, on the processors that always have it, such as x86-64.
+ *
+ * This function is thread-safe.
+ *
+ * Complexity: O(log(count) + k) where k is the number of items in the rows around \a rect.
+ */
+void findItems(const Item *items, int count, const QRect &rect, const QSize &gridSize, Match match, QList<Span> &spans);
+
+/*!
+ * \internal
+ *
+ * The layout of a block whose items all have the same size. Any item can be positioned on its
+ * own, so such blocks do not have to store their items. Items get the positions the kernel for the
+ * same params gives them.
+ */
+struct FixedSizeLayout {
+    FixedSizeLayout(const Params &params, const QSize &itemSize);
+
+    /*!
+     * Returns the height of a block of \a count items.
+     */
+    int height(int count) const;
+
+    /*!
+     * Returns the item at \a index, laid out.
+     */
+    Item item(int index) const;
+
+    /*!
+     * Same as KCategorizedLayout::findItems(), for a block of \a count items.
+     *
+     * Complexity: O(c + k) where c is the number of columns and k the number of rows \a rect
+     *             overlaps.
+     */
+    void findItems(int count, const QRect &rect, Match match, QList<Span> &spans) const;
+
+    // the size of every item once laid out
+    QSize size;
+    int columns = 1;
+    // top left of the first item, left to right
+    int x = 0;
+    int y = 0;
+    int columnStep = 0;
+    int rowStep = 0;
+    // right to left mirrors the columns around axis, as cells mirrorWidth wide
+    bool rightToLeft = false;
+    int axis = 0;
+    int mirrorWidth = 0;
+    // invalid if the view has no grid
+    QSize gridSize;
+};
+}
+
+#endif // KCATEGORIZEDLAYOUT_P_H
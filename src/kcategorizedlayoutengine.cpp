@@ -0,0 +1,1475 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kcategorizedlayoutengine_p.h"
+
+#include <QSet>
+#include <QtConcurrentMap>
+#include <QtEndian>
+
+#include <algorithm>
+#include <limits>
+
+using KCategorizedLayout::Item;
+
+// Snapshots start with this, "KCLS" in little endian, and the version of their format
+static const qint32 s_snapshotMagic = 0x534C434B;
+static const qint32 s_snapshotVersion = 2;
+
+namespace
+{
+enum SnapshotParamsFlag {
+    UniformItemSizes = 0x1,
+    RightToLeft = 0x2,
+    TopToBottom = 0x4,
+};
+
+enum SnapshotBlockFlag {
+    Collapsed = 0x1,
+    Evicted = 0x2,
+    FixedSize = 0x4,
+    Unlimited = 0x8,
+};
+
+// number of integers of a block in the block table
+const int s_snapshotBlockWords = 9;
+
+void writeWord(QByteArray &snapshot, qint32 word)
+{
+    const qint32 value = qToLittleEndian(word);
+    snapshot.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// reads the integers of a snapshot, until it runs out of them
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(const QByteArray &snapshot)
+        : m_data(snapshot.constData())
+        , m_end(snapshot.constData() + snapshot.size())
+    {
+    }
+
+    bool read(qint32 &word)
+    {
+        if (m_end - m_data < qsizetype(sizeof(word))) {
+            return false;
+        }
+        word = qFromLittleEndian<qint32>(m_data);
+        m_data += sizeof(word);
+        return true;
+    }
+
+    qsizetype remainingBytes() const
+    {
+        return m_end - m_data;
+    }
+
+    qsizetype remainingWords() const
+    {
+        return remainingBytes() / sizeof(qint32);
+    }
+
+    QByteArray remaining() const
+    {
+        return QByteArray(m_data, m_end - m_data);
+    }
+
+private:
+    const char *m_data;
+    const char *m_end;
+};
+
+// the laid out items of a block, whether it stores them or they all have the same size
+class BlockItems
+{
+public:
+    BlockItems(const KCategorizedLayout::Params &params, const QSize &itemSize, const Item *items)
+        : m_fixed(params, itemSize)
+        , m_items(itemSize.isValid() ? nullptr : items)
+    {
+    }
+
+    Item operator[](int index) const
+    {
+        return m_items ? m_items[index] : m_fixed.item(index);
+    }
+
+private:
+    KCategorizedLayout::FixedSizeLayout m_fixed;
+    const Item *m_items;
+};
+
+// Returns the first index from first to last, exclusive, for which predicate is false. The
+// predicate has to be true for all indexes before that one, and false for all after it.
+template<typename Predicate>
+int partitionPoint(int first, int last, Predicate predicate)
+{
+    int count = last - first;
+    while (count > 0) {
+        const int step = count / 2;
+        if (predicate(first + step)) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+}
+
+// Below this many items to lay out, doing it on the calling thread is faster than spreading the
+// blocks over the thread pool.
+static const int s_parallelLayoutThreshold = 10000;
+
+KCategorizedLayoutEngine::KCategorizedLayoutEngine() = default;
+
+KCategorizedLayoutEngine::~KCategorizedLayoutEngine() = default;
+
+void KCategorizedLayoutEngine::setSizeHintFunction(const SizeHintFunction &sizeHint)
+{
+    m_sizeHint = sizeHint;
+}
+
+void KCategorizedLayoutEngine::setHeaderHeightFunction(const HeaderHeightFunction &headerHeight)
+{
+    m_headerHeight = headerHeight;
+}
+
+void KCategorizedLayoutEngine::setBlockItemSizeFunction(const BlockItemSizeFunction &blockItemSize)
+{
+    m_blockItemSize = blockItemSize;
+    invalidate();
+}
+
+qsizetype KCategorizedLayoutEngine::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+void KCategorizedLayoutEngine::setMemoryBudget(qsizetype bytes)
+{
+    m_memoryBudget = qMax<qsizetype>(bytes, 0);
+    if (isLaidOut()) {
+        evictFarBlocks();
+    }
+}
+
+QRect KCategorizedLayoutEngine::visibleRect() const
+{
+    return m_visibleRect;
+}
+
+void KCategorizedLayoutEngine::setVisibleRect(const QRect &rect)
+{
+    m_visibleRect = rect.normalized();
+}
+
+KCategorizedLayoutEngine::CacheStatistics KCategorizedLayoutEngine::cacheStatistics() const
+{
+    CacheStatistics statistics;
+    for (const Block &block : m_blocks) {
+        statistics.bytes += blockBytes(block);
+        statistics.evictedBlocks += block.evicted;
+    }
+    statistics.evictions = m_evictions;
+    statistics.reloads = m_reloads;
+    return statistics;
+}
+
+KCategorizedLayout::Params KCategorizedLayoutEngine::params() const
+{
+    return m_params;
+}
+
+void KCategorizedLayoutEngine::setParams(const KCategorizedLayout::Params &params)
+{
+    if (m_params == params) {
+        return;
+    }
+
+    // top to bottom flow stretches the items to the width of the viewport, and uniform item sizes
+    // only ask for the size of one item
+    const bool sizesChanged = m_params.topToBottom != params.topToBottom || m_params.uniformItemSizes != params.uniformItemSizes;
+    m_params = params;
+    if (sizesChanged) {
+        invalidate();
+        return;
+    }
+
+    // evicted blocks stay evicted, layout() lays them out again one by one
+    for (Block &block : m_blocks) {
+        if (!block.evicted) {
+            block.layoutFrom = 0;
+        }
+        block.height = -1;
+    }
+    markDirty(0);
+}
+
+int KCategorizedLayoutEngine::rowCount() const
+{
+    return m_rowCount;
+}
+
+void KCategorizedLayoutEngine::clear()
+{
+    m_blocks.clear();
+    m_categoryBlocks.clear();
+    m_rowCount = 0;
+    m_firstDirtyBlock = 0;
+    m_uniformSize = QSize();
+}
+
+bool KCategorizedLayoutEngine::insertRows(int row, int count, int category)
+{
+    Q_ASSERT(row >= 0 && row <= m_rowCount);
+    if (count <= 0) {
+        return true;
+    }
+
+    int index = blockForCategory(category);
+    if (index != -1) {
+        Block &block = m_blocks[index];
+        if (row < block.firstRow || row > block.firstRow + block.rowCount) {
+            return false;
+        }
+
+        // items before the inserted ones keep their position, the rest will be positioned again.
+        // Rows pushed beyond the row limit lose their item.
+        if (!block.itemSize.isValid()) {
+            restore(block);
+            if (row - block.firstRow <= block.items.count()) {
+                block.items.insert(row - block.firstRow, count, Item());
+            }
+        }
+        if (block.hiddenCount) {
+            block.hidden.insert(block.hidden.begin() + (row - block.firstRow), count, false);
+        }
+        block.rowCount += count;
+        if (!block.itemSize.isValid()) {
+            block.items.resize(laidOutRowCount(block));
+        }
+        block.layoutFrom = qMin(block.layoutFrom, row - block.firstRow);
+        block.height = -1;
+    } else {
+        index = std::lower_bound(m_blocks.cbegin(), m_blocks.cend(), row, [](const Block &block, int row) {
+                    return block.firstRow < row;
+                })
+            - m_blocks.cbegin();
+        if (index > 0) {
+            const Block &previous = m_blocks[index - 1];
+            if (previous.firstRow + previous.rowCount > row) {
+                return false;
+            }
+        }
+
+        Block block;
+        block.category = category;
+        block.firstRow = row;
+        block.rowCount = count;
+        block.items.resize(laidOutRowCount(block));
+        insertBlock(index, block);
+    }
+
+    for (int i = index + 1; i < m_blocks.count(); ++i) {
+        m_blocks[i].firstRow += count;
+    }
+    m_rowCount += count;
+    markDirty(index);
+
+    return true;
+}
+
+void KCategorizedLayoutEngine::removeRows(int row, int count)
+{
+    Q_ASSERT(row >= 0 && row + count <= m_rowCount);
+    if (count <= 0) {
+        return;
+    }
+
+    // Removed rows can be the last part of a block, and no item of it moves. They can be its
+    // first part, and all remaining items move. Or they are in between, and only the items after
+    // them move. Blocks under the first affected one move as a whole, since items are positioned
+    // relative to their block.
+    const int end = row + count;
+    int index = std::lower_bound(m_blocks.cbegin(),
+                                 m_blocks.cend(),
+                                 row,
+                                 [](const Block &block, int row) {
+                                     return block.firstRow + block.rowCount <= row;
+                                 })
+        - m_blocks.cbegin();
+    markDirty(index);
+
+    while (index < m_blocks.count()) {
+        Block &block = m_blocks[index];
+        if (block.firstRow >= end) {
+            block.firstRow -= count;
+            ++index;
+            continue;
+        }
+
+        const int first = qMax(row, block.firstRow);
+        const int last = qMin(end, block.firstRow + block.rowCount);
+        if (!block.itemSize.isValid()) {
+            restore(block);
+            const int from = first - block.firstRow;
+            if (from < block.items.count()) {
+                block.items.remove(from, qMin(last - first, block.items.count() - from));
+            }
+        }
+        if (block.hiddenCount) {
+            const auto begin = block.hidden.begin() + (first - block.firstRow);
+            block.hiddenCount -= std::count(begin, begin + (last - first), true);
+            block.hidden.erase(begin, begin + (last - first));
+            if (!block.hiddenCount) {
+                block.hidden = std::vector<bool>();
+            }
+        }
+        block.rowCount -= last - first;
+        if (!block.rowCount) {
+            removeBlock(index);
+            continue;
+        }
+
+        // rows pulled within the row limit get an item
+        if (!block.itemSize.isValid() && block.items.count() < laidOutRowCount(block)) {
+            block.layoutFrom = qMin(block.layoutFrom, int(block.items.count()));
+            block.items.resize(laidOutRowCount(block));
+        }
+
+        block.layoutFrom = qMin(block.layoutFrom, first - block.firstRow);
+        block.height = -1;
+        block.firstRow = qMin(block.firstRow, row);
+        ++index;
+    }
+
+    m_rowCount -= count;
+}
+
+void KCategorizedLayoutEngine::resizeRows(int first, int last)
+{
+    first = qMax(first, 0);
+    last = qMin(last, m_rowCount - 1);
+    if (first > last) {
+        return;
+    }
+
+    // all items have the size of any of them
+    if (m_params.uniformItemSizes) {
+        invalidate();
+        return;
+    }
+
+    int index = blockForRow(first);
+    if (index == -1) {
+        return;
+    }
+
+    markDirty(index);
+    for (; index < m_blocks.count() && m_blocks[index].firstRow <= last; ++index) {
+        Block &block = m_blocks[index];
+        block.height = -1;
+        // the size of all items of the block is asked for again
+        if (block.itemSize.isValid()) {
+            continue;
+        }
+
+        restore(block);
+        const int from = qMax(first, block.firstRow) - block.firstRow;
+        const int to = qMin(last - block.firstRow + 1, int(block.items.count()));
+        for (int i = from; i < to; ++i) {
+            block.items[i].size = QSize();
+        }
+        block.layoutFrom = qMin(block.layoutFrom, from);
+    }
+}
+
+void KCategorizedLayoutEngine::invalidate()
+{
+    // evicted blocks do not store sizes, they are asked for anyway when laid out again
+    for (Block &block : m_blocks) {
+        if (!block.evicted) {
+            for (Item &item : block.items) {
+                item.size = QSize();
+            }
+            block.layoutFrom = 0;
+        }
+        block.height = -1;
+    }
+    m_uniformSize = QSize();
+    markDirty(0);
+}
+
+int KCategorizedLayoutEngine::blockCount() const
+{
+    return m_blocks.count();
+}
+
+int KCategorizedLayoutEngine::blockForRow(int row) const
+{
+    const auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), row, [](int row, const Block &block) {
+        return row < block.firstRow;
+    });
+    if (it == m_blocks.cbegin()) {
+        return -1;
+    }
+
+    const int index = it - m_blocks.cbegin() - 1;
+    const Block &block = m_blocks[index];
+    return row < block.firstRow + block.rowCount ? index : -1;
+}
+
+int KCategorizedLayoutEngine::blockForCategory(int category) const
+{
+    return m_categoryBlocks.value(category, -1);
+}
+
+int KCategorizedLayoutEngine::blockCategory(int block) const
+{
+    return m_blocks[block].category;
+}
+
+int KCategorizedLayoutEngine::blockFirstRow(int block) const
+{
+    return m_blocks[block].firstRow;
+}
+
+int KCategorizedLayoutEngine::blockRowCount(int block) const
+{
+    return m_blocks[block].rowCount;
+}
+
+bool KCategorizedLayoutEngine::isBlockCollapsed(int block) const
+{
+    return m_blocks[block].collapsed;
+}
+
+void KCategorizedLayoutEngine::setBlockCollapsed(int block, bool collapsed)
+{
+    if (m_blocks[block].collapsed == collapsed) {
+        return;
+    }
+
+    m_blocks[block].collapsed = collapsed;
+    markDirty(block);
+}
+
+int KCategorizedLayoutEngine::rowLimit() const
+{
+    return m_rowLimit;
+}
+
+void KCategorizedLayoutEngine::setRowLimit(int limit)
+{
+    limit = qMax(limit, 0);
+    if (m_rowLimit == limit) {
+        return;
+    }
+
+    const int previousLimit = m_rowLimit;
+    m_rowLimit = limit;
+    for (int i = 0; i < m_blocks.count(); ++i) {
+        const Block &block = m_blocks[i];
+        laidOutRowCountChanged(i, block.unlimited || !previousLimit ? block.rowCount : qMin(block.rowCount, previousLimit));
+    }
+}
+
+bool KCategorizedLayoutEngine::isBlockUnlimited(int block) const
+{
+    return m_blocks[block].unlimited;
+}
+
+void KCategorizedLayoutEngine::setBlockUnlimited(int block, bool unlimited)
+{
+    if (m_blocks[block].unlimited == unlimited) {
+        return;
+    }
+
+    const int previousCount = laidOutRowCount(m_blocks[block]);
+    m_blocks[block].unlimited = unlimited;
+    laidOutRowCountChanged(block, previousCount);
+}
+
+int KCategorizedLayoutEngine::blockCappedRowCount(int block) const
+{
+    const Block &b = m_blocks[block];
+    return b.rowCount - laidOutRowCount(b);
+}
+
+bool KCategorizedLayoutEngine::isRowCapped(int row) const
+{
+    const int index = blockForRow(row);
+    if (index == -1) {
+        return false;
+    }
+
+    const Block &block = m_blocks[index];
+    return row - block.firstRow >= laidOutRowCount(block);
+}
+
+bool KCategorizedLayoutEngine::isRowHidden(int row) const
+{
+    const int index = blockForRow(row);
+    if (index == -1) {
+        return false;
+    }
+
+    const Block &block = m_blocks[index];
+    return block.hiddenCount && block.hidden[row - block.firstRow];
+}
+
+void KCategorizedLayoutEngine::setRowsHidden(int first, int last, bool hidden)
+{
+    first = qMax(first, 0);
+    last = qMin(last, m_rowCount - 1);
+    if (first > last) {
+        return;
+    }
+
+    for (int index = blockForRow(first); index < m_blocks.count() && m_blocks[index].firstRow <= last; ++index) {
+        Block &block = m_blocks[index];
+        if (!hidden && !block.hiddenCount) {
+            continue;
+        }
+        if (block.hidden.empty()) {
+            block.hidden.resize(block.rowCount);
+        }
+
+        const int from = qMax(first, block.firstRow) - block.firstRow;
+        const int to = qMin(last - block.firstRow + 1, block.rowCount);
+        int firstChanged = to;
+        int changed = 0;
+        for (int i = from; i < to; ++i) {
+            if (block.hidden[i] != hidden) {
+                block.hidden[i] = hidden;
+                firstChanged = qMin(firstChanged, i);
+                ++changed;
+            }
+        }
+        if (!changed) {
+            continue;
+        }
+
+        block.hiddenCount += hidden ? changed : -changed;
+        if (!block.hiddenCount) {
+            block.hidden = std::vector<bool>();
+        }
+
+        // shown items are measured again, hidden ones are given no size when laid out. Blocks
+        // whose items are not stored get them back on the next layout.
+        if (!block.itemSize.isValid()) {
+            restore(block);
+            if (!hidden) {
+                for (int i = from; i < qMin(to, int(block.items.count())); ++i) {
+                    block.items[i].size = QSize();
+                }
+            }
+        }
+        block.layoutFrom = qMin(block.layoutFrom, firstChanged);
+        block.height = -1;
+        markDirty(index);
+    }
+}
+
+int KCategorizedLayoutEngine::blockHiddenRowCount(int block) const
+{
+    return m_blocks[block].hiddenCount;
+}
+
+int KCategorizedLayoutEngine::shownRow(int row, bool forward) const
+{
+    if (row < 0 || row >= m_rowCount) {
+        return -1;
+    }
+
+    const int step = forward ? 1 : -1;
+    int index = blockForRow(row);
+    while (true) {
+        const Block &block = m_blocks[index];
+        const int count = laidOutRowCount(block);
+        if (!block.collapsed && block.hiddenCount < block.rowCount) {
+            // going back from a capped row starts from the last row within the limit
+            for (int i = qMin(row - block.firstRow, forward ? count : count - 1); i >= 0 && i < count; i += step) {
+                if (!block.hiddenCount || !block.hidden[i]) {
+                    return block.firstRow + i;
+                }
+            }
+        }
+
+        index += step;
+        if (index < 0 || index >= m_blocks.count()) {
+            return -1;
+        }
+        row = forward ? m_blocks[index].firstRow : m_blocks[index].firstRow + m_blocks[index].rowCount - 1;
+    }
+}
+
+bool KCategorizedLayoutEngine::isLaidOut() const
+{
+    return m_firstDirtyBlock >= m_blocks.count();
+}
+
+void KCategorizedLayoutEngine::layout()
+{
+    if (isLaidOut()) {
+        return;
+    }
+
+    struct Job {
+        Block *block;
+        int from;
+    };
+
+    // BEGIN: snapshot the size hints
+    // the size hint function usually asks models and delegates, which live on the calling thread,
+    // so this part cannot be parallelized
+    QList<Job> jobs;
+    qsizetype itemCount = 0;
+    for (int i = m_firstDirtyBlock; i < m_blocks.count(); ++i) {
+        Block &block = m_blocks[i];
+        const int count = laidOutRowCount(block);
+        if ((block.evicted || block.layoutFrom >= count) && block.height != -1) {
+            continue;
+        }
+
+        // blocks whose items all have the same size are laid out right away, without items, unless
+        // some are hidden
+        QSize itemSize;
+        if (m_params.uniformItemSizes) {
+            if (!m_uniformSize.isValid()) {
+                m_uniformSize = m_sizeHint(block.firstRow);
+            }
+            itemSize = m_uniformSize;
+        } else if (m_blockItemSize) {
+            itemSize = m_blockItemSize(block.firstRow);
+        }
+        if (itemSize.isValid() && !block.hiddenCount) {
+            block.itemSize = itemSize;
+            block.items = QList<Item>();
+            block.rows = QList<RowSummary>();
+            block.evicted = false;
+            block.layoutFrom = count;
+            block.height = KCategorizedLayout::FixedSizeLayout(m_params, itemSize).height(count);
+            continue;
+        }
+
+        // Evicted blocks are laid out again right away and evicted again, instead of being given
+        // back their items for the whole layout pass, so that they never all take memory at once.
+        // Blocks only get evicted when far from the visible rect, which does not change here.
+        if (block.evicted) {
+            block.height = restoreAndLayout(block);
+            evict(block);
+            continue;
+        }
+        if (block.itemSize.isValid()) {
+            block.itemSize = QSize();
+            block.items.resize(count);
+            block.layoutFrom = 0;
+        }
+
+        Item *items = block.items.data();
+        for (int j = block.layoutFrom; j < count; ++j) {
+            if (block.hiddenCount && block.hidden[j]) {
+                items[j].size = QSize(0, 0);
+            } else if (!items[j].size.isValid()) {
+                items[j].size = itemSize.isValid() ? itemSize : m_sizeHint(block.firstRow + j);
+            }
+        }
+        const int from = qMin(block.layoutFrom, count);
+        jobs.append({&block, from});
+        itemCount += count - from;
+    }
+    // END: snapshot the size hints
+
+    // BEGIN: lay out the blocks
+    // blocks do not depend on each other, and each job only writes to its own block
+    const KCategorizedLayout::Params params = m_params;
+    const KCategorizedLayout::Kernel kernel = KCategorizedLayout::kernelFor(params);
+    const auto layoutBlock = [&params, kernel](Job &job) {
+        Block *block = job.block;
+        block->height = layoutItems(params, kernel, *block, job.from);
+        block->layoutFrom = block->items.count();
+    };
+    if (jobs.count() > 1 && itemCount >= s_parallelLayoutThreshold) {
+        QtConcurrent::blockingMap(jobs, layoutBlock);
+    } else {
+        std::for_each(jobs.begin(), jobs.end(), layoutBlock);
+    }
+    // END: lay out the blocks
+
+    // BEGIN: position the blocks under the first changed one
+    // blocks above keep their position, so we start from the bottom of the one above
+    int y = 0;
+    if (m_firstDirtyBlock > 0) {
+        const Block &previous = m_blocks[m_firstDirtyBlock - 1];
+        y = previous.position.y() + (previous.collapsed ? 0 : previous.height);
+    }
+    for (int i = m_firstDirtyBlock; i < m_blocks.count(); ++i) {
+        Block &block = m_blocks[i];
+        block.headerHeight = m_headerHeight ? m_headerHeight(block.firstRow) : 0;
+        y += block.headerHeight + m_params.blockX;
+        block.position = QPoint(m_params.blockX, y);
+        y += block.collapsed ? 0 : block.height;
+    }
+    // END: position the blocks under the first changed one
+
+    m_firstDirtyBlock = m_blocks.count();
+
+    if (!jobs.isEmpty()) {
+        evictFarBlocks();
+    }
+}
+
+QPoint KCategorizedLayoutEngine::blockPosition(int block)
+{
+    layout();
+    return m_blocks[block].position;
+}
+
+int KCategorizedLayoutEngine::blockHeaderHeight(int block)
+{
+    layout();
+    return m_blocks[block].headerHeight;
+}
+
+int KCategorizedLayoutEngine::blockHeight(int block)
+{
+    layout();
+    const Block &b = m_blocks[block];
+    return b.collapsed ? 0 : b.height;
+}
+
+int KCategorizedLayoutEngine::blockAt(int y)
+{
+    layout();
+    const auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), y, [](int y, const Block &block) {
+        return y < block.position.y() - block.headerHeight;
+    });
+    return it - m_blocks.cbegin() - 1;
+}
+
+int KCategorizedLayoutEngine::lastRowHeight(int block)
+{
+    layout();
+    const Block &b = m_blocks[block];
+    if (b.itemSize.isValid()) {
+        return b.rowCount ? b.itemSize.height() : 0;
+    }
+    if (b.evicted) {
+        return b.rows.constLast().height;
+    }
+    return KCategorizedLayout::lastRowHeight(b.items.constData(), b.items.count());
+}
+
+QRect KCategorizedLayoutEngine::itemRect(int row)
+{
+    const int index = blockForRow(row);
+    if (index == -1) {
+        return QRect();
+    }
+
+    if (isRowHidden(row) || isRowCapped(row)) {
+        return QRect();
+    }
+
+    layout();
+    const bool reloaded = m_blocks[index].evicted;
+    reload(index);
+
+    const Block &block = m_blocks[index];
+    const Item item = block.itemSize.isValid() ? KCategorizedLayout::FixedSizeLayout(m_params, block.itemSize).item(row - block.firstRow)
+                                               : block.items[row - block.firstRow];
+    QRect rect = blockItemRect(block, item);
+
+    if (block.collapsed) {
+        // we can still do binary search, while we "hide" items. We move those items in collapsed
+        // blocks to the left and set a 0 height.
+        rect.setLeft(-rect.width());
+        rect.setHeight(0);
+    }
+
+    // the block was only needed for this item, it might have to go again
+    if (reloaded) {
+        evictFarBlocks();
+    }
+
+    return rect;
+}
+
+QRect KCategorizedLayoutEngine::rowsRect(int first, int last)
+{
+    const int index = blockForRow(first);
+    if (index == -1 || first > last) {
+        return QRect();
+    }
+
+    layout();
+
+    const Block &block = m_blocks[index];
+    const int from = first - block.firstRow;
+    const int to = qMin(last - block.firstRow, laidOutRowCount(block) - 1);
+    if (block.collapsed || from > to) {
+        return QRect();
+    }
+
+    // lines are covered whatever their width, items wider than the viewport included. The rows of
+    // an evicted block do not say which items they hold, the block is covered as a whole.
+    const int left = std::numeric_limits<int>::min() / 2;
+    const int right = std::numeric_limits<int>::max() / 2;
+    const QRect blockRect(QPoint(left, block.position.y()), QPoint(right, block.position.y() + block.height - 1));
+    if (block.evicted) {
+        return blockRect;
+    }
+
+    const BlockItems items(m_params, block.itemSize, block.items.constData());
+    const Item firstItem = items[from];
+    const Item lastItem = items[to];
+    if (firstItem.topLeft.y() == lastItem.topLeft.y()) {
+        return blockItemRect(block, firstItem) | blockItemRect(block, lastItem);
+    }
+    if (m_params.topToBottom) {
+        return blockRect;
+    }
+
+    // from the line of the first item to the end of the line of the last one, across the block
+    int bottom = blockItemRect(block, lastItem).bottom();
+    const int count = laidOutRowCount(block);
+    for (int i = to + 1; i < count && items[i].topLeft.y() == lastItem.topLeft.y(); ++i) {
+        bottom = qMax(bottom, blockItemRect(block, items[i]).bottom());
+    }
+    for (int i = to - 1; i > from && items[i].topLeft.y() == lastItem.topLeft.y(); --i) {
+        bottom = qMax(bottom, blockItemRect(block, items[i]).bottom());
+    }
+    return QRect(QPoint(left, block.position.y() + firstItem.topLeft.y()), QPoint(right, bottom));
+}
+
+QList<KCategorizedLayoutEngine::RowSpan> KCategorizedLayoutEngine::findRows(const QRect &_rect, KCategorizedLayout::Match match)
+{
+    QList<RowSpan> rows;
+
+    const QRect rect = _rect.normalized();
+    if (rect.isEmpty()) {
+        return rows;
+    }
+
+    layout();
+
+    // blocks are sorted vertically too, and do not overlap
+    int index = std::lower_bound(m_blocks.cbegin(),
+                                 m_blocks.cend(),
+                                 rect.top(),
+                                 [](const Block &block, int top) {
+                                     return block.position.y() + (block.collapsed ? 0 : block.height) <= top;
+                                 })
+        - m_blocks.cbegin();
+
+    QList<KCategorizedLayout::Span> spans;
+    bool reloaded = false;
+    for (; index < m_blocks.count() && m_blocks[index].position.y() <= rect.bottom(); ++index) {
+        const Block &block = m_blocks[index];
+        if (block.collapsed) {
+            continue;
+        }
+
+        spans.clear();
+        const QRect blockRect = rect.translated(0, -block.position.y());
+        if (block.evicted) {
+            // rows are sorted vertically, and only a rect touching one of them can touch items
+            const auto row = std::lower_bound(block.rows.cbegin(), block.rows.cend(), blockRect.top(), [](const RowSummary &row, int top) {
+                return row.y + row.height <= top;
+            });
+            if (row == block.rows.cend() || row->y > blockRect.bottom()) {
+                continue;
+            }
+            reload(index);
+            reloaded = true;
+        }
+
+        if (block.itemSize.isValid()) {
+            KCategorizedLayout::FixedSizeLayout(m_params, block.itemSize).findItems(laidOutRowCount(block), blockRect, match, spans);
+        } else {
+            KCategorizedLayout::findItems(block.items.constData(), block.items.count(), blockRect, m_params.gridSize, match, spans);
+        }
+        for (const KCategorizedLayout::Span &span : std::as_const(spans)) {
+            rows.append({index, block.firstRow + span.first, block.firstRow + span.last});
+        }
+    }
+
+    if (reloaded) {
+        evictFarBlocks();
+    }
+
+    return rows;
+}
+
+int KCategorizedLayoutEngine::rowBelow(int x, int y)
+{
+    layout();
+
+    // the first block ending below y is the first one that can have a line below it
+    int index = std::lower_bound(m_blocks.cbegin(),
+                                 m_blocks.cend(),
+                                 y,
+                                 [](const Block &block, int y) {
+                                     return block.position.y() + (block.collapsed ? 0 : block.height) <= y;
+                                 })
+        - m_blocks.cbegin();
+
+    for (; index < m_blocks.count(); ++index) {
+        const Block &block = m_blocks[index];
+        if (block.collapsed || block.hiddenCount == block.rowCount) {
+            continue;
+        }
+
+        // tops only grow with the rows, and so do the rows of an evicted block
+        const int blockY = y - block.position.y();
+        if (block.evicted) {
+            const int line = partitionPoint(0, block.rows.count(), [&](int i) {
+                return block.rows[i].y <= blockY;
+            });
+            const int row = line < block.rows.count() ? closestInLine(index, block.rows[line].y, x) : -1;
+            if (row != -1) {
+                return row;
+            }
+            continue;
+        }
+
+        const BlockItems items(m_params, block.itemSize, block.items.constData());
+        const int count = laidOutRowCount(block);
+        const int line = partitionPoint(0, count, [&](int i) {
+            return items[i].topLeft.y() <= blockY;
+        });
+        const int row = line < count ? closestInLine(index, items[line].topLeft.y(), x) : -1;
+        if (row != -1) {
+            return row;
+        }
+    }
+
+    return -1;
+}
+
+int KCategorizedLayoutEngine::rowAbove(int x, int y)
+{
+    layout();
+
+    // the last block starting above y is the last one that can have a line above it
+    int index = std::lower_bound(m_blocks.cbegin(),
+                                 m_blocks.cend(),
+                                 y,
+                                 [](const Block &block, int y) {
+                                     return block.position.y() < y;
+                                 })
+        - m_blocks.cbegin() - 1;
+
+    for (; index >= 0; --index) {
+        const Block &block = m_blocks[index];
+        if (block.collapsed || block.hiddenCount == block.rowCount) {
+            continue;
+        }
+
+        const int blockY = y - block.position.y();
+        if (block.evicted) {
+            const int line = partitionPoint(0, block.rows.count(), [&](int i) {
+                return block.rows[i].y < blockY;
+            });
+            const int row = line > 0 ? closestInLine(index, block.rows[line - 1].y, x) : -1;
+            if (row != -1) {
+                return row;
+            }
+            continue;
+        }
+
+        const BlockItems items(m_params, block.itemSize, block.items.constData());
+        const int line = partitionPoint(0, laidOutRowCount(block), [&](int i) {
+            return items[i].topLeft.y() < blockY;
+        });
+        const int row = line > 0 ? closestInLine(index, items[line - 1].topLeft.y(), x) : -1;
+        if (row != -1) {
+            return row;
+        }
+    }
+
+    return -1;
+}
+
+QByteArray KCategorizedLayoutEngine::saveSnapshot(quint64 fingerprint, const QByteArray &userData)
+{
+    layout();
+
+    QByteArray snapshot;
+    writeWord(snapshot, s_snapshotMagic);
+    writeWord(snapshot, s_snapshotVersion);
+    writeWord(snapshot, qint32(fingerprint));
+    writeWord(snapshot, qint32(fingerprint >> 32));
+
+    // BEGIN: params
+    writeWord(snapshot, m_params.blockX);
+    writeWord(snapshot, m_params.leftMargin);
+    writeWord(snapshot, m_params.viewportWidth);
+    writeWord(snapshot, m_params.spacing);
+    writeWord(snapshot, m_params.gridSize.width());
+    writeWord(snapshot, m_params.gridSize.height());
+    writeWord(snapshot,
+              (m_params.uniformItemSizes ? UniformItemSizes : 0) | (m_params.rightToLeft ? RightToLeft : 0) | (m_params.topToBottom ? TopToBottom : 0));
+    writeWord(snapshot, m_uniformSize.width());
+    writeWord(snapshot, m_uniformSize.height());
+    writeWord(snapshot, m_rowLimit);
+    // END: params
+
+    // BEGIN: block table
+    writeWord(snapshot, m_rowCount);
+    writeWord(snapshot, m_blocks.count());
+    for (const Block &block : std::as_const(m_blocks)) {
+        writeWord(snapshot, block.category);
+        writeWord(snapshot, block.firstRow);
+        writeWord(snapshot, block.rowCount);
+        writeWord(snapshot, block.height);
+        writeWord(snapshot, block.headerHeight);
+        writeWord(snapshot, (block.collapsed ? Collapsed : 0) | (block.evicted ? Evicted : 0) | (block.itemSize.isValid() ? FixedSize : 0)
+                  | (block.unlimited ? Unlimited : 0));
+        writeWord(snapshot, block.itemSize.width());
+        writeWord(snapshot, block.itemSize.height());
+        writeWord(snapshot, block.evicted ? block.rows.count() : block.items.count());
+    }
+    // END: block table
+
+    // BEGIN: item sizes, and rows of the evicted blocks
+    for (const Block &block : std::as_const(m_blocks)) {
+        for (const RowSummary &row : block.rows) {
+            writeWord(snapshot, row.y);
+            writeWord(snapshot, row.height);
+        }
+        for (int i = 0; i < block.items.count(); ++i) {
+            // hidden items are measured again once restored
+            const QSize size = block.hiddenCount && block.hidden[i] ? QSize() : block.items[i].size;
+            writeWord(snapshot, size.width());
+            writeWord(snapshot, size.height());
+        }
+    }
+    // END: item sizes, and rows of the evicted blocks
+
+    writeWord(snapshot, userData.size());
+    snapshot.append(userData);
+
+    return snapshot;
+}
+
+bool KCategorizedLayoutEngine::restoreSnapshot(const QByteArray &snapshot, quint64 fingerprint, QByteArray *userData)
+{
+    SnapshotReader reader(snapshot);
+    qint32 magic = 0;
+    qint32 version = 0;
+    qint32 fingerprintLow = 0;
+    qint32 fingerprintHigh = 0;
+    if (!reader.read(magic) || !reader.read(version) || !reader.read(fingerprintLow) || !reader.read(fingerprintHigh)) {
+        return false;
+    }
+    if (magic != s_snapshotMagic || version != s_snapshotVersion || (quint64(quint32(fingerprintHigh)) << 32 | quint32(fingerprintLow)) != fingerprint) {
+        return false;
+    }
+
+    // BEGIN: params
+    KCategorizedLayout::Params params;
+    qint32 gridWidth = 0;
+    qint32 gridHeight = 0;
+    qint32 flags = 0;
+    qint32 uniformWidth = 0;
+    qint32 uniformHeight = 0;
+    qint32 rowLimit = 0;
+    if (!reader.read(params.blockX) || !reader.read(params.leftMargin) || !reader.read(params.viewportWidth) || !reader.read(params.spacing)
+        || !reader.read(gridWidth) || !reader.read(gridHeight) || !reader.read(flags) || !reader.read(uniformWidth) || !reader.read(uniformHeight)
+        || !reader.read(rowLimit) || rowLimit < 0) {
+        return false;
+    }
+    // the size of uniform items is unknown until one is asked for
+    const QSize uniformSize(uniformWidth, uniformHeight);
+    if (!uniformSize.isValid() && uniformSize != QSize()) {
+        return false;
+    }
+    params.gridSize = QSize(gridWidth, gridHeight);
+    params.uniformItemSizes = flags & UniformItemSizes;
+    params.rightToLeft = flags & RightToLeft;
+    params.topToBottom = flags & TopToBottom;
+    // END: params
+
+    // BEGIN: block table
+    qint32 rowCount = 0;
+    qint32 blockCount = 0;
+    if (!reader.read(rowCount) || !reader.read(blockCount) || rowCount < 0 || blockCount < 0 || blockCount > reader.remainingWords() / s_snapshotBlockWords) {
+        return false;
+    }
+
+    QList<Block> blocks(blockCount);
+    QList<qint32> dataCounts(blockCount);
+    QSet<int> categories;
+    int nextRow = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        Block &block = blocks[i];
+        qint32 blockFlags = 0;
+        qint32 itemWidth = 0;
+        qint32 itemHeight = 0;
+        reader.read(block.category);
+        reader.read(block.firstRow);
+        reader.read(block.rowCount);
+        reader.read(block.height);
+        reader.read(block.headerHeight);
+        reader.read(blockFlags);
+        reader.read(itemWidth);
+        reader.read(itemHeight);
+        reader.read(dataCounts[i]);
+
+        // blocks follow each other without gaps, categories have one block each, and nothing has
+        // a negative size
+        if (block.firstRow != nextRow || block.rowCount <= 0 || block.rowCount > rowCount - nextRow || categories.contains(block.category)
+            || block.height < 0 || block.headerHeight < 0 || (blockFlags & FixedSize && (itemWidth < 0 || itemHeight < 0))) {
+            return false;
+        }
+        nextRow += block.rowCount;
+        categories.insert(block.category);
+
+        block.collapsed = blockFlags & Collapsed;
+        block.evicted = blockFlags & Evicted;
+        block.itemSize = blockFlags & FixedSize ? QSize(itemWidth, itemHeight) : QSize();
+        block.unlimited = blockFlags & Unlimited;
+        const int count = block.unlimited || !rowLimit ? block.rowCount : qMin(block.rowCount, rowLimit);
+        block.layoutFrom = count;
+        const qint32 expectedData = block.itemSize.isValid() ? 0 : count;
+        if (block.evicted ? block.itemSize.isValid() || dataCounts[i] <= 0 || dataCounts[i] > count : dataCounts[i] != expectedData) {
+            return false;
+        }
+    }
+    if (nextRow != rowCount) {
+        return false;
+    }
+    // END: block table
+
+    // BEGIN: item sizes, and rows of the evicted blocks
+    for (int i = 0; i < blockCount; ++i) {
+        Block &block = blocks[i];
+        if (dataCounts[i] > reader.remainingWords() / 2) {
+            return false;
+        }
+
+        if (block.evicted) {
+            // rows go down, and stay within the block
+            block.rows.resize(dataCounts[i]);
+            int previousY = 0;
+            for (RowSummary &row : block.rows) {
+                reader.read(row.y);
+                reader.read(row.height);
+                if (row.y < previousY || row.height < 0 || row.y > block.height - row.height) {
+                    return false;
+                }
+                previousY = row.y;
+            }
+            continue;
+        }
+
+        if (block.itemSize.isValid()) {
+            continue;
+        }
+
+        block.items.resize(dataCounts[i]);
+        for (Item &item : block.items) {
+            qint32 width = 0;
+            qint32 height = 0;
+            reader.read(width);
+            reader.read(height);
+            item.size = QSize(width, height);
+            // hidden items were saved without a size, to be measured again
+            if (!item.size.isValid() && item.size != QSize()) {
+                return false;
+            }
+        }
+        // positions were not saved, they are computed again from the sizes
+        block.layoutFrom = 0;
+    }
+    // END: item sizes, and rows of the evicted blocks
+
+    qint32 userDataSize = 0;
+    if (!reader.read(userDataSize) || userDataSize != reader.remainingBytes()) {
+        return false;
+    }
+    if (userData) {
+        *userData = reader.remaining();
+    }
+
+    m_params = params;
+    m_uniformSize = uniformSize;
+    m_rowLimit = rowLimit;
+    m_blocks = blocks;
+    m_categoryBlocks.clear();
+    for (int i = 0; i < m_blocks.count(); ++i) {
+        m_categoryBlocks.insert(m_blocks[i].category, i);
+    }
+    m_rowCount = rowCount;
+    m_firstDirtyBlock = 0;
+
+    return true;
+}
+
+void KCategorizedLayoutEngine::insertBlock(int index, const Block &block)
+{
+    m_blocks.insert(index, block);
+    for (int i = index; i < m_blocks.count(); ++i) {
+        m_categoryBlocks.insert(m_blocks[i].category, i);
+    }
+}
+
+void KCategorizedLayoutEngine::removeBlock(int index)
+{
+    m_categoryBlocks.remove(m_blocks[index].category);
+    m_blocks.removeAt(index);
+    for (int i = index; i < m_blocks.count(); ++i) {
+        m_categoryBlocks.insert(m_blocks[i].category, i);
+    }
+}
+
+void KCategorizedLayoutEngine::markDirty(int block)
+{
+    m_firstDirtyBlock = qMin(m_firstDirtyBlock, qMax(block, 0));
+}
+
+int KCategorizedLayoutEngine::laidOutRowCount(const Block &block) const
+{
+    return block.unlimited || !m_rowLimit ? block.rowCount : qMin(block.rowCount, m_rowLimit);
+}
+
+void KCategorizedLayoutEngine::laidOutRowCountChanged(int index, int previousCount)
+{
+    Block &block = m_blocks[index];
+    const int count = laidOutRowCount(block);
+    if (count == previousCount) {
+        return;
+    }
+
+    // rows within both counts keep their item, the other ones get one or lose it
+    if (!block.itemSize.isValid()) {
+        restore(block);
+        block.items.resize(count);
+    }
+    block.layoutFrom = qMin(block.layoutFrom, qMin(count, previousCount));
+    block.height = -1;
+    markDirty(index);
+}
+
+void KCategorizedLayoutEngine::restore(Block &block)
+{
+    if (!block.evicted) {
+        return;
+    }
+
+    block.items.resize(laidOutRowCount(block));
+    block.rows = QList<RowSummary>();
+    block.evicted = false;
+    block.layoutFrom = 0;
+}
+
+int KCategorizedLayoutEngine::restoreAndLayout(Block &block)
+{
+    restore(block);
+    Item *items = block.items.data();
+    for (int i = 0; i < block.items.count(); ++i) {
+        items[i].size = block.hiddenCount && block.hidden[i] ? QSize(0, 0) : m_sizeHint(block.firstRow + i);
+    }
+    const int height = layoutItems(m_params, KCategorizedLayout::kernelFor(m_params), block, 0);
+    block.layoutFrom = block.items.count();
+    return height;
+}
+
+void KCategorizedLayoutEngine::reload(int index)
+{
+    Block &block = m_blocks[index];
+    if (!block.evicted) {
+        return;
+    }
+
+    const int height = restoreAndLayout(block);
+    ++m_reloads;
+
+    // sizes changed without being told, the blocks below move
+    if (height != block.height) {
+        block.height = height;
+        markDirty(index + 1);
+    }
+}
+
+int KCategorizedLayoutEngine::layoutItems(const KCategorizedLayout::Params &params, KCategorizedLayout::Kernel kernel, Block &block, int from)
+{
+    const int count = block.items.count();
+    if (!block.hiddenCount) {
+        return count ? kernel(params, block.items.data(), count, from) : 0;
+    }
+
+    // The kernels position every item they are given, so they only get the shown ones. Hidden
+    // items then take the position of the shown item before them, or after them at the start of
+    // the block, with no size: tops still only grow with the rows, every line has a shown item,
+    // and rect searches never find them.
+    QList<Item> shown;
+    shown.reserve(count);
+    int shownFrom = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!block.hidden[i]) {
+            shown.append(block.items[i]);
+            shownFrom += i < from;
+        }
+    }
+    const int height = shown.isEmpty() ? 0 : kernel(params, shown.data(), shown.count(), shownFrom);
+
+    Item *items = block.items.data();
+    int next = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!block.hidden[i]) {
+            items[i] = shown[next++];
+        } else {
+            const QPoint topLeft = shown.isEmpty() ? QPoint() : shown[qMax(next - 1, 0)].topLeft;
+            items[i] = {topLeft, QSize(0, 0)};
+        }
+    }
+    return height;
+}
+
+int KCategorizedLayoutEngine::closestInLine(int index, int top, int x)
+{
+    reload(index);
+
+    const Block &block = m_blocks[index];
+    const BlockItems items(m_params, block.itemSize, block.items.constData());
+    const int count = laidOutRowCount(block);
+    const int first = partitionPoint(0, count, [&](int i) {
+        return items[i].topLeft.y() < top;
+    });
+    const int last = partitionPoint(first, count, [&](int i) {
+        return items[i].topLeft.y() <= top;
+    });
+    if (first == last) {
+        // laying the block out again moved its lines, take the one that is now there
+        const int row = block.firstRow + qMin(first, count - 1);
+        const int shown = shownRow(row, true);
+        return shown == -1 ? shownRow(row, false) : shown;
+    }
+
+    // with a grid, items are centered in their cell
+    const int gridWidth = m_params.gridSize.isValid() && !m_params.gridSize.isNull() ? m_params.gridSize.width() : 0;
+    const auto center = [&](int i) {
+        const Item item = items[i];
+        return item.topLeft.x() + (gridWidth ? gridWidth : item.size.width()) / 2;
+    };
+
+    // hidden items sit on the shown ones, the closest shown one is looked for one by one
+    if (block.hiddenCount) {
+        int closest = -1;
+        for (int i = first; i < last; ++i) {
+            if (!block.hidden[i] && (closest == -1 || qAbs(center(i) - x) < qAbs(center(closest) - x))) {
+                closest = i;
+            }
+        }
+        // only when all the laid out items are hidden
+        return closest == -1 ? -1 : block.firstRow + closest;
+    }
+
+    // items of a line go right, or left with right to left, so the closest one is either the
+    // first one past x or the one before it
+    const bool rightToLeft = m_params.rightToLeft;
+    const int past = partitionPoint(first, last, [&](int i) {
+        return rightToLeft ? center(i) > x : center(i) < x;
+    });
+    if (past == last) {
+        return block.firstRow + last - 1;
+    }
+    if (past > first && qAbs(center(past - 1) - x) <= qAbs(center(past) - x)) {
+        return block.firstRow + past - 1;
+    }
+    return block.firstRow + past;
+}
+
+void KCategorizedLayoutEngine::evictFarBlocks()
+{
+    // without a visible rect, every block would be as far from it, and the ones about to be shown
+    // could go first
+    if (!m_memoryBudget || m_visibleRect.isNull()) {
+        return;
+    }
+
+    struct Candidate {
+        int distance;
+        int index;
+    };
+
+    qsizetype bytes = 0;
+    QList<Candidate> candidates;
+    for (int i = 0; i < m_blocks.count(); ++i) {
+        const Block &block = m_blocks[i];
+        bytes += blockBytes(block);
+        if (block.evicted || block.items.isEmpty() || block.height == -1 || block.layoutFrom < block.items.count()) {
+            continue;
+        }
+
+        const int top = block.position.y() - block.headerHeight;
+        const int bottom = block.position.y() + (block.collapsed ? 0 : block.height);
+        const int distance = qMax(top - m_visibleRect.bottom(), m_visibleRect.top() - bottom);
+        if (distance > 0) {
+            candidates.append({distance, i});
+        }
+    }
+    if (bytes <= m_memoryBudget) {
+        return;
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.distance > b.distance;
+    });
+    for (const Candidate &candidate : std::as_const(candidates)) {
+        Block &block = m_blocks[candidate.index];
+        bytes -= blockBytes(block);
+        evict(block);
+        ++m_evictions;
+
+        bytes += blockBytes(block);
+        if (bytes <= m_memoryBudget) {
+            break;
+        }
+    }
+}
+
+void KCategorizedLayoutEngine::evict(Block &block)
+{
+    // items of a row share their top. With a grid, they are cut to their cell, as itemRect() does,
+    // so that rows stay within the block.
+    const QSize gridSize = m_params.gridSize;
+    const int maxHeight = gridSize.isValid() && !gridSize.isNull() ? gridSize.height() : std::numeric_limits<int>::max();
+    const Item *items = block.items.constData();
+    for (int i = 0; i < block.items.count(); ++i) {
+        const int y = items[i].topLeft.y();
+        if (block.rows.isEmpty() || block.rows.constLast().y != y) {
+            block.rows.append({y, 0});
+        }
+        block.rows.last().height = qMax(block.rows.constLast().height, qMin(items[i].size.height(), maxHeight));
+    }
+    block.rows.squeeze();
+    block.items = QList<Item>();
+    block.evicted = true;
+}
+
+QRect KCategorizedLayoutEngine::blockItemRect(const Block &block, const Item &item) const
+{
+    QRect rect(item.topLeft.x(), block.position.y() + item.topLeft.y(), item.size.width(), item.size.height());
+    const QSize gridSize = m_params.gridSize;
+    if (gridSize.isValid() && !gridSize.isNull()) {
+        rect.setSize(item.size.boundedTo(gridSize));
+        rect.moveLeft(item.topLeft.x() + (gridSize.width() - rect.width()) / 2);
+    }
+    return rect;
+}
+
+qsizetype KCategorizedLayoutEngine::blockBytes(const Block &block)
+{
+    return block.items.capacity() * sizeof(Item) + block.rows.capacity() * sizeof(RowSummary) + block.hidden.capacity() / 8;
+}
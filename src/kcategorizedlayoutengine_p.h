@@ -0,0 +1,543 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCATEGORIZEDLAYOUTENGINE_P_H
+#define KCATEGORIZEDLAYOUTENGINE_P_H
+
+#include "kcategorizedlayout_p.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QRect>
+
+#include <functional>
+#include <vector>
+
+/*!
+ * \internal
+ *
+ * The layout of KCategorizedView, without the view. Rows are plain integers, categories are
+ * integer ids chosen by the caller, and the size of the items and the height of the category
+ * headers are asked for through functions, so the engine does not know about models, indexes or
+ * widgets and can be used, tested and benchmarked without a QApplication.
+ *
+ * Rows of the same category have to be consecutive. They form a block, and blocks are stacked
+ * vertically in row order, each one below its header. Items are positioned relative to their
+ * block, so that changes in a block only move the blocks below it as a whole.
+ *
+ * Changes are recorded as they come, and the engine lays out what they affected the next time a
+ * position is asked for, or when layout() is called. Sizes are only asked for the items that do
+ * not have one yet, on the calling thread, and the items are then positioned by the kernels of
+ * KCategorizedLayout, on the global thread pool when there are enough of them.
+ *
+ * Blocks whose items all have the same size, either because the params ask for uniform item sizes
+ * or because the block item size function says so, do not store their items. Those are positioned
+ * arithmetically when asked for.
+ *
+ * Rows can be hidden. Blocks keep a bit per row while some of theirs are, and lay out their other
+ * items as if the hidden ones were not there.
+ *
+ * With a row limit, blocks only lay out and store their first rows, unless told to show all of
+ * them. The rows beyond the limit are counted, nothing more.
+ *
+ * With a memory budget, the items of the blocks farthest from the visible rect are evicted once
+ * the stored items exceed it. Evicted blocks keep their height and the top and
+ * height of their rows, which is enough to position the blocks and to know whether a rect touches
+ * their items, and they are laid out again when their items are needed. When the whole layout
+ * changes, evicted blocks are measured and laid out again one at a time, and stay evicted.
+ *
+ * The layout can be saved to a snapshot and restored from it, so that a model shown again does not
+ * have its items measured again.
+ */
+class KCategorizedLayoutEngine
+{
+public:
+    /*!
+     * Returns the size of the item at \a row.
+     */
+    using SizeHintFunction = std::function<QSize(int row)>;
+
+    /*!
+     * Returns the height of the header of the block starting at \a firstRow.
+     */
+    using HeaderHeightFunction = std::function<int(int firstRow)>;
+
+    /*!
+     * Returns the size all items of the block starting at \a firstRow have, or an invalid size
+     * if they do not all have the same size.
+     */
+    using BlockItemSizeFunction = std::function<QSize(int firstRow)>;
+
+    /*!
+     * \internal
+     *
+     * Rows \a first to \a last of \a block, inclusive.
+     */
+    struct RowSpan {
+        int block;
+        int first;
+        int last;
+    };
+
+    /*!
+     * \internal
+     *
+     * How much memory the stored items take, and how often blocks were evicted to stay in the
+     * memory budget.
+     */
+    struct CacheStatistics {
+        // bytes taken by the items and row summaries of all blocks
+        qsizetype bytes = 0;
+        // blocks whose items are currently evicted
+        int evictedBlocks = 0;
+        // times a block was evicted, and laid out again after that
+        quint64 evictions = 0;
+        quint64 reloads = 0;
+    };
+
+    KCategorizedLayoutEngine();
+    ~KCategorizedLayoutEngine();
+
+    KCategorizedLayoutEngine(const KCategorizedLayoutEngine &) = delete;
+    KCategorizedLayoutEngine &operator=(const KCategorizedLayoutEngine &) = delete;
+
+    /*!
+     * Sets the function asked for the size of the items to \a sizeHint.
+     */
+    void setSizeHintFunction(const SizeHintFunction &sizeHint);
+
+    /*!
+     * Sets the function asked for the height of the block headers to \a headerHeight. Headers
+     * have no height if none is set.
+     */
+    void setHeaderHeightFunction(const HeaderHeightFunction &headerHeight);
+
+    /*!
+     * Sets the function asked whether all items of a block have the same size to
+     * \a blockItemSize. It is asked whenever a block has to be laid out again, and the size
+     * function is then not asked for the items of blocks it gives a size for. Ignored when the
+     * params ask for uniform item sizes.
+     */
+    void setBlockItemSizeFunction(const BlockItemSizeFunction &blockItemSize);
+
+    /*!
+     * Returns what the layout depends on.
+     */
+    KCategorizedLayout::Params params() const;
+
+    /*!
+     * Sets what the layout depends on to \a params. All items are positioned again if they
+     * changed, and their sizes are asked for again if the flow or uniformity of sizes changed.
+     * The sizes of the items of evicted blocks are asked for again in any case.
+     */
+    void setParams(const KCategorizedLayout::Params &params);
+
+    /*!
+     * Returns how many bytes the stored items may take, 0 if unlimited.
+     */
+    qsizetype memoryBudget() const;
+
+    /*!
+     * Sets how many bytes the stored items may take to \a bytes, 0 for unlimited, the default.
+     * Blocks overlapping visibleRect() are never evicted, so the budget can be exceeded when
+     * those are big enough. Nothing is evicted while visibleRect() is null.
+     */
+    void setMemoryBudget(qsizetype bytes);
+
+    /*!
+     * Returns the rect the caller shows, null until setVisibleRect() is called.
+     */
+    QRect visibleRect() const;
+
+    /*!
+     * Sets the rect the caller shows to \a rect. Blocks overlapping it are never evicted, and the
+     * other ones are evicted the sooner the farther they are from it.
+     */
+    void setVisibleRect(const QRect &rect);
+
+    /*!
+     * Returns how much memory the stored items take, and how often blocks were evicted.
+     *
+     * Complexity: O(b) where b is the number of blocks.
+     */
+    CacheStatistics cacheStatistics() const;
+
+    /*!
+     * Returns the number of rows.
+     */
+    int rowCount() const;
+
+    /*!
+     * Removes all rows.
+     */
+    void clear();
+
+    /*!
+     * Inserts \a count rows of \a category at \a row. They join the block of \a category if there
+     * is one, and get a new block otherwise.
+     *
+     * Returns false, changing nothing, if the rows would not be next to the other rows of
+     * \a category, or would split the block of another category.
+     *
+     * Complexity: O(b + m) where b is the number of blocks and m the number of items in the block
+     *             of \a category.
+     */
+    bool insertRows(int row, int count, int category);
+
+    /*!
+     * Removes \a count rows starting at \a row. Blocks left without rows are removed.
+     *
+     * Complexity: O(b + m) where b is the number of blocks and m the number of items in the
+     *             blocks the rows belonged to.
+     */
+    void removeRows(int row, int count);
+
+    /*!
+     * Records that the size of the items from \a first to \a last might have changed. Their size
+     * is asked for again. With uniform item sizes, all items might have changed.
+     */
+    void resizeRows(int first, int last);
+
+    /*!
+     * Forgets the size and position of all items, so that they are asked for and computed again.
+     *
+     * Complexity: O(n) where n is rowCount().
+     */
+    void invalidate();
+
+    /*!
+     * Returns the number of blocks.
+     */
+    int blockCount() const;
+
+    /*!
+     * Returns the block holding \a row, or -1 if there is none.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks.
+     */
+    int blockForRow(int row) const;
+
+    /*!
+     * Returns the block of \a category, or -1 if there is none.
+     */
+    int blockForCategory(int category) const;
+
+    /*!
+     * Returns the category of \a block.
+     */
+    int blockCategory(int block) const;
+
+    /*!
+     * Returns the first row of \a block.
+     */
+    int blockFirstRow(int block) const;
+
+    /*!
+     * Returns the number of rows of \a block.
+     */
+    int blockRowCount(int block) const;
+
+    /*!
+     * Returns whether \a block is collapsed. Collapsed blocks only show their header.
+     */
+    bool isBlockCollapsed(int block) const;
+
+    /*!
+     * Collapses \a block if \a collapsed is true, and expands it otherwise.
+     */
+    void setBlockCollapsed(int block, bool collapsed);
+
+    /*!
+     * Returns how many rows of a block are laid out at most, 0 if all of them are.
+     */
+    int rowLimit() const;
+
+    /*!
+     * Sets how many rows of a block are laid out at most to \a limit, 0 for all of them, the
+     * default. Rows beyond the limit are not asked for their size, get no item and are never
+     * found, as if they were hidden. Blocks told to show all their rows ignore the limit.
+     *
+     * Only the blocks with more rows than the old or new limit are laid out again.
+     *
+     * Complexity: O(b) where b is the number of blocks.
+     */
+    void setRowLimit(int limit);
+
+    /*!
+     * Returns whether \a block shows all its rows, whatever the row limit.
+     */
+    bool isBlockUnlimited(int block) const;
+
+    /*!
+     * Makes \a block show all its rows if \a unlimited is true, and only the ones within the row
+     * limit otherwise. Blocks are limited when they are created.
+     */
+    void setBlockUnlimited(int block, bool unlimited);
+
+    /*!
+     * Returns the number of rows of \a block beyond the row limit, which are not laid out.
+     */
+    int blockCappedRowCount(int block) const;
+
+    /*!
+     * Returns whether \a row is beyond the row limit of its block.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks.
+     */
+    bool isRowCapped(int row) const;
+
+    /*!
+     * Returns whether \a row is hidden.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks.
+     */
+    bool isRowHidden(int row) const;
+
+    /*!
+     * Hides the rows from \a first to \a last, inclusive, if \a hidden is true, and shows them
+     * otherwise. Hidden items take no room and are never found, the other items of their block
+     * are laid out as if they were not there. Shown items are asked for their size again.
+     *
+     * Only the blocks of the rows are laid out again, once, the next time a position is asked
+     * for. Blocks with hidden rows store their items, even when these all have the same size.
+     *
+     * Complexity: O(log(b) + k) where b is the number of blocks and k the number of rows.
+     */
+    void setRowsHidden(int first, int last, bool hidden);
+
+    /*!
+     * Returns the number of hidden rows of \a block.
+     */
+    int blockHiddenRowCount(int block) const;
+
+    /*!
+     * Returns \a row if its item is shown, that is, neither hidden, capped by the row limit nor in
+     * a collapsed block.
+     * Otherwise returns the first row after it whose item is shown, or the last one before it if
+     * \a forward is false, and -1 if there is none.
+     *
+     * Complexity: O(log(b) + c + k) where b is the number of blocks, c the number of blocks
+     *             skipped and k the number of hidden rows skipped.
+     */
+    int shownRow(int row, bool forward) const;
+
+    /*!
+     * Returns whether every item has been positioned since the last change.
+     */
+    bool isLaidOut() const;
+
+    /*!
+     * Positions the items and blocks affected by the changes recorded since the last call.
+     *
+     * Complexity: O(b + m) where b is the number of blocks under the first change and m the number
+     *             of items that have to be positioned again.
+     */
+    void layout();
+
+    /*!
+     * Returns the top left of the items of \a block, right below its header.
+     */
+    QPoint blockPosition(int block);
+
+    /*!
+     * Returns the height of the header of \a block.
+     */
+    int blockHeaderHeight(int block);
+
+    /*!
+     * Returns the height of the items of \a block, 0 if it is collapsed.
+     */
+    int blockHeight(int block);
+
+    /*!
+     * Returns the last block whose header starts at or above \a y, or -1 if there is none.
+     * Collapsed blocks are found too.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks, once laid out.
+     */
+    int blockAt(int y);
+
+    /*!
+     * Returns the height of the highest item in the last row of \a block.
+     */
+    int lastRowHeight(int block);
+
+    /*!
+     * Returns the rect of the item at \a row, or an invalid rect if there is none, or it is
+     * hidden or capped by the row limit. With a grid, the size of the item is bounded to the grid,
+     * and the item is centered horizontally in its cell. Items of collapsed blocks are moved to the left of the view and get no height.
+     *
+     * The block of \a row is laid out again if it was evicted, and blocks far from visibleRect()
+     * might get evicted afterwards. rowsRect() does not need the items.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks, once laid out and unless the block of
+     *             \a row was evicted.
+     */
+    QRect itemRect(int row);
+
+    /*!
+     * Returns a rect covering the items from \a first to \a last, inclusive, which have to be rows
+     * of the same block. The rect spans the items when they are on one line, and any width from
+     * the line of \a first to the one of \a last otherwise. Evicted blocks are covered as
+     * a whole, since the summary of their rows does not say which items these hold, and are not
+     * laid out again. Returns an invalid rect if the block is collapsed or none of the rows is
+     * laid out.
+     *
+     * Complexity: O(log(b) + l) where b is the number of blocks and l the number of items in the
+     *             line of \a last, once laid out.
+     */
+    QRect rowsRect(int first, int last);
+
+    /*!
+     * Returns the rows of the items whose rect intersects \a rect, or is contained in it
+     * depending on \a match, as runs of consecutive rows in row order. A run never crosses
+     * blocks, and items of collapsed blocks are left out.
+     *
+     * Blocks far from visibleRect() might get evicted afterwards, if looking for the rows laid out
+     * evicted ones again and the stored items exceed the memory budget.
+     *
+     * Complexity: O(log(b) + log(n) + k) where b is the number of blocks, n the number of items
+     *             in the blocks \a rect overlaps and k the number of items in the rows it overlaps.
+     */
+    QList<RowSpan> findRows(const QRect &rect, KCategorizedLayout::Match match = KCategorizedLayout::Match::Intersects);
+
+    /*!
+     * Returns the row of the item closest to \a x in the first line of items below \a y, or -1 if
+     * there is none. A line is made of the items of a block that share their top, and the first
+     * line below \a y is the one with the lowest top greater than \a y. Items of collapsed blocks
+     * and hidden items are skipped.
+     *
+     * Items are as close to \a x as the horizontal center of their rect is, the rect itemRect()
+     * gives.
+     *
+     * Complexity: O(log(b) + log(m) + c) where b is the number of blocks, m the number of items of
+     *             the block of the line and c the number of collapsed blocks skipped, unless that
+     *             block was evicted. The items of the line are looked at one by one when its
+     *             block has hidden rows.
+     */
+    int rowBelow(int x, int y);
+
+    /*!
+     * Returns the row of the item closest to \a x in the last line of items above \a y, that is,
+     * the line with the highest top lower than \a y, or -1 if there is none. Same as rowBelow()
+     * otherwise.
+     */
+    int rowAbove(int x, int y);
+
+    /*!
+     * Returns a snapshot of the layout: the params, the blocks, the size of their items, or the
+     * rows of the evicted ones, then \a userData. \a fingerprint identifies what the layout was
+     * made of, restoreSnapshot() only accepts the snapshot for the same fingerprint.
+     *
+     * Hidden rows are not saved: they are restored as shown rows to be measured, and have to be
+     * hidden again.
+     *
+     * The snapshot is made of little endian 32 bit integers, so that it can be read right from a
+     * memory mapped file.
+     *
+     * Complexity: O(n) where n is rowCount().
+     */
+    QByteArray saveSnapshot(quint64 fingerprint, const QByteArray &userData = QByteArray());
+
+    /*!
+     * Replaces the layout with the one saved in \a snapshot, and sets \a userData to what was
+     * saved with it, if given. The size function is not asked for any item: blocks are positioned
+     * again from the sizes in the snapshot on the next layout().
+     *
+     * Returns false, changing nothing, if \a snapshot was not saved with \a fingerprint by this
+     * version, or is corrupt.
+     *
+     * Complexity: O(n) where n is the number of rows in \a snapshot.
+     */
+    bool restoreSnapshot(const QByteArray &snapshot, quint64 fingerprint, QByteArray *userData = nullptr);
+
+private:
+    // a row of items of an evicted block
+    struct RowSummary {
+        int y;
+        int height;
+    };
+
+    struct Block {
+        int category = -1;
+        int firstRow = 0;
+        int rowCount = 0;
+        // the size of all items, when they are not stored
+        QSize itemSize;
+        // one per laid out row, unless itemSize is valid or the block is evicted
+        QList<KCategorizedLayout::Item> items;
+        // the rows of the items, in order, while evicted
+        QList<RowSummary> rows;
+        // one bit per row while some rows are hidden, empty otherwise
+        std::vector<bool> hidden;
+        int hiddenCount = 0;
+        bool evicted = false;
+        // items from this one on have to be positioned again. Items without a valid size have to
+        // be asked for it first.
+        int layoutFrom = 0;
+        // height of the items, -1 if unknown
+        int height = -1;
+        int headerHeight = 0;
+        // top left of the items, below the header
+        QPoint position;
+        bool collapsed = false;
+        // ignores the row limit
+        bool unlimited = false;
+    };
+
+    void insertBlock(int index, const Block &block);
+    void removeBlock(int index);
+    void markDirty(int block);
+    // the number of rows of block that are laid out, the first ones
+    int laidOutRowCount(const Block &block) const;
+    // lays block index out again after the number of its rows that are laid out changed from
+    // previousCount
+    void laidOutRowCountChanged(int index, int previousCount);
+    // gives back the items of an evicted block, to be asked for their size and laid out again
+    void restore(Block &block);
+    // gives back the items of an evicted block, asks for their size and lays them out, returning
+    // the height of the block
+    int restoreAndLayout(Block &block);
+    // lays out an evicted block again right away, because it is looked at
+    void reload(int index);
+    // replaces the items of a laid out block by the summary of its rows
+    void evict(Block &block);
+    void evictFarBlocks();
+    // lays out the items of block from the item from on, leaving its hidden items out, and returns
+    // its height
+    static int layoutItems(const KCategorizedLayout::Params &params, KCategorizedLayout::Kernel kernel, Block &block, int from);
+    // the row of the item closest to x among the ones whose top is top in block index, top being
+    // relative to the block
+    int closestInLine(int index, int top, int x);
+    // the rect of item of block, bounded to the grid and centered in its cell
+    QRect blockItemRect(const Block &block, const KCategorizedLayout::Item &item) const;
+    static qsizetype blockBytes(const Block &block);
+
+    SizeHintFunction m_sizeHint;
+    HeaderHeightFunction m_headerHeight;
+    BlockItemSizeFunction m_blockItemSize;
+    KCategorizedLayout::Params m_params;
+
+    QList<Block> m_blocks;
+    // index of the block of every category
+    QHash<int, int> m_categoryBlocks;
+    int m_rowCount = 0;
+    // blocks from this one on have to be laid out or positioned again
+    int m_firstDirtyBlock = 0;
+    // the size of all items when the params ask for uniform item sizes, once asked for
+    QSize m_uniformSize;
+    int m_rowLimit = 0;
+
+    qsizetype m_memoryBudget = 0;
+    // blocks overlapping it are kept
+    QRect m_visibleRect;
+    quint64 m_evictions = 0;
+    quint64 m_reloads = 0;
+};
+
+#endif // KCATEGORIZEDLAYOUTENGINE_P_H
@@ -11,6 +11,92 @@
 
 #include <QCollator>
 
+// BEGIN: category sort keys
+KCategorizedSortFilterProxyModelPrivate::CategoryKey KCategorizedSortFilterProxyModelPrivate::makeCategoryKey(const QModelIndex &index) const
+{
+    const QVariant data = index.model() ? index.model()->data(index, KCategorizedSortFilterProxyModel::CategorySortRole) : QVariant();
+    Q_ASSERT(data.isValid());
+
+    CategoryKey key;
+    if (data.userType() == QMetaType::QString) {
+        key.isString = true;
+        if (sortCategoriesByNaturalComparison) {
+            key.collatorKey = m_collator.sortKey(data.toString());
+        } else {
+            key.string = data.toString();
+        }
+    } else {
+        key.number = data.toLongLong();
+    }
+    return key;
+}
+
+int KCategorizedSortFilterProxyModelPrivate::compareCategoryKeys(const CategoryKey &left, const CategoryKey &right) const
+{
+    Q_ASSERT(left.isString == right.isString);
+
+    if (left.isString) {
+        if (left.collatorKey && right.collatorKey) {
+            return left.collatorKey->compare(*right.collatorKey);
+        }
+        return QString::compare(left.string, right.string);
+    }
+
+    if (left.number < right.number) {
+        return -1;
+    }
+
+    if (left.number > right.number) {
+        return 1;
+    }
+
+    return 0;
+}
+
+bool KCategorizedSortFilterProxyModelPrivate::cachesCategoryKeys(const QModelIndex &left, const QModelIndex &right)
+{
+    if (!categoryKeysModel || left.model() != categoryKeysModel || right.model() != categoryKeysModel || left.column() != right.column()) {
+        return false;
+    }
+
+    const QModelIndex parent = left.parent();
+    if (right.parent() != parent) {
+        return false;
+    }
+
+    // the persistent index of a parent that was removed since is invalid, like the root index
+    if (parent != categoryKeysParent || categoryKeysParent.isValid() != categoryKeysParentValid || left.column() != categoryKeysColumn) {
+        clearCategoryKeys();
+        categoryKeysParent = parent;
+        categoryKeysParentValid = parent.isValid();
+        categoryKeysColumn = left.column();
+    }
+    if (categoryKeys.isEmpty()) {
+        categoryKeys.resize(categoryKeysModel->rowCount(parent));
+    }
+
+    return left.row() < categoryKeys.count() && right.row() < categoryKeys.count();
+}
+
+const KCategorizedSortFilterProxyModelPrivate::CategoryKey &KCategorizedSortFilterProxyModelPrivate::cachedCategoryKey(const QModelIndex &index)
+{
+    CategoryKey &key = categoryKeys[index.row()];
+    if (!key.cached) {
+        key = makeCategoryKey(index);
+        key.cached = true;
+    }
+    return key;
+}
+
+void KCategorizedSortFilterProxyModelPrivate::clearCategoryKeys()
+{
+    categoryKeys = QList<CategoryKey>();
+    categoryKeysParent = QPersistentModelIndex();
+    categoryKeysParentValid = false;
+    categoryKeysColumn = -1;
+}
+// END: category sort keys
+
 KCategorizedSortFilterProxyModel::KCategorizedSortFilterProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
     , d(new KCategorizedSortFilterProxyModelPrivate())
@@ -24,10 +110,90 @@ void KCategorizedSortFilterProxyModel::sort(int column, Qt::SortOrder order)
 {
     d->sortColumn = column;
     d->sortOrder = order;
+    d->clearCategoryKeys();
 
     QSortFilterProxyModel::sort(column, order);
 }
 
+void KCategorizedSortFilterProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    for (const QMetaObject::Connection &connection : std::as_const(d->sourceConnections)) {
+        disconnect(connection);
+    }
+    d->sourceConnections.clear();
+    d->clearCategoryKeys();
+    d->categoryKeysModel = sourceModel;
+
+    // connected before QSortFilterProxyModel connects its own, so that the cached keys match the
+    // rows again by the time it sorts the changed rows
+    if (sourceModel) {
+        d->sourceConnections = {
+            connect(sourceModel,
+                    &QAbstractItemModel::dataChanged,
+                    this,
+                    [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                        // models often derive CategorySortRole from the text without saying so, and
+                        // QSortFilterProxyModel sorts the rows again for sortRole(), so the keys of
+                        // both are made again
+                        const bool categoryChanged = roles.isEmpty() || roles.contains(CategorySortRole);
+                        if (!categoryChanged && !roles.contains(sortRole())) {
+                            return;
+                        }
+                        if (!d->categoryKeys.isEmpty() && topLeft.parent() == d->categoryKeysParent && d->categoryKeysColumn >= topLeft.column()
+                            && d->categoryKeysColumn <= bottomRight.column()) {
+                            const int last = qMin(bottomRight.row(), int(d->categoryKeys.count()) - 1);
+                            for (int row = topLeft.row(); row <= last; ++row) {
+                                d->categoryKeys[row] = KCategorizedSortFilterProxyModelPrivate::CategoryKey();
+                            }
+                        }
+                        // QSortFilterProxyModel only sorts the changed rows again when the roles
+                        // include sortRole(), so the categories would stay where they were
+                        if (categoryChanged && d->categorizedModel && dynamicSortFilter() && !roles.isEmpty() && !roles.contains(sortRole())) {
+                            invalidate();
+                        }
+                    }),
+            connect(sourceModel,
+                    &QAbstractItemModel::rowsInserted,
+                    this,
+                    [this](const QModelIndex &parent, int first, int last) {
+                        if (d->categoryKeys.isEmpty() || parent != d->categoryKeysParent) {
+                            return;
+                        }
+                        if (first <= d->categoryKeys.count()) {
+                            d->categoryKeys.insert(first, last - first + 1, KCategorizedSortFilterProxyModelPrivate::CategoryKey());
+                        } else {
+                            d->clearCategoryKeys();
+                        }
+                    }),
+            connect(sourceModel,
+                    &QAbstractItemModel::rowsRemoved,
+                    this,
+                    [this](const QModelIndex &parent, int first, int last) {
+                        if (d->categoryKeys.isEmpty() || parent != d->categoryKeysParent) {
+                            return;
+                        }
+                        if (last < d->categoryKeys.count()) {
+                            d->categoryKeys.remove(first, last - first + 1);
+                        } else {
+                            d->clearCategoryKeys();
+                        }
+                    }),
+        };
+        // rows that move, or columns that change, are not worth following
+        const auto clear = [this]() {
+            d->clearCategoryKeys();
+        };
+        d->sourceConnections.append(connect(sourceModel, &QAbstractItemModel::rowsMoved, this, clear));
+        d->sourceConnections.append(connect(sourceModel, &QAbstractItemModel::columnsInserted, this, clear));
+        d->sourceConnections.append(connect(sourceModel, &QAbstractItemModel::columnsRemoved, this, clear));
+        d->sourceConnections.append(connect(sourceModel, &QAbstractItemModel::columnsMoved, this, clear));
+        d->sourceConnections.append(connect(sourceModel, &QAbstractItemModel::layoutChanged, this, clear));
+        d->sourceConnections.append(connect(sourceModel, &QAbstractItemModel::modelReset, this, clear));
+    }
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
 bool KCategorizedSortFilterProxyModel::isCategorizedModel() const
 {
     return d->categorizedModel;
@@ -40,6 +206,7 @@ void KCategorizedSortFilterProxyModel::setCategorizedModel(bool categorizedModel
     }
 
     d->categorizedModel = categorizedModel;
+    d->clearCategoryKeys();
 
     invalidate();
 }
@@ -61,6 +228,7 @@ void KCategorizedSortFilterProxyModel::setSortCategoriesByNaturalComparison(bool
     }
 
     d->sortCategoriesByNaturalComparison = sortCategoriesByNaturalComparison;
+    d->clearCategoryKeys();
 
     invalidate();
 }
@@ -92,44 +260,11 @@ bool KCategorizedSortFilterProxyModel::subSortLessThan(const QModelIndex &left,
 
 int KCategorizedSortFilterProxyModel::compareCategories(const QModelIndex &left, const QModelIndex &right) const
 {
-    QVariant l = (left.model() ? left.model()->data(left, CategorySortRole) : QVariant());
-    QVariant r = (right.model() ? right.model()->data(right, CategorySortRole) : QVariant());
-
-    Q_ASSERT(l.isValid());
-    Q_ASSERT(r.isValid());
-    Q_ASSERT(l.userType() == r.userType());
-
-    if (l.userType() == QMetaType::QString) {
-        QString lstr = l.toString();
-        QString rstr = r.toString();
-
-        if (d->sortCategoriesByNaturalComparison) {
-            return d->m_collator.compare(lstr, rstr);
-        } else {
-            if (lstr < rstr) {
-                return -1;
-            }
-
-            if (lstr > rstr) {
-                return 1;
-            }
-
-            return 0;
-        }
-    }
-
-    qlonglong lint = l.toLongLong();
-    qlonglong rint = r.toLongLong();
-
-    if (lint < rint) {
-        return -1;
+    if (d->cachesCategoryKeys(left, right)) {
+        return d->compareCategoryKeys(d->cachedCategoryKey(left), d->cachedCategoryKey(right));
     }
 
-    if (lint > rint) {
-        return 1;
-    }
-
-    return 0;
+    return d->compareCategoryKeys(d->makeCategoryKey(left), d->makeCategoryKey(right));
 }
 
 #include "moc_kcategorizedsortfilterproxymodel.cpp"
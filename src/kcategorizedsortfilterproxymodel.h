@@ -40,12 +40,16 @@ public:
      * \value CategorySortRole This role is used for sorting categories. You can return a string or a long long value. Strings will be sorted alphabetically
      * while long long will be sorted by their value. Please note that this value won't be shown on the view, is only for sorting purposes. What will be shown
      * as "Category" on the view will be asked with the role CategoryDisplayRole.
+     * \value [since 6.28] CategoryItemSizeRole This role is used for asking whether all items of the category of a given index have the same size. Return
+     * that size as a QSize, or nothing if item sizes differ. It is only asked for the first index of each category, in the sorting column. KCategorizedView
+     * then lays out the items of the category without asking their size hint, and without storing their position.
      */
     enum AdditionalRoles {
         // Note: use printf "0x%08X\n" $(($RANDOM*$RANDOM))
         // to define additional roles.
         CategoryDisplayRole = 0x17CE990A,
         CategorySortRole = 0x27857E60,
+        CategoryItemSizeRole = 0x2F268550,
     };
 
     /*!
@@ -60,6 +64,14 @@ public:
      */
     void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
+    /*!
+     * Overridden from QSortFilterProxyModel. Sets the model to categorize and sort to
+     * \a sourceModel.
+     *
+     * \since 6.28
+     */
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
     /*!
      * Returns whether the model is categorized or not. Disabled by default.
      */
@@ -130,6 +142,12 @@ protected:
      * a QString object. QString objects will be sorted with QString::localeAwareCompare if
      * sortCategoriesByNaturalComparison() is true.
      *
+     * The CategorySortRole data of each row of the source model is asked for once, and turned
+     * into a key that is cheap to compare, a QCollatorSortKey for strings sorted naturally. Keys
+     * are computed again for the rows whose CategorySortRole or sortRole() data changed, as told
+     * by QAbstractItemModel::dataChanged(), and for all rows when sort() is called. The model is
+     * sorted again when that data changes, even if CategorySortRole is not sortRole().
+     *
      * \note Please have present that:
      *       QString(QChar(QChar::ObjectReplacementCharacter)) >
      *       QString(QChar(QChar::ReplacementCharacter)) >
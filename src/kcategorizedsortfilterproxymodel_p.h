@@ -10,9 +10,13 @@
 #define KCATEGORIZEDSORTFILTERPROXYMODEL_P_H
 
 #include <QCollator>
+#include <QPersistentModelIndex>
+#include <QPointer>
 
 #include "kcategorizedsortfilterproxymodel.h"
 
+#include <optional>
+
 class KCategorizedSortFilterProxyModelPrivate
 {
 public:
@@ -30,11 +34,45 @@ public:
     {
     }
 
+    /*
+     * The CategorySortRole data of a row, in a form that is cheap to compare. Strings compared
+     * naturally get a collator sort key, so that they are collated once instead of once per
+     * comparison.
+     */
+    struct CategoryKey {
+        bool cached = false;
+        bool isString = false;
+        qlonglong number = 0;
+        QString string;
+        std::optional<QCollatorSortKey> collatorKey;
+    };
+
+    CategoryKey makeCategoryKey(const QModelIndex &index) const;
+    int compareCategoryKeys(const CategoryKey &left, const CategoryKey &right) const;
+
+    // returns whether the keys of left and right are cached, which is the case for rows of the
+    // source model under the same parent and in the same column. The cache holds the rows of one
+    // parent and column at a time.
+    bool cachesCategoryKeys(const QModelIndex &left, const QModelIndex &right);
+    // returns the key of index, computed the first time it is asked for. index has to be cached.
+    const CategoryKey &cachedCategoryKey(const QModelIndex &index);
+    void clearCategoryKeys();
+
     int sortColumn;
     Qt::SortOrder sortOrder;
     bool categorizedModel;
     bool sortCategoriesByNaturalComparison;
     QCollator m_collator;
+
+    // the keys of the rows under categoryKeysParent, in categoryKeysColumn, of the source model.
+    // Empty until a comparison needs them, and kept up to date with the changes of the source
+    // model afterwards. Guarded, since the source model may be destroyed before being unset.
+    QPointer<const QAbstractItemModel> categoryKeysModel;
+    QPersistentModelIndex categoryKeysParent;
+    bool categoryKeysParentValid = false;
+    int categoryKeysColumn = -1;
+    QList<CategoryKey> categoryKeys;
+    QList<QMetaObject::Connection> sourceConnections;
 };
 
 #endif
@@ -8,696 +8,1986 @@
 /*
  * IMPLEMENTATION NOTES:
  *
- * QListView::setRowHidden() and QListView::isRowHidden() are not taken into
- * account. This methods should actually not exist. This effect should be handled
- * by an hypothetical QSortFilterProxyModel which filters out the desired rows.
+ * Hidden rows are only taken into account when hidden through
+ * KCategorizedView::setRowHidden(), since QListView::setRowHidden() is not
+ * virtual. The layout engine keeps a bit per row for the blocks that have hidden
+ * rows, and lays out their other items as if the hidden ones were not there.
  *
- * In case this needs to be implemented, contact me, but I consider this a faulty
- * design.
+ * Rows capped by KCategorizedView::categoryRowLimit() are the last ones of their
+ * block, the layout engine does not even keep an item for them.
  */
 
 #include "kcategorizedview.h"
 #include "kcategorizedview_p.h"
 
+#include <QAccessible>
+#include <QApplication>
+#include <QDataStream>
 #include <QPaintEvent>
 #include <QPainter>
+#include <QScreen>
 #include <QScrollBar>
+#include <QStyleOptionSlider>
 
 #include <kitemviews_debug.h>
 
+#include "kasyncdecorationprovider.h"
+#include "kcachingitemdelegate.h"
 #include "kcategorizedsortfilterproxymodel.h"
 #include "kcategorydrawer.h"
+#include "kitemdatachange_p.h"
 
 // BEGIN: Private part
 
-struct KCategorizedViewPrivate::Item {
-    Item()
-        : topLeft(QPoint())
-        , size(QSize())
-    {
+// Moves the row intervals in \a intervals the way the model moves its rows when \a delta rows get
+// inserted (positive) or removed (negative) at \a start. Removed rows are dropped from the intervals.
+static void moveRowIntervals(QList<std::pair<int, int>> &intervals, int start, int delta)
+{
+    auto it = intervals.begin();
+    while (it != intervals.end()) {
+        if (delta > 0) {
+            if (it->first >= start) {
+                it->first += delta;
+            }
+            if (it->second >= start) {
+                it->second += delta;
+            }
+        } else {
+            const int end = start - delta - 1;
+            it->first = it->first > end ? it->first + delta : qMin(it->first, start);
+            it->second = it->second > end ? it->second + delta : (it->second >= start ? start - 1 : it->second);
+            if (it->first > it->second) {
+                it = intervals.erase(it);
+                continue;
+            }
+        }
+        ++it;
     }
+}
 
-    QPoint topLeft;
-    QSize size;
-};
+// 64 bit FNV-1a over integers in little endian and strings in UTF-8, whose result is part of the
+// layout snapshots, so unlike qHash() it must not depend on the Qt version nor the platform.
+namespace
+{
+class KCategorizedLayoutFingerprint
+{
+public:
+    void add(qint64 value)
+    {
+        for (int i = 0; i < 8; ++i) {
+            addByte(quint8(quint64(value) >> (8 * i)));
+        }
+    }
 
-struct KCategorizedViewPrivate::Block {
-    Block()
-        : topLeft(QPoint())
-        , firstIndex(QModelIndex())
-        , quarantineStart(QModelIndex())
-        , items(QList<Item>())
+    void add(const QString &string)
     {
+        const QByteArray utf8 = string.toUtf8();
+        add(utf8.size());
+        for (const char c : utf8) {
+            addByte(quint8(c));
+        }
     }
 
-    bool operator!=(const Block &rhs) const
+    quint64 value() const
     {
-        return firstIndex != rhs.firstIndex;
+        return m_hash;
     }
 
-    static bool lessThan(const Block &left, const Block &right)
+private:
+    void addByte(quint8 byte)
     {
-        Q_ASSERT(left.firstIndex.isValid());
-        Q_ASSERT(right.firstIndex.isValid());
-        return left.firstIndex.row() < right.firstIndex.row();
-    }
-
-    QPoint topLeft;
-    int height = -1;
-    QPersistentModelIndex firstIndex;
-    // if we have n elements on this block, and we inserted an element at position i. The quarantine
-    // will start at index (i, column, parent). This means that for all elements j where i <= j <= n, the
-    // visual rect position of item j will have to be recomputed (cannot use the cached point). The quarantine
-    // will only affect the current block, since the rest of blocks can be affected only in the way
-    // that the whole block will have different offset, but items will keep the same relative position
-    // in terms of their parent blocks.
-    QPersistentModelIndex quarantineStart;
-    QList<Item> items;
-
-    // this affects the whole block, not items separately. items contain the topLeft point relative
-    // to the block. Because of insertions or removals a whole block can be moved, so the whole block
-    // will enter in quarantine, what is faster than moving all items in absolute terms.
-    bool outOfQuarantine = false;
-
-    // should we alternate its color ? is just a hint, could not be used
-    bool alternate = false;
-    bool collapsed = false;
+        m_hash ^= byte;
+        m_hash *= Q_UINT64_C(0x100000001b3);
+    }
+
+    quint64 m_hash = Q_UINT64_C(0xcbf29ce484222325);
 };
+}
 
 KCategorizedViewPrivate::KCategorizedViewPrivate(KCategorizedView *qq)
     : q(qq)
-    , hoveredBlock(new Block())
     , hoveredIndex(QModelIndex())
     , pressedPosition(QPoint())
     , rubberBandRect(QRect())
+    , layout(std::make_shared<KCategorizedSharedLayout>())
 {
+    dataChangedTimer.setSingleShot(true);
+    QObject::connect(&dataChangedTimer, &QTimer::timeout, q, [this]() {
+        flushDataChanges();
+    });
+    visibleRangeTimer.setSingleShot(true);
+    QObject::connect(&visibleRangeTimer, &QTimer::timeout, q, [this]() {
+        updateVisibleRange();
+    });
+    validationTimer.setSingleShot(true);
+    QObject::connect(&validationTimer, &QTimer::timeout, q, [this]() {
+        validateRestoredBlocks();
+    });
+    scrollSettleTimer.setSingleShot(true);
+    scrollSettleTimer.setInterval(100);
+    QObject::connect(&scrollSettleTimer, &QTimer::timeout, q, [this]() {
+        scrollSettled();
+    });
+
+    layout->views.append(this);
+    installLayoutFunctions();
 }
 
 KCategorizedViewPrivate::~KCategorizedViewPrivate()
 {
-    delete hoveredBlock;
+    delete scrollBarMarkers;
+    forgetFormerLayout();
+    setLayout(nullptr);
 }
 
-bool KCategorizedViewPrivate::isCategorized() const
+KCategorizedViewPrivate *KCategorizedViewPrivate::layoutLeader() const
 {
-    return proxyModel && categoryDrawer && proxyModel->isCategorizedModel();
+    return layout->views.constFirst();
 }
 
-QStyleOptionViewItem KCategorizedViewPrivate::viewOpts()
+bool KCategorizedViewPrivate::isLayoutLeader() const
 {
-    QStyleOptionViewItem option;
-    q->initViewItemOption(&option);
-    return option;
+    return layoutLeader() == this;
 }
 
-QStyleOptionViewItem KCategorizedViewPrivate::blockRect(const QModelIndex &representative)
+bool KCategorizedViewPrivate::isLayoutVisible() const
 {
-    QStyleOptionViewItem option = viewOpts();
-
-    const int height = categoryDrawer->categoryHeight(representative, option);
-    const QString categoryDisplay = representative.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
-    QPoint pos = blockPosition(categoryDisplay);
-    pos.ry() -= height;
-    option.rect.setTopLeft(pos);
-    option.rect.setWidth(viewportWidth() + categoryDrawer->leftMargin() + categoryDrawer->rightMargin());
-    option.rect.setHeight(height + blockHeight(categoryDisplay));
-    option.rect = mapToViewport(option.rect);
-
-    return option;
+    for (const KCategorizedViewPrivate *view : std::as_const(layout->views)) {
+        if (view->q->isVisible()) {
+            return true;
+        }
+    }
+    return false;
 }
 
-std::pair<QModelIndex, QModelIndex> KCategorizedViewPrivate::intersectingIndexesWithRect(const QRect &_rect) const
+bool KCategorizedViewPrivate::isLayoutCompatibleWith(const KCategorizedViewPrivate *other) const
 {
-    const int rowCount = proxyModel->rowCount();
+    if (!isCategorized() || !other->isCategorized()) {
+        return false;
+    }
 
-    const QRect rect = _rect.normalized();
+    // hidden rows are the view's own
+    if (!hiddenRows.isEmpty() || !other->hiddenRows.isEmpty()) {
+        return false;
+    }
 
-    // binary search to find out the top border
-    int bottom = 0;
-    int top = rowCount - 1;
-    while (bottom <= top) {
-        const int middle = (bottom + top) / 2;
-        const QModelIndex index = proxyModel->index(middle, q->modelColumn(), q->rootIndex());
-        const QRect itemRect = q->visualRect(index);
-        if (itemRect.bottomRight().y() <= rect.topLeft().y()) {
-            bottom = middle + 1;
-        } else {
-            top = middle - 1;
-        }
+    // both views have to lay out the same rows of each category
+    if (categoryRowLimit != other->categoryRowLimit) {
+        return false;
     }
 
-    const QModelIndex bottomIndex = proxyModel->index(bottom, q->modelColumn(), q->rootIndex());
+    // the delegates and category drawers measure items and headers
+    return model == other->model && q->rootIndex() == other->q->rootIndex() && layoutFingerprint() == other->layoutFingerprint()
+        && layoutParams() == other->layoutParams() && q->itemDelegate()->metaObject() == other->q->itemDelegate()->metaObject()
+        && categoryDrawer->metaObject() == other->categoryDrawer->metaObject();
+}
 
-    // binary search to find out the bottom border
-    bottom = 0;
-    top = rowCount - 1;
-    while (bottom <= top) {
-        const int middle = (bottom + top) / 2;
-        const QModelIndex index = proxyModel->index(middle, q->modelColumn(), q->rootIndex());
-        const QRect itemRect = q->visualRect(index);
-        if (itemRect.topLeft().y() <= rect.bottomRight().y()) {
-            bottom = middle + 1;
-        } else {
-            top = middle - 1;
+void KCategorizedViewPrivate::installLayoutFunctions()
+{
+    layout->engine.setSizeHintFunction([this](int row) {
+        return itemSizeHint(model->index(row, q->modelColumn(), q->rootIndex()));
+    });
+    layout->engine.setHeaderHeightFunction([this](int firstRow) {
+        return categoryDrawer->categoryHeight(model->index(firstRow, q->modelColumn(), q->rootIndex()), viewOpts());
+    });
+    layout->engine.setBlockItemSizeFunction([this](int firstRow) {
+        return model->index(firstRow, categoryColumn(), q->rootIndex()).data(KCategorizedSortFilterProxyModel::CategoryItemSizeRole).toSize();
+    });
+}
+
+void KCategorizedViewPrivate::setLayout(const std::shared_ptr<KCategorizedSharedLayout> &newLayout)
+{
+    if (layout == newLayout) {
+        return;
+    }
+
+    // BEGIN: leave the current layout
+    // the next view takes over the model changes we had not applied yet, if any
+    const bool wasLeader = isLayoutLeader();
+    const bool hadPendingChanges = wasLeader && hasPendingChanges();
+    layout->views.removeOne(this);
+    if (wasLeader && !layout->views.isEmpty()) {
+        KCategorizedViewPrivate *const leader = layoutLeader();
+        leader->installLayoutFunctions();
+        if (hadPendingChanges) {
+            leader->markRelayoutPending();
+            leader->scheduleApplyPendingChanges();
         }
     }
+    // END: leave the current layout
 
-    const QModelIndex topIndex = proxyModel->index(top, q->modelColumn(), q->rootIndex());
+    layout = newLayout;
+    if (!layout) {
+        return;
+    }
 
-    return {bottomIndex, topIndex};
+    layout->views.append(this);
+    if (isLayoutLeader()) {
+        installLayoutFunctions();
+    }
+    resetPendingChanges();
+    hoveredBlock = -1;
+    visibleFirstRow = -1;
+    visibleLastRow = -1;
 }
 
-QPoint KCategorizedViewPrivate::blockPosition(const QString &category)
+void KCategorizedViewPrivate::leaveLayout()
 {
-    Block &block = blocks[category];
-
-    if (block.outOfQuarantine && !block.topLeft.isNull()) {
-        return block.topLeft;
+    if (layout->views.count() == 1) {
+        return;
     }
 
-    QPoint res(categorySpacing, 0);
+    forgetFormerLayout();
+    formerLayout = layout;
+    layout->formerViews.append(this);
 
-    const QModelIndex index = block.firstIndex;
+    // a snapshot is the cheapest copy of the sizes of the items, unless they are about to be
+    // measured again anyway
+    const bool upToDate = !layoutLeader()->hasPendingChanges();
+    const QByteArray snapshot = upToDate ? layout->engine.saveSnapshot(0) : QByteArray();
+    const auto copy = std::make_shared<KCategorizedSharedLayout>();
+    copy->engine.setMemoryBudget(layout->engine.memoryBudget());
+    copy->categoryIds = layout->categoryIds;
+    copy->nextCategoryId = layout->nextCategoryId;
+    copy->showAllCategories = layout->showAllCategories;
 
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        Block &block = *it;
-        const QModelIndex categoryIndex = block.firstIndex;
-        if (index.row() < categoryIndex.row()) {
-            continue;
-        }
+    setLayout(copy);
 
-        res.ry() += categoryDrawer->categoryHeight(categoryIndex, viewOpts()) + categorySpacing;
-        if (index.row() == categoryIndex.row()) {
-            continue;
-        }
-        res.ry() += blockHeight(it.key());
+    if (!layout->engine.restoreSnapshot(snapshot, 0)) {
+        markRelayoutPending();
+        scheduleApplyPendingChanges();
+        return;
     }
 
-    block.outOfQuarantine = true;
-    block.topLeft = res;
-
-    return res;
+    layout->engine.setParams(layoutParams());
+    q->viewport()->update();
+    q->updateGeometries();
+    scheduleVisibleRangeUpdate();
 }
 
-int KCategorizedViewPrivate::blockHeight(const QString &category)
+void KCategorizedViewPrivate::checkLayoutSharing()
 {
-    Block &block = blocks[category];
+    if (layout->views.count() > 1) {
+        const KCategorizedViewPrivate *const other = layout->views[isLayoutLeader() ? 1 : 0];
+        if (!isLayoutCompatibleWith(other)) {
+            leaveLayout();
+        }
+    }
 
-    if (block.collapsed) {
-        return 0;
+    // whichever side changed last, views that left a layout share it again once they match
+    if (!rejoinFormerLayout()) {
+        const QList<KCategorizedViewPrivate *> formerViews = layout->formerViews;
+        for (KCategorizedViewPrivate *const view : formerViews) {
+            view->rejoinFormerLayout();
+        }
+    }
+}
+
+bool KCategorizedViewPrivate::rejoinFormerLayout()
+{
+    const std::shared_ptr<KCategorizedSharedLayout> former = formerLayout.lock();
+    if (!former || former == layout || former->views.isEmpty() || !isLayoutCompatibleWith(former->views.constFirst())) {
+        return false;
     }
 
-    if (block.height > -1) {
-        return block.height;
+    forgetFormerLayout();
+    setLayout(former);
+    q->viewport()->update();
+    q->updateGeometries();
+    scheduleVisibleRangeUpdate();
+    return true;
+}
+
+void KCategorizedViewPrivate::forgetFormerLayout()
+{
+    if (const std::shared_ptr<KCategorizedSharedLayout> former = formerLayout.lock()) {
+        former->formerViews.removeOne(this);
     }
+    formerLayout.reset();
+}
 
-    const QModelIndex firstIndex = block.firstIndex;
-    const QModelIndex lastIndex = proxyModel->index(firstIndex.row() + block.items.count() - 1, q->modelColumn(), q->rootIndex());
-    const QRect topLeft = q->visualRect(firstIndex);
-    QRect bottomRight = q->visualRect(lastIndex);
+void KCategorizedViewPrivate::notifyLayoutFollowers(int firstRow)
+{
+    for (KCategorizedViewPrivate *const view : std::as_const(layout->views)) {
+        if (view == this) {
+            continue;
+        }
 
-    if (hasGrid()) {
-        bottomRight.setHeight(qMax(bottomRight.height(), q->gridSize().height()));
-    } else {
-        if (!q->uniformItemSizes()) {
-            bottomRight.setHeight(highestElementInLastRow(block) + q->spacing() * 2);
+        view->hoveredBlock = -1;
+        view->elidedTextCache.clear();
+        if (firstRow == -1) {
+            view->q->viewport()->update();
+            view->q->updateGeometries();
+        } else {
+            view->updateFromRow(firstRow);
         }
+        view->visibleFirstRow = -1;
+        view->visibleLastRow = -1;
+        view->scheduleVisibleRangeUpdate();
     }
+}
 
-    const int height = bottomRight.bottomRight().y() - topLeft.topLeft().y() + 1;
-    block.height = height;
-
-    return height;
+bool KCategorizedViewPrivate::isCategorized() const
+{
+    if (!model || !categoryDrawer) {
+        return false;
+    }
+    return proxyModel ? proxyModel->isCategorizedModel() : groupedModel;
 }
 
-int KCategorizedViewPrivate::viewportWidth() const
+int KCategorizedViewPrivate::categoryColumn() const
 {
-    return q->viewport()->width() - categorySpacing * 2 - categoryDrawer->leftMargin() - categoryDrawer->rightMargin();
+    return proxyModel ? proxyModel->sortColumn() : q->modelColumn();
 }
 
-void KCategorizedViewPrivate::regenerateAllElements()
+QStyleOptionViewItem KCategorizedViewPrivate::viewOpts()
 {
-    for (QHash<QString, Block>::Iterator it = blocks.begin(); it != blocks.end(); ++it) {
-        Block &block = *it;
-        block.outOfQuarantine = false;
-        block.quarantineStart = block.firstIndex;
-        block.height = -1;
-    }
+    QStyleOptionViewItem option;
+    q->initViewItemOption(&option);
+    return option;
 }
 
-void KCategorizedViewPrivate::rowsInserted(const QModelIndex &parent, int start, int end)
+QSize KCategorizedViewPrivate::itemSizeHint(const QModelIndex &index) const
 {
-    if (!isCategorized()) {
-        return;
+    if (!decorationProvider) {
+        return q->sizeHintForIndex(index);
+    }
+
+    QAbstractItemDelegate *const delegate = q->itemDelegateForIndex(index);
+    if (!index.isValid() || !delegate) {
+        return QSize();
     }
 
-    for (int i = start; i <= end; ++i) {
-        const QModelIndex index = proxyModel->index(i, q->modelColumn(), parent);
+    QStyleOptionViewItem option;
+    q->initViewItemOption(&option);
+    option.features |= QStyleOptionViewItem::HasDecoration;
+    return delegate->sizeHint(option, index);
+}
 
-        Q_ASSERT(index.isValid());
+void KCategorizedViewPrivate::initDecorationOption(QStyleOptionViewItem *option, const QModelIndex &index) const
+{
+    option->features |= QStyleOptionViewItem::HasDecoration;
 
-        const QString category = categoryForIndex(index);
+    // the ratio of the screen the view is on, which is not the one of the application with
+    // screens of different ratios
+    QPixmap decoration = decorationProvider->decoration(index, option->decorationSize, q->devicePixelRatioF());
+    if (decoration.isNull()) {
+        decoration = decorationProvider->placeholder();
+    }
+    if (!decoration.isNull()) {
+        option->icon = QIcon(decoration);
+    }
+}
 
-        Block &block = blocks[category];
+QStyleOptionViewItem KCategorizedViewPrivate::blockRect(int block)
+{
+    QStyleOptionViewItem option = viewOpts();
 
-        // BEGIN: update firstIndex
-        // save as firstIndex in block if
-        //     - it forced the category creation (first element on this category)
-        //     - it is before the first row on that category
-        const QModelIndex firstIndex = block.firstIndex;
-        if (!firstIndex.isValid() || index.row() < firstIndex.row()) {
-            block.firstIndex = index;
-        }
-        // END: update firstIndex
+    const int height = layout->engine.blockHeaderHeight(block);
+    QPoint pos = layout->engine.blockPosition(block);
+    pos.ry() -= height;
+    option.rect.setTopLeft(pos);
+    option.rect.setWidth(viewportWidth() + categoryDrawer->leftMargin() + categoryDrawer->rightMargin());
+    option.rect.setHeight(height + layout->engine.blockHeight(block));
+    option.rect = mapToViewport(option.rect);
 
-        Q_ASSERT(block.firstIndex.isValid());
+    return option;
+}
 
-        const int firstIndexRow = block.firstIndex.row();
+KCategorizedView::BlockRange KCategorizedViewPrivate::blockRange(int block)
+{
+    if (block == -1) {
+        return KCategorizedView::BlockRange();
+    }
 
-        block.items.insert(index.row() - firstIndexRow, KCategorizedViewPrivate::Item());
-        block.height = -1;
+    // the same rect categoryHeaderRect() gives, without the style options
+    const int headerHeight = layout->engine.blockHeaderHeight(block);
+    const QPoint position = layout->engine.blockPosition(block);
+    const int width = viewportWidth() + categoryDrawer->leftMargin() + categoryDrawer->rightMargin();
+    const QRect headerRect = mapToViewport(QRect(position.x(), position.y() - headerHeight, width, headerHeight));
+    return {layout->engine.blockFirstRow(block), layout->engine.blockRowCount(block), headerRect};
+}
 
-        q->visualRect(index);
-        q->viewport()->update();
+void KCategorizedViewPrivate::selectBlock(const KCategorizedView::BlockRange &range, QItemSelectionModel::SelectionFlags command)
+{
+    QItemSelectionModel *const selectionModel = q->selectionModel();
+    if (!range.rowCount || !selectionModel) {
+        return;
     }
 
-    // BEGIN: update the items that are in quarantine in affected categories
-    {
-        const QModelIndex lastIndex = proxyModel->index(end, q->modelColumn(), parent);
-        const QString category = categoryForIndex(lastIndex);
-        KCategorizedViewPrivate::Block &block = blocks[category];
-        block.quarantineStart = block.firstIndex;
+    const auto indexForRow = [this](int row) {
+        return model->index(row, q->modelColumn(), q->rootIndex());
+    };
+    // capped rows are the last ones of the block
+    const int block = layout->engine.blockForRow(range.firstRow);
+    const int end = range.firstRow + range.rowCount - (block == -1 ? 0 : layout->engine.blockCappedRowCount(block));
+    if (block == -1 || !layout->engine.blockHiddenRowCount(block)) {
+        selectionModel->select(QItemSelection(indexForRow(range.firstRow), indexForRow(end - 1)), command);
+        return;
     }
-    // END: update the items that are in quarantine in affected categories
 
-    // BEGIN: mark as in quarantine those categories that are under the affected ones
-    {
-        const QModelIndex firstIndex = proxyModel->index(start, q->modelColumn(), parent);
-        const QString category = categoryForIndex(firstIndex);
-        const QModelIndex firstAffectedCategory = blocks[category].firstIndex;
-        // BEGIN: order for marking as alternate those blocks that are alternate
-        QList<Block> blockList = blocks.values();
-        std::sort(blockList.begin(), blockList.end(), Block::lessThan);
-        QList<int> firstIndexesRows;
-        for (const Block &block : std::as_const(blockList)) {
-            firstIndexesRows << block.firstIndex.row();
+    // hidden rows are left out, the shown rows between them make a range each
+    QItemSelection selection;
+    for (int row = range.firstRow; row < end; ++row) {
+        if (layout->engine.isRowHidden(row)) {
+            continue;
         }
-        // END: order for marking as alternate those blocks that are alternate
-        for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-            KCategorizedViewPrivate::Block &block = *it;
-            if (block.firstIndex.row() > firstAffectedCategory.row()) {
-                block.outOfQuarantine = false;
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            } else if (block.firstIndex.row() == firstAffectedCategory.row()) {
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            }
+        int last = row;
+        while (last + 1 < end && !layout->engine.isRowHidden(last + 1)) {
+            ++last;
         }
+        selection.append(QItemSelectionRange(indexForRow(row), indexForRow(last)));
+        row = last;
     }
-    // END: mark as in quarantine those categories that are under the affected ones
+    selectionModel->select(selection, command);
 }
 
-QRect KCategorizedViewPrivate::mapToViewport(const QRect &rect) const
+QRect KCategorizedViewPrivate::categoryHeaderRect(int block)
 {
-    const int dx = -q->horizontalOffset();
-    const int dy = -q->verticalOffset();
-    return rect.adjusted(dx, dy, dx, dy);
+    QRect rect = blockRect(block).rect;
+    rect.setHeight(layout->engine.blockHeaderHeight(block));
+    return rect;
 }
 
-QRect KCategorizedViewPrivate::mapFromViewport(const QRect &rect) const
+QModelIndex KCategorizedViewPrivate::categoryIndex(int block) const
 {
-    const int dx = q->horizontalOffset();
-    const int dy = q->verticalOffset();
-    return rect.adjusted(dx, dy, dx, dy);
+    return model->index(layout->engine.blockFirstRow(block), categoryColumn(), q->rootIndex());
 }
 
-int KCategorizedViewPrivate::highestElementInLastRow(const Block &block) const
+int KCategorizedViewPrivate::categoryId(const QString &category)
 {
-    // Find the highest element in the last row
-    const QModelIndex lastIndex = proxyModel->index(block.firstIndex.row() + block.items.count() - 1, q->modelColumn(), q->rootIndex());
-    const QRect prevRect = q->visualRect(lastIndex);
-    int res = prevRect.height();
-    QModelIndex prevIndex = proxyModel->index(lastIndex.row() - 1, q->modelColumn(), q->rootIndex());
-    if (!prevIndex.isValid()) {
-        return res;
-    }
-    Q_FOREVER {
-        const QRect tempRect = q->visualRect(prevIndex);
-        if (tempRect.topLeft().y() < prevRect.topLeft().y()) {
-            break;
-        }
-        res = qMax(res, tempRect.height());
-        if (prevIndex == block.firstIndex) {
-            break;
-        }
-        prevIndex = proxyModel->index(prevIndex.row() - 1, q->modelColumn(), q->rootIndex());
+    auto it = layout->categoryIds.find(category);
+    if (it == layout->categoryIds.end()) {
+        it = layout->categoryIds.insert(category, layout->nextCategoryId++);
     }
-
-    return res;
+    return *it;
 }
 
-bool KCategorizedViewPrivate::hasGrid() const
+int KCategorizedViewPrivate::blockForCategory(const QString &category) const
 {
-    const QSize gridSize = q->gridSize();
-    return gridSize.isValid() && !gridSize.isNull();
+    const auto it = layout->categoryIds.constFind(category);
+    return it == layout->categoryIds.constEnd() ? -1 : layout->engine.blockForCategory(*it);
 }
 
-QString KCategorizedViewPrivate::categoryForIndex(const QModelIndex &index) const
+void KCategorizedViewPrivate::updateFromRow(int row)
 {
-    const auto indexModel = index.model();
-    if (!indexModel || !proxyModel) {
-        qCWarning(KITEMVIEWS_LOG) << "Index or view doesn't contain model";
-        return QString();
+    const int rowCount = model->rowCount(q->rootIndex());
+    if (!rowCount) {
+        q->viewport()->update();
+        return;
     }
 
-    const QModelIndex categoryIndex = indexModel->index(index.row(), proxyModel->sortColumn(), index.parent());
-    return categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
-}
-
-void KCategorizedViewPrivate::leftToRightVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const
-{
-    const int firstIndexRow = block.firstIndex.row();
+    // if the rows at the end were removed, what changed starts where the last remaining item is
+    const QModelIndex index = model->index(qMin(row, rowCount - 1), q->modelColumn(), q->rootIndex());
+    int top = q->visualRect(index).top();
 
-    if (hasGrid()) {
-        const int relativeRow = index.row() - firstIndexRow;
-        const int maxItemsPerRow = qMax(viewportWidth() / q->gridSize().width(), 1);
-        if (q->layoutDirection() == Qt::LeftToRight) {
-            item.topLeft.rx() = (relativeRow % maxItemsPerRow) * q->gridSize().width() + blockPos.x() + categoryDrawer->leftMargin();
-        } else {
-            item.topLeft.rx() = viewportWidth() - ((relativeRow % maxItemsPerRow) + 1) * q->gridSize().width() + categoryDrawer->leftMargin() + categorySpacing;
-        }
-        item.topLeft.ry() = (relativeRow / maxItemsPerRow) * q->gridSize().height();
-    } else {
-        if (q->uniformItemSizes()) {
-            const int relativeRow = index.row() - firstIndexRow;
-            const QSize itemSize = q->sizeHintForIndex(index);
-            const int maxItemsPerRow = qMax((viewportWidth() - q->spacing()) / (itemSize.width() + q->spacing()), 1);
-            if (q->layoutDirection() == Qt::LeftToRight) {
-                item.topLeft.rx() = (relativeRow % maxItemsPerRow) * itemSize.width() + blockPos.x() + categoryDrawer->leftMargin();
-            } else {
-                item.topLeft.rx() = viewportWidth() - (relativeRow % maxItemsPerRow) * itemSize.width() + categoryDrawer->leftMargin() + categorySpacing;
-            }
-            item.topLeft.ry() = (relativeRow / maxItemsPerRow) * itemSize.height();
-        } else {
-            const QSize currSize = q->sizeHintForIndex(index);
-            if (index != block.firstIndex) {
-                const int viewportW = viewportWidth() - q->spacing();
-                QModelIndex prevIndex = proxyModel->index(index.row() - 1, q->modelColumn(), q->rootIndex());
-                QRect prevRect = q->visualRect(prevIndex);
-                prevRect = mapFromViewport(prevRect);
-                if ((prevRect.bottomRight().x() + 1) + currSize.width() - blockPos.x() + q->spacing() > viewportW) {
-                    // we have to check the whole previous row, and see which one was the
-                    // highest.
-                    Q_FOREVER {
-                        prevIndex = proxyModel->index(prevIndex.row() - 1, q->modelColumn(), q->rootIndex());
-                        const QRect tempRect = q->visualRect(prevIndex);
-                        if (tempRect.topLeft().y() < prevRect.topLeft().y()) {
-                            break;
-                        }
-                        if (tempRect.bottomRight().y() > prevRect.bottomRight().y()) {
-                            prevRect = tempRect;
-                        }
-                        if (prevIndex == block.firstIndex) {
-                            break;
-                        }
-                    }
-                    if (q->layoutDirection() == Qt::LeftToRight) {
-                        item.topLeft.rx() = categoryDrawer->leftMargin() + blockPos.x() + q->spacing();
-                    } else {
-                        item.topLeft.rx() = viewportWidth() - currSize.width() + categoryDrawer->leftMargin() + categorySpacing;
-                    }
-                    item.topLeft.ry() = (prevRect.bottomRight().y() + 1) + q->spacing() - blockPos.y();
-                } else {
-                    if (q->layoutDirection() == Qt::LeftToRight) {
-                        item.topLeft.rx() = (prevRect.bottomRight().x() + 1) + q->spacing();
-                    } else {
-                        item.topLeft.rx() = (prevRect.bottomLeft().x() - 1) - q->spacing() - item.size.width() + categoryDrawer->leftMargin() + categorySpacing;
-                    }
-                    item.topLeft.ry() = prevRect.topLeft().y() - blockPos.y();
-                }
-            } else {
-                if (q->layoutDirection() == Qt::LeftToRight) {
-                    item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin() + q->spacing();
-                } else {
-                    item.topLeft.rx() = viewportWidth() - currSize.width() + categoryDrawer->leftMargin() + categorySpacing;
-                }
-                item.topLeft.ry() = q->spacing();
-            }
-        }
+    const int block = layout->engine.blockForRow(index.row());
+    if (block != -1 && layout->engine.blockFirstRow(block) == index.row()) {
+        top = mapToViewport(QRect(layout->engine.blockPosition(block), QSize())).top() - layout->engine.blockHeaderHeight(block);
     }
-    item.size = q->sizeHintForIndex(index);
-}
-
-void KCategorizedViewPrivate::topToBottomVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const
-{
-    const int firstIndexRow = block.firstIndex.row();
 
-    if (hasGrid()) {
-        const int relativeRow = index.row() - firstIndexRow;
-        item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin();
-        item.topLeft.ry() = relativeRow * q->gridSize().height();
-    } else {
-        if (q->uniformItemSizes()) {
-            const int relativeRow = index.row() - firstIndexRow;
-            const QSize itemSize = q->sizeHintForIndex(index);
-            item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin();
-            item.topLeft.ry() = relativeRow * itemSize.height();
-        } else {
-            if (index != block.firstIndex) {
-                QModelIndex prevIndex = proxyModel->index(index.row() - 1, q->modelColumn(), q->rootIndex());
-                QRect prevRect = q->visualRect(prevIndex);
-                prevRect = mapFromViewport(prevRect);
-                item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin() + q->spacing();
-                item.topLeft.ry() = (prevRect.bottomRight().y() + 1) + q->spacing() - blockPos.y();
-            } else {
-                item.topLeft.rx() = blockPos.x() + categoryDrawer->leftMargin() + q->spacing();
-                item.topLeft.ry() = q->spacing();
-            }
-        }
+    const QRect viewportRect = q->viewport()->rect();
+    if (top > viewportRect.bottom()) {
+        return;
     }
-    item.size = q->sizeHintForIndex(index);
-    item.size.setWidth(viewportWidth());
+
+    q->viewport()->update(viewportRect.adjusted(0, qMax(top, 0), 0, 0));
 }
 
-void KCategorizedViewPrivate::_k_slotCollapseOrExpandClicked(QModelIndex)
+QList<KCategorizedLayoutEngine::RowSpan> KCategorizedViewPrivate::intersectingRows(const QRect &rect)
 {
+    return layout->engine.findRows(mapFromViewport(rect.normalized()));
 }
 
-// END: Private part
+std::pair<QModelIndex, QModelIndex> KCategorizedViewPrivate::intersectingIndexesWithRect(const QRect &rect)
+{
+    const QList<KCategorizedLayoutEngine::RowSpan> rows = intersectingRows(rect);
+    if (rows.isEmpty()) {
+        return {QModelIndex(), QModelIndex()};
+    }
 
-// BEGIN: Public part
+    return {model->index(rows.first().first, q->modelColumn(), q->rootIndex()),
+            model->index(rows.last().last, q->modelColumn(), q->rootIndex())};
+}
 
-KCategorizedView::KCategorizedView(QWidget *parent)
-    : QListView(parent)
-    , d(new KCategorizedViewPrivate(this))
+int KCategorizedViewPrivate::viewportWidth() const
 {
+    return q->viewport()->width() - categorySpacing * 2 - categoryDrawer->leftMargin() - categoryDrawer->rightMargin();
 }
 
-KCategorizedView::~KCategorizedView() = default;
-
-void KCategorizedView::setModel(QAbstractItemModel *model)
+void KCategorizedViewPrivate::regenerateAllElements()
 {
-    if (d->proxyModel == model) {
+    // views sharing the layout have the same settings, so only the leader has something to do
+    checkLayoutSharing();
+    if (!isLayoutLeader()) {
         return;
     }
 
-    d->blocks.clear();
+    layout->engine.invalidate();
 
-    if (d->proxyModel) {
-        disconnect(d->proxyModel, SIGNAL(layoutChanged()), this, SLOT(slotLayoutChanged()));
+    // lay out all blocks at once when the changes are applied, instead of one by one as they are
+    // asked for
+    if (layout->engine.blockCount()) {
+        firstPendingRow = 0;
+        scheduleApplyPendingChanges();
     }
+}
 
-    d->proxyModel = dynamic_cast<KCategorizedSortFilterProxyModel *>(model);
-
-    if (d->proxyModel) {
-        connect(d->proxyModel, SIGNAL(layoutChanged()), this, SLOT(slotLayoutChanged()));
+void KCategorizedViewPrivate::updateLayoutParams()
+{
+    checkLayoutSharing();
+    if (!isLayoutLeader()) {
+        return;
     }
 
-    QListView::setModel(model);
+    layout->engine.setParams(layoutParams());
 
-    // if the model already had information inserted, update our data structures to it
-    if (model && model->rowCount()) {
-        slotLayoutChanged();
+    if (layout->engine.blockCount()) {
+        firstPendingRow = 0;
+        scheduleApplyPendingChanges();
     }
 }
 
-void KCategorizedView::setGridSize(const QSize &size)
+void KCategorizedViewPrivate::rowsInserted(const QModelIndex &parent, int start, int end)
 {
-    setGridSizeOwn(size);
-}
+    if (!isCategorized()) {
+        return;
+    }
 
-void KCategorizedView::setGridSizeOwn(const QSize &size)
-{
-    d->regenerateAllElements();
-    QListView::setGridSize(size);
+    // inserted rows usually come in runs of the same category, which are inserted at once
+    int first = start;
+    while (first <= end) {
+        const QString category = categoryForIndex(model->index(first, q->modelColumn(), parent));
+        int last = first;
+        while (last < end && categoryForIndex(model->index(last + 1, q->modelColumn(), parent)) == category) {
+            ++last;
+        }
+
+        if (!layout->engine.insertRows(first, last - first + 1, categoryId(category))) {
+            // the rows of the category are not consecutive anymore. Only rebuilding tells the
+            // resulting blocks apart.
+            markRelayoutPending();
+            scheduleApplyPendingChanges();
+            return;
+        }
+        if (layout->showAllCategories.contains(category)) {
+            layout->engine.setBlockUnlimited(blockForCategory(category), true);
+        }
+
+        first = last + 1;
+    }
+
+    // the blocks under the affected ones and the alternate state of the blocks are updated in
+    // applyPendingChanges(), once for all changes that arrive on this event loop iteration
 }
 
-QRect KCategorizedView::visualRect(const QModelIndex &index) const
+void KCategorizedViewPrivate::rebuildBlocks()
 {
-    if (!d->isCategorized()) {
-        return QListView::visualRect(index);
+    if (!isLayoutLeader()) {
+        layoutLeader()->rebuildBlocks();
+        return;
     }
 
-    if (!index.isValid()) {
-        return QRect();
-    }
+    resetPendingChanges();
+    layout->engine.clear();
+    layout->categoryIds.clear();
+    layout->nextCategoryId = 0;
+    hoveredBlock = -1;
 
-    const QString category = d->categoryForIndex(index);
+    if (!isCategorized()) {
+        return;
+    }
 
-    if (!d->blocks.contains(category)) {
-        return QRect();
+    const int rowCount = model->rowCount(q->rootIndex());
+    if (!rowCount) {
+        return;
     }
 
-    KCategorizedViewPrivate::Block &block = d->blocks[category];
-    const int firstIndexRow = block.firstIndex.row();
+    layout->engine.setParams(layoutParams());
 
-    Q_ASSERT(block.firstIndex.isValid());
+    // BEGIN: create the blocks
+    // rows are sorted by category, so they come in runs that each make a whole block
+    int first = 0;
+    QString category = categoryForIndex(model->index(0, q->modelColumn(), q->rootIndex()));
+    for (int i = 1; i <= rowCount; ++i) {
+        QString next;
+        if (i < rowCount) {
+            next = categoryForIndex(model->index(i, q->modelColumn(), q->rootIndex()));
+            if (next == category) {
+                continue;
+            }
+        }
 
-    if (index.row() - firstIndexRow < 0 || index.row() - firstIndexRow >= block.items.count()) {
-        return QRect();
+        if (!layout->engine.insertRows(first, i - first, categoryId(category))) {
+            // the model is not sorted by category, the run gets a block of its own
+            layout->engine.insertRows(first, i - first, layout->nextCategoryId++);
+        }
+        first = i;
+        category = next;
     }
+    // END: create the blocks
 
-    const QPoint blockPos = d->blockPosition(category);
+    applyHiddenRows();
+    applyRowLimits();
+    layout->engine.layout();
 
-    KCategorizedViewPrivate::Item &ritem = block.items[index.row() - firstIndexRow];
+    q->viewport()->update();
 
-    if (ritem.topLeft.isNull() //
-        || (block.quarantineStart.isValid() && index.row() >= block.quarantineStart.row())) {
-        if (flow() == LeftToRight) {
-            d->leftToRightVisualRect(index, ritem, block, blockPos);
-        } else {
-            d->topToBottomVisualRect(index, ritem, block, blockPos);
-        }
+    visibleFirstRow = -1;
+    visibleLastRow = -1;
+    scheduleVisibleRangeUpdate();
+    notifyLayoutFollowers(-1);
+}
 
-        // BEGIN: update the quarantine start
-        const bool wasLastIndex = (index.row() == (block.firstIndex.row() + block.items.count() - 1));
-        if (index.row() == block.quarantineStart.row()) {
-            if (wasLastIndex) {
-                block.quarantineStart = QModelIndex();
-            } else {
-                const QModelIndex nextIndex = d->proxyModel->index(index.row() + 1, modelColumn(), rootIndex());
-                block.quarantineStart = nextIndex;
-            }
+void KCategorizedViewPrivate::resetPendingChanges()
+{
+    relayoutPending = false;
+    elidedTextCache.clear();
+    firstPendingRow = -1;
+    pendingChangedRows = 0;
+    pendingRowCount = -1;
+    // all items are positioned again and the whole viewport repainted
+    changedGeometryRows.clear();
+    changedPaintRows.clear();
+    restoredCategories.clear();
+    validationTimer.stop();
+}
+
+quint64 KCategorizedViewPrivate::layoutFingerprint() const
+{
+    // the fields are hashed in this order, changing it invalidates the saved snapshots
+    const QSize iconSize = q->iconSize();
+    KCategorizedLayoutFingerprint fingerprint;
+    fingerprint.add(model->rowCount(q->rootIndex()));
+    fingerprint.add(q->modelColumn());
+    fingerprint.add(categoryColumn());
+    fingerprint.add(proxyModel ? int(proxyModel->sortOrder()) : -1);
+    fingerprint.add(q->font().key());
+    fingerprint.add(iconSize.width());
+    fingerprint.add(iconSize.height());
+    fingerprint.add(q->spacing());
+    fingerprint.add(int(q->flow()));
+    fingerprint.add(q->uniformItemSizes());
+    fingerprint.add(bool(decorationProvider));
+    return fingerprint.value();
+}
+
+bool KCategorizedViewPrivate::restoreLayoutSnapshot(const QByteArray &snapshot)
+{
+    if (!isLayoutLeader()) {
+        return layoutLeader()->restoreLayoutSnapshot(snapshot);
+    }
+
+    QByteArray userData;
+    if (!layout->engine.restoreSnapshot(snapshot, layoutFingerprint(), &userData)) {
+        return false;
+    }
+
+    QStringList categories;
+    QDataStream stream(userData);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream >> categories;
+    if (stream.status() != QDataStream::Ok || categories.count() != layout->engine.blockCount()) {
+        // the engine has the blocks of the snapshot already, and is no use without the categories
+        markRelayoutPending();
+        scheduleApplyPendingChanges();
+        return false;
+    }
+
+    resetPendingChanges();
+    hoveredBlock = -1;
+    layout->categoryIds.clear();
+    layout->nextCategoryId = 0;
+    for (int block = 0; block < layout->engine.blockCount(); ++block) {
+        const int id = layout->engine.blockCategory(block);
+        // blocks of rows that were not sorted together have ids of their own
+        if (!layout->categoryIds.contains(categories[block])) {
+            layout->categoryIds.insert(categories[block], id);
         }
-        // END: update the quarantine start
+        layout->nextCategoryId = qMax(layout->nextCategoryId, id + 1);
     }
 
-    // we get now the absolute position through the relative position of the parent block. do not
-    // save this on ritem, since this would override the item relative position in block terms.
-    KCategorizedViewPrivate::Item item(ritem);
-    item.topLeft.ry() += blockPos.y();
+    restoredCategories = categories;
+    validatedBlocks = 0;
+    validationTimer.start();
 
-    const QSize sizeHint = item.size;
+    // snapshots do not know about hidden rows, and the row limit might have changed since
+    applyHiddenRows();
+    applyRowLimits();
+    layout->engine.setParams(layoutParams());
+    layout->engine.layout();
 
-    if (d->hasGrid()) {
-        const QSize sizeGrid = gridSize();
-        const QSize resultingSize = sizeHint.boundedTo(sizeGrid);
-        QRect res(item.topLeft.x() + ((sizeGrid.width() - resultingSize.width()) / 2), item.topLeft.y(), resultingSize.width(), resultingSize.height());
-        if (block.collapsed) {
-            // we can still do binary search, while we "hide" items. We move those items in collapsed
-            // blocks to the left and set a 0 height.
-            res.setLeft(-resultingSize.width());
-            res.setHeight(0);
+    q->updateGeometries();
+    q->viewport()->update();
+
+    visibleFirstRow = -1;
+    visibleLastRow = -1;
+    scheduleVisibleRangeUpdate();
+    notifyLayoutFollowers(-1);
+
+    return true;
+}
+
+void KCategorizedViewPrivate::applyHiddenRows()
+{
+    // rows removed from the model, or hidden under another root index, are forgotten. The rows
+    // are kept in the model column the view shows, which setRowHidden() looks them up in.
+    const QModelIndex root = q->rootIndex();
+    const int column = q->modelColumn();
+    QSet<QPersistentModelIndex> rows;
+    rows.reserve(hiddenRows.size());
+    for (const QPersistentModelIndex &index : std::as_const(hiddenRows)) {
+        if (!index.isValid() || index.parent() != root) {
+            continue;
         }
-        return d->mapToViewport(res);
+        rows.insert(index.column() == column ? index : QPersistentModelIndex(index.siblingAtColumn(column)));
+        layout->engine.setRowsHidden(index.row(), index.row(), true);
     }
+    hiddenRows = std::move(rows);
+}
 
-    QRect res(item.topLeft.x(), item.topLeft.y(), sizeHint.width(), sizeHint.height());
-    if (block.collapsed) {
-        // we can still do binary search, while we "hide" items. We move those items in collapsed
-        // blocks to the left and set a 0 height.
-        res.setLeft(-sizeHint.width());
-        res.setHeight(0);
+void KCategorizedViewPrivate::applyRowLimits()
+{
+    KCategorizedLayoutEngine &engine = layout->engine;
+    engine.setRowLimit(categoryRowLimit);
+    for (int block = 0; block < engine.blockCount(); ++block) {
+        engine.setBlockUnlimited(block, false);
+    }
+    for (const QString &category : std::as_const(layout->showAllCategories)) {
+        const int block = blockForCategory(category);
+        if (block != -1) {
+            engine.setBlockUnlimited(block, true);
+        }
+    }
+}
+
+void KCategorizedViewPrivate::rowLimitChanged(int firstRow)
+{
+    if (!isLayoutLeader()) {
+        layoutLeader()->rowLimitChanged(firstRow);
+        return;
+    }
+
+    // rebuilding the blocks applies the row limits anyway
+    if (relayoutPending) {
+        return;
+    }
+
+    firstPendingRow = firstPendingRow == -1 ? firstRow : qMin(firstPendingRow, firstRow);
+    applyPendingChanges();
+    for (KCategorizedViewPrivate *const view : std::as_const(layout->views)) {
+        view->q->updateGeometries();
+    }
+}
+
+void KCategorizedViewPrivate::validateRestoredBlocks()
+{
+    if (restoredCategories.count() != layout->engine.blockCount()) {
+        restoredCategories.clear();
+        return;
+    }
+
+    // one block is two calls to the model, a few hundred of them take well below a frame
+    const int end = qMin(validatedBlocks + 256, int(restoredCategories.count()));
+    for (; validatedBlocks < end; ++validatedBlocks) {
+        const int first = layout->engine.blockFirstRow(validatedBlocks);
+        const int last = first + layout->engine.blockRowCount(validatedBlocks) - 1;
+        const QString &category = restoredCategories[validatedBlocks];
+        if (categoryForIndex(model->index(first, q->modelColumn(), q->rootIndex())) != category
+            || categoryForIndex(model->index(last, q->modelColumn(), q->rootIndex())) != category) {
+            // the model changed since the snapshot was saved
+            markRelayoutPending();
+            scheduleApplyPendingChanges();
+            restoredCategories.clear();
+            return;
+        }
+    }
+
+    if (validatedBlocks < restoredCategories.count()) {
+        validationTimer.start();
+    } else {
+        restoredCategories.clear();
+    }
+}
+
+void KCategorizedViewPrivate::ensureSearchIndex()
+{
+    const QModelIndex root = q->rootIndex();
+    if (searchIndexValid && searchIndexRoot == root && searchIndexColumn == q->modelColumn()) {
+        return;
+    }
+
+    const int rowCount = model->rowCount(root);
+    searchIndex.clear();
+    searchIndex.reserve(rowCount);
+    for (int row = 0; row < rowCount; ++row) {
+        searchIndex.append({model->index(row, q->modelColumn(), root).data(Qt::DisplayRole).toString().toCaseFolded(), row});
+    }
+    std::sort(searchIndex.begin(), searchIndex.end());
+
+    searchIndexValid = true;
+    searchIndexRoot = root;
+    searchIndexColumn = q->modelColumn();
+}
+
+void KCategorizedViewPrivate::invalidateSearchIndex()
+{
+    searchIndexValid = false;
+    searchIndex = QList<std::pair<QString, int>>();
+}
+
+int KCategorizedViewPrivate::findSearchMatch(const QString &prefix, int start, int first, int end)
+{
+    ensureSearchIndex();
+
+    // the texts starting with the prefix follow each other, from the first one not before it
+    const QString key = prefix.toCaseFolded();
+    auto it = std::lower_bound(searchIndex.cbegin(), searchIndex.cend(), key, [](const std::pair<QString, int> &entry, const QString &key) {
+        return entry.first < key;
+    });
+
+    // the closest row from start on, or failing that, the closest one from first on. Only rows
+    // that would be closer are asked whether they are enabled, and hidden or capped rows are
+    // skipped.
+    const auto isEnabled = [this](int row) {
+        return !layout->engine.isRowHidden(row) && !layout->engine.isRowCapped(row)
+            && model->flags(model->index(row, q->modelColumn(), q->rootIndex())).testFlag(Qt::ItemIsEnabled);
+    };
+    int next = -1;
+    int wrapped = -1;
+    for (; it != searchIndex.cend() && it->first.startsWith(key); ++it) {
+        const int row = it->second;
+        if (row < first || row >= end) {
+            continue;
+        }
+        if (row >= start) {
+            if ((next == -1 || row < next) && isEnabled(row)) {
+                next = row;
+            }
+        } else if (next == -1 && (wrapped == -1 || row < wrapped) && isEnabled(row)) {
+            wrapped = row;
+        }
+    }
+
+    return next != -1 ? next : wrapped;
+}
+
+bool KCategorizedViewPrivate::hasEditorInRange(const QModelIndex &topLeft, const QModelIndex &bottomRight) const
+{
+    if (q->modelColumn() < topLeft.column() || q->modelColumn() > bottomRight.column()) {
+        return false;
+    }
+
+    // editors and index widgets are children of the viewport, most views have none at all
+    if (!q->viewport()->findChild<QWidget *>(QString(), Qt::FindDirectChildrenOnly)) {
+        return false;
+    }
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const QModelIndex index = model->index(row, q->modelColumn(), q->rootIndex());
+        if (q->isPersistentEditorOpen(index) || q->indexWidget(index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool KCategorizedViewPrivate::isDormant() const
+{
+    return layoutLeader()->relayoutPending || !isLayoutVisible();
+}
+
+void KCategorizedViewPrivate::markRelayoutPending()
+{
+    layoutLeader()->relayoutPending = true;
+    hoveredBlock = -1;
+}
+
+bool KCategorizedViewPrivate::recordStructuralChange(int start, int delta, int rowCount)
+{
+    elidedTextCache.clear();
+    moveRowIntervals(changedGeometryRows, start, delta);
+    moveRowIntervals(changedPaintRows, start, delta);
+
+    // the leader patches the shared blocks, and lets us know what to repaint
+    if (!isLayoutLeader()) {
+        return false;
+    }
+
+    pendingRowCount = rowCount;
+    // blocks are moving, the ones left to check against the model would not be found anymore
+    restoredCategories.clear();
+    validationTimer.stop();
+
+    if (isDormant()) {
+        markRelayoutPending();
+        return false;
+    }
+
+    firstPendingRow = firstPendingRow == -1 ? start : qMin(firstPendingRow, start);
+    pendingChangedRows += qAbs(delta);
+    scheduleApplyPendingChanges();
+
+    // patching a block costs more per row than creating it from scratch. Once the rows changed on
+    // this event loop iteration are a considerable part of the model, rebuild everything instead.
+    // Appending is the exception: it never touches the rows that are already laid out.
+    const bool appending = delta > 0 && start > 0 && start + delta == rowCount;
+    const int rebuildRatio = 4;
+    if (!appending && pendingChangedRows * rebuildRatio > rowCount) {
+        markRelayoutPending();
+        return false;
+    }
+
+    return true;
+}
+
+void KCategorizedViewPrivate::scheduleApplyPendingChanges()
+{
+    if (!isLayoutLeader()) {
+        layoutLeader()->scheduleApplyPendingChanges();
+        return;
+    }
+
+    if (applyPendingChangesQueued) {
+        return;
+    }
+
+    applyPendingChangesQueued = true;
+    QTimer::singleShot(0, q, [this]() {
+        applyPendingChangesQueued = false;
+        if (isLayoutVisible()) {
+            applyPendingChanges();
+        }
+    });
+}
+
+bool KCategorizedViewPrivate::hasPendingChanges() const
+{
+    const KCategorizedViewPrivate *const leader = layoutLeader();
+    return leader->relayoutPending || leader->firstPendingRow != -1;
+}
+
+void KCategorizedViewPrivate::applyPendingChanges()
+{
+    if (!isLayoutLeader()) {
+        layoutLeader()->applyPendingChanges();
+        return;
+    }
+
+    if (!hasPendingChanges() || !isCategorized()) {
+        return;
+    }
+
+    // rows are about to be removed, but the model still contains them
+    if (pendingRowCount != -1 && model->rowCount(q->rootIndex()) != pendingRowCount) {
+        return;
+    }
+
+    if (relayoutPending) {
+        rebuildBlocks();
+        return;
+    }
+
+    const int firstRow = firstPendingRow;
+    firstPendingRow = -1;
+    pendingChangedRows = 0;
+    pendingRowCount = -1;
+
+    layout->engine.setParams(layoutParams());
+    layout->engine.layout();
+
+    updateFromRow(firstRow);
+
+    // the rows we reported might be showing other items now
+    visibleFirstRow = -1;
+    visibleLastRow = -1;
+    scheduleVisibleRangeUpdate();
+    notifyLayoutFollowers(firstRow);
+}
+
+KCategorizedLayout::Params KCategorizedViewPrivate::layoutParams() const
+{
+    KCategorizedLayout::Params params;
+    params.blockX = categorySpacing;
+    params.leftMargin = categoryDrawer->leftMargin();
+    params.viewportWidth = viewportWidth();
+    params.spacing = q->spacing();
+    if (hasGrid()) {
+        params.gridSize = q->gridSize();
+    }
+    params.uniformItemSizes = q->uniformItemSizes();
+    params.rightToLeft = q->layoutDirection() == Qt::RightToLeft;
+    params.topToBottom = q->flow() == QListView::TopToBottom;
+    return params;
+}
+
+void KCategorizedViewPrivate::recordDataChange(int first, int last, const QList<int> &roles)
+{
+    QList<std::pair<int, int>> &rows = KItemDataChange::effectOf(roles) == KItemDataChange::Effect::Geometry ? changedGeometryRows : changedPaintRows;
+
+    // models usually notify the same few rows over and over again. Merge with what we already have
+    // if possible, and do not let the intervals grow without bounds otherwise.
+    bool merged = false;
+    for (std::pair<int, int> &interval : rows) {
+        if (first <= interval.second + 1 && last >= interval.first - 1) {
+            interval.first = qMin(interval.first, first);
+            interval.second = qMax(interval.second, last);
+            merged = true;
+            break;
+        }
+    }
+    if (!merged) {
+        const int maxIntervals = 32;
+        if (rows.count() == maxIntervals) {
+            for (const std::pair<int, int> &interval : std::as_const(rows)) {
+                first = qMin(first, interval.first);
+                last = qMax(last, interval.second);
+            }
+            rows.clear();
+        }
+        rows.append({first, last});
+    }
+
+    if (!dataChangedTimer.isActive()) {
+        dataChangedTimer.start(frameInterval());
+    }
+}
+
+void KCategorizedViewPrivate::flushDataChanges()
+{
+    const QList<std::pair<int, int>> geometryRows = std::exchange(changedGeometryRows, {});
+    const QList<std::pair<int, int>> paintRows = std::exchange(changedPaintRows, {});
+
+    if (!geometryRows.isEmpty() || !paintRows.isEmpty()) {
+        elidedTextCache.clear();
+    }
+
+    if (!isCategorized() || (geometryRows.isEmpty() && paintRows.isEmpty())) {
+        return;
+    }
+
+    if (isDormant()) {
+        if (!geometryRows.isEmpty()) {
+            markRelayoutPending();
+        }
+        return;
+    }
+
+    // BEGIN: since the model changed data, we need to reconsider item sizes
+    // the leader does that for all views sharing the layout, and lets us know what moved
+    int repaintedFrom = -1;
+    if (!geometryRows.isEmpty() && isLayoutLeader()) {
+        hoveredBlock = -1;
+
+        int firstRow = geometryRows.first().first;
+        for (const std::pair<int, int> &interval : geometryRows) {
+            firstRow = qMin(firstRow, interval.first);
+            layout->engine.resizeRows(interval.first, interval.second);
+        }
+
+        // sizes might have changed, so the blocks under the changed items might have to move too.
+        // This repaints everything under the first changed item, so if that item was visible, only
+        // the items above it that need a repaint are left.
+        firstPendingRow = firstPendingRow == -1 ? firstRow : qMin(firstPendingRow, firstRow);
+        applyPendingChanges();
+        q->updateGeometries();
+        if (q->visualRect(model->index(firstRow, q->modelColumn(), q->rootIndex())).top() <= q->viewport()->rect().bottom()) {
+            repaintedFrom = firstRow;
+        }
+    }
+    // END: since the model changed data, we need to reconsider item sizes
+
+    // BEGIN: repaint the changed items that are visible, and only those
+    const std::pair<QModelIndex, QModelIndex> visible = intersectingIndexesWithRect(q->viewport()->rect());
+    if (!visible.first.isValid() || !visible.second.isValid()) {
+        return;
+    }
+
+    QRegion dirty;
+    for (const std::pair<int, int> &interval : paintRows) {
+        const int first = qMax(interval.first, visible.first.row());
+        const int last = qMin(interval.second, repaintedFrom == -1 ? visible.second.row() : qMin(visible.second.row(), repaintedFrom - 1));
+        for (int i = first; i <= last; ++i) {
+            dirty += q->visualRect(model->index(i, q->modelColumn(), q->rootIndex()));
+        }
+    }
+    q->viewport()->update(dirty);
+    // END: repaint the changed items that are visible, and only those
+}
+
+void KCategorizedViewPrivate::scheduleVisibleRangeUpdate()
+{
+    if (!visibleRangeTimer.isActive()) {
+        visibleRangeTimer.start(frameInterval());
+    }
+}
+
+void KCategorizedViewPrivate::updateEngineVisibleRect()
+{
+    // blocks in view, or about to be, are never evicted. That goes for all views sharing the layout.
+    QRect visibleRect;
+    for (const KCategorizedViewPrivate *view : std::as_const(layout->views)) {
+        const QRect viewportRect = view->q->viewport()->rect().adjusted(0, -view->visibleRangeMargin, 0, view->visibleRangeMargin);
+        visibleRect |= view->mapFromViewport(viewportRect);
+    }
+    layout->engine.setVisibleRect(visibleRect);
+}
+
+void KCategorizedViewPrivate::updateVisibleRange()
+{
+    if (!isCategorized() || !q->isVisible()) {
+        return;
+    }
+
+    fetchMoreIfNeeded();
+    applyPendingChanges();
+
+    const QRect rect = q->viewport()->rect().adjusted(0, -visibleRangeMargin, 0, visibleRangeMargin);
+    std::pair<QModelIndex, QModelIndex> range = intersectingIndexesWithRect(rect);
+    if (!range.first.isValid() || !range.second.isValid() || range.first.row() > range.second.row()) {
+        range = {QModelIndex(), QModelIndex()};
+    }
+
+    const int firstRow = range.first.isValid() ? range.first.row() : -1;
+    const int lastRow = range.second.isValid() ? range.second.row() : -1;
+    if (firstRow == visibleFirstRow && lastRow == visibleLastRow) {
+        return;
+    }
+
+    visibleFirstRow = firstRow;
+    visibleLastRow = lastRow;
+    if (decorationProvider) {
+        decorationProvider->cancelRequestsOutside(range.first, range.second);
+    }
+    Q_EMIT q->visibleRangeChanged(range.first, range.second);
+}
+
+void KCategorizedViewPrivate::fetchMoreIfNeeded()
+{
+    const QModelIndex root = q->rootIndex();
+    if (!model->canFetchMore(root)) {
+        return;
+    }
+
+    const int rowCount = model->rowCount(root);
+    if (!rowCount) {
+        model->fetchMore(root);
+        return;
+    }
+
+    // QAbstractItemView only fetches when the scroll bar hits its maximum. Ask for more rows while
+    // the laid out items end less than a page below the viewport instead, so that they have
+    // arrived, and the scroll bar has grown, by the time the user gets to the end.
+    // The items end with the last block, whose position and height stay known while it is
+    // evicted, and whatever its last item is hidden or capped.
+    const int lastBlock = layout->engine.blockCount() - 1;
+    int bottom = -1;
+    if (lastBlock != -1) {
+        bottom = mapToViewport(QRect(layout->engine.blockPosition(lastBlock), QSize(1, qMax(layout->engine.blockHeight(lastBlock), 1)))).bottom();
+    }
+    if (bottom < q->viewport()->height() * 2 + visibleRangeMargin) {
+        model->fetchMore(root);
+    }
+}
+
+void KCategorizedViewPrivate::trackScrollVelocity()
+{
+    const int offset = q->verticalOffset();
+    const int distance = qAbs(offset - lastScrollOffset);
+    lastScrollOffset = offset;
+    if (!fastScrollPainting || !distance) {
+        return;
+    }
+
+    // a pause longer than the settle delay starts a new gesture, so it does not lower the velocity
+    const bool newGesture = !scrollClock.isValid() || scrollClock.elapsed() > scrollSettleTimer.interval();
+    const qint64 elapsed = newGesture ? frameInterval() : qMax<qint64>(1, scrollClock.elapsed());
+    scrollClock.start();
+
+    const qreal velocity = distance / qreal(elapsed);
+    scrollVelocity = newGesture ? velocity : (scrollVelocity + velocity) / 2;
+
+    // fast means about a page every quarter of a second. Slowing down to half of that while still
+    // scrolling also goes back to full quality.
+    const qreal threshold = qMax(1, q->viewport()->height()) / qreal(250);
+    if (scrollVelocity > threshold) {
+        fastScrolling = true;
+    } else if (fastScrolling && scrollVelocity < threshold / 2) {
+        scrollSettled();
+        return;
+    }
+
+    scrollSettleTimer.start();
+}
+
+void KCategorizedViewPrivate::scrollSettled()
+{
+    scrollSettleTimer.stop();
+    scrollVelocity = 0;
+    if (fastScrolling) {
+        fastScrolling = false;
+        q->viewport()->update();
+    }
+}
+
+void KCategorizedViewPrivate::paintSkeleton(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index)
+{
+    QStyle *const style = q->style();
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, q);
+
+    // a simplified version of the layout of QCommonStyle, without laying out the text
+    const int margin = style->pixelMetric(QStyle::PM_FocusFrameHMargin, &option, q) + 1;
+    const bool hasDecoration = decorationProvider && option.decorationSize.isValid();
+    const QSize decorationSize = hasDecoration ? option.decorationSize : QSize(0, 0);
+    QRect decorationRect(QPoint(), decorationSize);
+    QRect textRect = option.rect;
+    Qt::Alignment alignment = option.displayAlignment;
+    if (option.decorationPosition == QStyleOptionViewItem::Top) {
+        decorationRect.moveTopLeft(QPoint(option.rect.left() + (option.rect.width() - decorationSize.width()) / 2, option.rect.top() + margin));
+        textRect.setTop(decorationRect.bottom() + margin);
+        textRect.setHeight(option.fontMetrics.height());
+        alignment = (alignment & Qt::AlignHorizontal_Mask) | Qt::AlignTop;
+    } else {
+        decorationRect.moveTopLeft(QPoint(option.rect.left() + margin, option.rect.top() + (option.rect.height() - decorationSize.height()) / 2));
+        textRect.setLeft(hasDecoration ? decorationRect.right() + margin * 2 : option.rect.left() + margin);
+        textRect.setRight(option.rect.right() - margin);
+        decorationRect = QStyle::visualRect(option.direction, option.rect, decorationRect);
+        textRect = QStyle::visualRect(option.direction, option.rect, textRect);
+    }
+
+    if (hasDecoration) {
+        const QPixmap decoration = decorationProvider->cachedDecoration(index);
+        if (!decoration.isNull()) {
+            QRect pixmapRect(QPoint(), (decoration.deviceIndependentSize().toSize()).boundedTo(decorationSize));
+            pixmapRect.moveCenter(decorationRect.center());
+            painter->drawPixmap(pixmapRect, decoration);
+        } else {
+            painter->fillRect(decorationRect, option.palette.color(QPalette::Midlight));
+        }
+    }
+
+    if (textRect.width() <= 0) {
+        return;
+    }
+
+    auto it = elidedTextCache.find(index.row());
+    if (it == elidedTextCache.end() || it->width != textRect.width()) {
+        if (elidedTextCache.size() > 16384) {
+            elidedTextCache.clear();
+        }
+        const QString text = index.data(Qt::DisplayRole).toString();
+        it = elidedTextCache.insert(index.row(), {option.fontMetrics.elidedText(text, option.textElideMode, textRect.width()), textRect.width()});
+    }
+
+    const QPalette::ColorGroup group = option.state & QStyle::State_Enabled ? QPalette::Normal : QPalette::Disabled;
+    const QPalette::ColorRole role = option.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text;
+    painter->setPen(option.palette.color(group, role));
+    painter->drawText(textRect, alignment, it->text);
+}
+
+int KCategorizedViewPrivate::frameInterval() const
+{
+    const QScreen *screen = q->screen();
+    const qreal refreshRate = screen ? screen->refreshRate() : 60;
+    return qMax(1, qRound(1000 / qMax(refreshRate, qreal(1))));
+}
+
+QRect KCategorizedViewPrivate::mapToViewport(const QRect &rect) const
+{
+    const int dx = -q->horizontalOffset();
+    const int dy = -q->verticalOffset();
+    return rect.adjusted(dx, dy, dx, dy);
+}
+
+QRect KCategorizedViewPrivate::mapFromViewport(const QRect &rect) const
+{
+    const int dx = q->horizontalOffset();
+    const int dy = q->verticalOffset();
+    return rect.adjusted(dx, dy, dx, dy);
+}
+
+bool KCategorizedViewPrivate::hasGrid() const
+{
+    const QSize gridSize = q->gridSize();
+    return gridSize.isValid() && !gridSize.isNull();
+}
+
+QString KCategorizedViewPrivate::categoryForIndex(const QModelIndex &index) const
+{
+    const auto indexModel = index.model();
+    if (!indexModel || !model) {
+        qCWarning(KITEMVIEWS_LOG) << "Index or view doesn't contain model";
+        return QString();
+    }
+
+    const QModelIndex categoryIndex = indexModel->index(index.row(), categoryColumn(), index.parent());
+    return categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+}
+
+void KCategorizedViewPrivate::_k_slotCollapseOrExpandClicked(QModelIndex)
+{
+}
+
+KCategorizedScrollBarMarkers::KCategorizedScrollBarMarkers(KCategorizedViewPrivate *view, QScrollBar *scrollBar)
+    : QWidget(scrollBar)
+    , m_view(view)
+    , m_scrollBar(scrollBar)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setGeometry(scrollBar->rect());
+    scrollBar->installEventFilter(this);
+    show();
+}
+
+bool KCategorizedScrollBarMarkers::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_scrollBar && event->type() == QEvent::Resize) {
+        setGeometry(m_scrollBar->rect());
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void KCategorizedScrollBarMarkers::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    KCategorizedLayoutEngine &engine = m_view->layout->engine;
+    if (!m_view->isCategorized() || engine.blockCount() < 2) {
+        return;
+    }
+
+    // QScrollBar::initStyleOption() is protected
+    QStyleOptionSlider option;
+    option.initFrom(m_scrollBar);
+    option.subControls = QStyle::SC_All;
+    option.orientation = m_scrollBar->orientation();
+    option.minimum = m_scrollBar->minimum();
+    option.maximum = m_scrollBar->maximum();
+    option.sliderPosition = m_scrollBar->sliderPosition();
+    option.sliderValue = m_scrollBar->value();
+    option.singleStep = m_scrollBar->singleStep();
+    option.pageStep = m_scrollBar->pageStep();
+    const QRect groove = style()->subControlRect(QStyle::CC_ScrollBar, &option, QStyle::SC_ScrollBarGroove, m_scrollBar);
+
+    // the groove stands for all the items, from the top of the first header on
+    const qint64 contentHeight = qint64(m_scrollBar->maximum()) + m_view->q->viewport()->height();
+    if (groove.isEmpty() || contentHeight <= 0) {
+        return;
+    }
+
+    QPainter painter(this);
+    QColor color = palette().color(QPalette::Highlight);
+    color.setAlphaF(0.6);
+    painter.setPen(color);
+
+    // blocks closer than a pixel from each other share their tick
+    int lastY = groove.top();
+    for (int block = 1; block < engine.blockCount(); ++block) {
+        const qint64 top = engine.blockPosition(block).y() - engine.blockHeaderHeight(block);
+        const int y = groove.top() + int(top * groove.height() / contentHeight);
+        if (y <= lastY) {
+            continue;
+        }
+        if (y > groove.bottom()) {
+            break;
+        }
+        painter.drawLine(groove.left() + 1, y, groove.right() - 1, y);
+        lastY = y;
+    }
+}
+
+// END: Private part
+
+// BEGIN: Public part
+
+KCategorizedView::KCategorizedView(QWidget *parent)
+    : QListView(parent)
+    , d(new KCategorizedViewPrivate(this))
+{
+    connect(this, &QAbstractItemView::iconSizeChanged, this, [this]() {
+        d->regenerateAllElements();
+    });
+}
+
+KCategorizedView::~KCategorizedView() = default;
+
+void KCategorizedView::setModel(QAbstractItemModel *model)
+{
+    if (d->model == model) {
+        return;
+    }
+
+    // views of other models can not share our layout anymore
+    if (d->layout->views.size() > 1) {
+        const qsizetype memoryBudget = d->layout->engine.memoryBudget();
+        d->setLayout(std::make_shared<KCategorizedSharedLayout>());
+        d->layout->engine.setMemoryBudget(memoryBudget);
+    }
+
+    d->layout->engine.clear();
+    d->invalidateSearchIndex();
+
+    if (d->model) {
+        disconnect(d->model, SIGNAL(layoutChanged()), this, SLOT(slotLayoutChanged()));
+        disconnect(d->model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotLayoutChanged()));
+    }
+
+    d->model = model;
+    d->proxyModel = dynamic_cast<KCategorizedSortFilterProxyModel *>(model);
+
+    // a grouped model keeps its rows grouped by category, but moved rows can split a block or
+    // join two of them
+    if (d->model) {
+        connect(d->model, SIGNAL(layoutChanged()), this, SLOT(slotLayoutChanged()));
+        connect(d->model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotLayoutChanged()));
+    }
+
+    QListView::setModel(model);
+
+    // if the model already had information inserted, update our data structures to it
+    if (model && model->rowCount()) {
+        slotLayoutChanged();
+    }
+}
+
+void KCategorizedView::setGridSize(const QSize &size)
+{
+    setGridSizeOwn(size);
+}
+
+void KCategorizedView::setGridSizeOwn(const QSize &size)
+{
+    d->regenerateAllElements();
+    QListView::setGridSize(size);
+}
+
+void KCategorizedView::setRowHidden(int row, bool hide)
+{
+    QListView::setRowHidden(row, hide);
+
+    const QModelIndex index = d->model ? d->model->index(row, modelColumn(), rootIndex()) : QModelIndex();
+    if (!index.isValid()) {
+        return;
+    }
+
+    if (hide) {
+        if (d->hiddenRows.contains(index)) {
+            return;
+        }
+        d->hiddenRows.insert(index);
+    } else if (!d->hiddenRows.remove(index)) {
+        return;
+    }
+
+    if (!d->isCategorized()) {
+        return;
+    }
+
+    // the layout is our own from now on, and rebuilding it hides the rows anyway. Showing the last
+    // hidden row might let us share the layout we left again, which has no hidden rows.
+    d->checkLayoutSharing();
+    if (d->relayoutPending || !d->isLayoutLeader() || row >= d->layout->engine.rowCount()) {
+        return;
+    }
+
+    // the block of the row is laid out again when the changes are applied, once for all the rows
+    // hidden or shown until then
+    d->layout->engine.setRowsHidden(row, row, hide);
+    d->firstPendingRow = d->firstPendingRow == -1 ? row : qMin(d->firstPendingRow, row);
+    d->scheduleApplyPendingChanges();
+}
+
+QRect KCategorizedView::visualRect(const QModelIndex &index) const
+{
+    if (!d->isCategorized()) {
+        return QListView::visualRect(index);
+    }
+
+    if (!index.isValid()) {
+        return QRect();
+    }
+
+    d->applyPendingChanges();
+
+    if (d->layout->engine.blockForRow(index.row()) == -1 || d->layout->engine.isRowHidden(index.row()) || d->layout->engine.isRowCapped(index.row())) {
+        return QRect();
+    }
+
+    return d->mapToViewport(d->layout->engine.itemRect(index.row()));
+}
+
+KCategoryDrawer *KCategorizedView::categoryDrawer() const
+{
+    return d->categoryDrawer;
+}
+
+void KCategorizedView::setCategoryDrawer(KCategoryDrawer *categoryDrawer)
+{
+    if (d->categoryDrawer) {
+        disconnect(d->categoryDrawer, SIGNAL(collapseOrExpandClicked(QModelIndex)), this, SLOT(_k_slotCollapseOrExpandClicked(QModelIndex)));
+    }
+
+    d->categoryDrawer = categoryDrawer;
+
+    connect(d->categoryDrawer, SIGNAL(collapseOrExpandClicked(QModelIndex)), this, SLOT(_k_slotCollapseOrExpandClicked(QModelIndex)));
+
+    // views with drawers of another kind measure their headers differently
+    d->checkLayoutSharing();
+}
+
+int KCategorizedView::categorySpacing() const
+{
+    return d->categorySpacing;
+}
+
+void KCategorizedView::setCategorySpacing(int categorySpacing)
+{
+    if (d->categorySpacing == categorySpacing) {
+        return;
+    }
+
+    d->categorySpacing = categorySpacing;
+
+    // blocks move, and their items have less room
+    if (d->isCategorized()) {
+        d->checkLayoutSharing();
+        d->layout->engine.setParams(d->layoutParams());
+    }
+    Q_EMIT categorySpacingChanged(d->categorySpacing);
+}
+
+bool KCategorizedView::alternatingBlockColors() const
+{
+    return d->alternatingBlockColors;
+}
+
+void KCategorizedView::setAlternatingBlockColors(bool enable)
+{
+    if (d->alternatingBlockColors == enable) {
+        return;
+    }
+
+    d->alternatingBlockColors = enable;
+    Q_EMIT alternatingBlockColorsChanged(d->alternatingBlockColors);
+}
+
+bool KCategorizedView::collapsibleBlocks() const
+{
+    return d->collapsibleBlocks;
+}
+
+void KCategorizedView::setCollapsibleBlocks(bool enable)
+{
+    if (d->collapsibleBlocks == enable) {
+        return;
+    }
+
+    d->collapsibleBlocks = enable;
+    Q_EMIT collapsibleBlocksChanged(d->collapsibleBlocks);
+}
+
+bool KCategorizedView::groupedModel() const
+{
+    return d->groupedModel;
+}
+
+void KCategorizedView::setGroupedModel(bool enable)
+{
+    if (d->groupedModel == enable) {
+        return;
+    }
+
+    d->groupedModel = enable;
+
+    // the model might be categorized now, or not anymore, which lays out all items differently
+    if (d->model && !d->proxyModel) {
+        d->checkLayoutSharing();
+        d->layout->engine.clear();
+        d->markRelayoutPending();
+        slotLayoutChanged();
+        scheduleDelayedItemsLayout();
+        viewport()->update();
+    }
+    Q_EMIT groupedModelChanged(d->groupedModel);
+}
+
+bool KCategorizedView::keyboardSearchInBlock() const
+{
+    return d->keyboardSearchInBlock;
+}
+
+void KCategorizedView::setKeyboardSearchInBlock(bool enable)
+{
+    if (d->keyboardSearchInBlock == enable) {
+        return;
+    }
+
+    d->keyboardSearchInBlock = enable;
+    Q_EMIT keyboardSearchInBlockChanged(d->keyboardSearchInBlock);
+}
+
+bool KCategorizedView::scrollBarCategoryMarkers() const
+{
+    return !d->scrollBarMarkers.isNull();
+}
+
+void KCategorizedView::setScrollBarCategoryMarkers(bool enable)
+{
+    if (!d->scrollBarMarkers.isNull() == enable) {
+        return;
+    }
+
+    if (enable) {
+        d->scrollBarMarkers = new KCategorizedScrollBarMarkers(d.get(), verticalScrollBar());
+    } else {
+        delete d->scrollBarMarkers;
+    }
+    Q_EMIT scrollBarCategoryMarkersChanged(enable);
+}
+
+int KCategorizedView::categoryRowLimit() const
+{
+    return d->categoryRowLimit;
+}
+
+void KCategorizedView::setCategoryRowLimit(int limit)
+{
+    limit = qMax(limit, 0);
+    if (d->categoryRowLimit == limit) {
+        return;
+    }
+
+    d->categoryRowLimit = limit;
+    Q_EMIT categoryRowLimitChanged(d->categoryRowLimit);
+
+    if (!d->isCategorized()) {
+        return;
+    }
+
+    // the layout is our own from now on, unless the other views have the same limit
+    d->checkLayoutSharing();
+    d->layout->engine.setRowLimit(limit);
+    d->rowLimitChanged(0);
+}
+
+int KCategorizedView::cappedRowCount(const QString &category) const
+{
+    if (!d->isCategorized()) {
+        return 0;
+    }
+
+    const int block = d->blockForCategory(category);
+    return block == -1 ? 0 : d->layout->engine.blockCappedRowCount(block);
+}
+
+int KCategorizedView::cappedRowCount(const QModelIndex &representative) const
+{
+    if (!d->isCategorized() || representative.model() != d->model || representative.parent() != rootIndex()) {
+        return 0;
+    }
+
+    const int block = d->layout->engine.blockForRow(representative.row());
+    return block == -1 ? 0 : d->layout->engine.blockCappedRowCount(block);
+}
+
+bool KCategorizedView::showsAllRows(const QString &category) const
+{
+    return d->layout->showAllCategories.contains(category);
+}
+
+void KCategorizedView::setShowAllRows(const QString &category, bool show)
+{
+    KCategorizedSharedLayout &layout = *d->layout;
+    if (layout.showAllCategories.contains(category) == show) {
+        return;
+    }
+
+    if (show) {
+        layout.showAllCategories.insert(category);
+    } else {
+        layout.showAllCategories.remove(category);
+    }
+
+    const int block = d->isCategorized() ? d->blockForCategory(category) : -1;
+    if (block == -1) {
+        return;
+    }
+
+    layout.engine.setBlockUnlimited(block, show);
+    d->rowLimitChanged(layout.engine.blockFirstRow(block));
+}
+
+void KCategorizedView::setShowAllRows(const QModelIndex &representative, bool show)
+{
+    if (representative.model() != d->model) {
+        return;
+    }
+
+    setShowAllRows(d->categoryForIndex(representative), show);
+}
+
+int KCategorizedView::visibleRangeMargin() const
+{
+    return d->visibleRangeMargin;
+}
+
+void KCategorizedView::setVisibleRangeMargin(int margin)
+{
+    if (d->visibleRangeMargin == margin) {
+        return;
+    }
+
+    d->visibleRangeMargin = margin;
+    d->scheduleVisibleRangeUpdate();
+    Q_EMIT visibleRangeMarginChanged(d->visibleRangeMargin);
+}
+
+bool KCategorizedView::fastScrollPainting() const
+{
+    return d->fastScrollPainting;
+}
+
+void KCategorizedView::setFastScrollPainting(bool enable)
+{
+    if (d->fastScrollPainting == enable) {
+        return;
+    }
+
+    d->fastScrollPainting = enable;
+    if (!enable) {
+        d->scrollSettled();
+        d->elidedTextCache.clear();
+    }
+    Q_EMIT fastScrollPaintingChanged(d->fastScrollPainting);
+}
+
+QByteArray KCategorizedView::saveLayoutSnapshot() const
+{
+    if (!d->isCategorized()) {
+        return QByteArray();
+    }
+
+    d->applyPendingChanges();
+    if (d->hasPendingChanges()) {
+        return QByteArray();
+    }
+
+    QStringList categories;
+    categories.reserve(d->layout->engine.blockCount());
+    for (int block = 0; block < d->layout->engine.blockCount(); ++block) {
+        categories.append(d->categoryForIndex(d->categoryIndex(block)));
+    }
+    QByteArray userData;
+    // snapshots outlive the version of Qt that saved them
+    QDataStream stream(&userData, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << categories;
+
+    return d->layout->engine.saveSnapshot(d->layoutFingerprint(), userData);
+}
+
+bool KCategorizedView::restoreLayoutSnapshot(const QByteArray &snapshot)
+{
+    if (!d->isCategorized()) {
+        return false;
+    }
+
+    return d->restoreLayoutSnapshot(snapshot);
+}
+
+qsizetype KCategorizedView::layoutMemoryBudget() const
+{
+    return d->layout->engine.memoryBudget();
+}
+
+void KCategorizedView::setLayoutMemoryBudget(qsizetype bytes)
+{
+    d->layout->engine.setMemoryBudget(bytes);
+}
+
+KCategorizedView::LayoutCacheStatistics KCategorizedView::layoutCacheStatistics() const
+{
+    const KCategorizedLayoutEngine::CacheStatistics statistics = d->layout->engine.cacheStatistics();
+    return {statistics.bytes, statistics.evictedBlocks, statistics.evictions, statistics.reloads};
+}
+
+bool KCategorizedView::shareLayoutWith(KCategorizedView *view)
+{
+    if (!view || view == this) {
+        d->leaveLayout();
+        d->forgetFormerLayout();
+        return true;
+    }
+
+    if (d->layout == view->d->layout) {
+        return true;
+    }
+
+    if (!d->isLayoutCompatibleWith(view->d.get())) {
+        return false;
+    }
+
+    d->forgetFormerLayout();
+    d->setLayout(view->d->layout);
+    viewport()->update();
+    updateGeometries();
+    return true;
+}
+
+KAsyncDecorationProvider *KCategorizedView::decorationProvider() const
+{
+    return d->decorationProvider;
+}
+
+void KCategorizedView::setDecorationProvider(KAsyncDecorationProvider *provider)
+{
+    if (d->decorationProvider == provider) {
+        return;
+    }
+
+    if (d->decorationProvider) {
+        disconnect(d->decorationProvider, nullptr, this, nullptr);
+    }
+
+    d->decorationProvider = provider;
+
+    if (d->decorationProvider) {
+        connect(d->decorationProvider, &KAsyncDecorationProvider::decorationReady, this, [this](const QModelIndex &index) {
+            if (index.model() == model() && d->isCategorized()) {
+                // the decoration is passed in the style option, a caching delegate cannot know
+                // that it changed
+                if (auto *cachingDelegate = qobject_cast<KCachingItemDelegate *>(itemDelegateForIndex(index))) {
+                    cachingDelegate->invalidate(index);
+                }
+                viewport()->update(visualRect(index));
+            }
+        });
+    }
+
+    // items gain or lose the space reserved for their decoration
+    d->regenerateAllElements();
+    updateGeometries();
+}
+
+QModelIndexList KCategorizedView::block(const QString &category)
+{
+    QModelIndexList res;
+    d->applyPendingChanges();
+    const int block = d->blockForCategory(category);
+    if (block == -1) {
+        return res;
+    }
+    const int first = d->layout->engine.blockFirstRow(block);
+    const int count = d->layout->engine.blockRowCount(block);
+    for (int i = 0; i < count; ++i) {
+        const QModelIndex current = d->model->index(first + i, modelColumn(), rootIndex());
+        if (current.isValid()) {
+            res << current;
+        }
     }
-    return d->mapToViewport(res);
+    return res;
 }
 
-KCategoryDrawer *KCategorizedView::categoryDrawer() const
+QModelIndexList KCategorizedView::block(const QModelIndex &representative)
 {
-    return d->categoryDrawer;
+    return block(representative.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString());
 }
 
-void KCategorizedView::setCategoryDrawer(KCategoryDrawer *categoryDrawer)
+KCategorizedView::BlockRange KCategorizedView::blockRange(const QString &category) const
 {
-    if (d->categoryDrawer) {
-        disconnect(d->categoryDrawer, SIGNAL(collapseOrExpandClicked(QModelIndex)), this, SLOT(_k_slotCollapseOrExpandClicked(QModelIndex)));
+    if (!d->isCategorized()) {
+        return BlockRange();
     }
 
-    d->categoryDrawer = categoryDrawer;
-
-    connect(d->categoryDrawer, SIGNAL(collapseOrExpandClicked(QModelIndex)), this, SLOT(_k_slotCollapseOrExpandClicked(QModelIndex)));
-}
-
-int KCategorizedView::categorySpacing() const
-{
-    return d->categorySpacing;
+    d->applyPendingChanges();
+    return d->blockRange(d->blockForCategory(category));
 }
 
-void KCategorizedView::setCategorySpacing(int categorySpacing)
+KCategorizedView::BlockRange KCategorizedView::blockRange(const QModelIndex &representative) const
 {
-    if (d->categorySpacing == categorySpacing) {
-        return;
+    if (!d->isCategorized() || representative.model() != d->model || representative.parent() != rootIndex()) {
+        return BlockRange();
     }
 
-    d->categorySpacing = categorySpacing;
+    d->applyPendingChanges();
+    return d->blockRange(d->layout->engine.blockForRow(representative.row()));
+}
 
-    for (auto it = d->blocks.begin(); it != d->blocks.end(); ++it) {
-        KCategorizedViewPrivate::Block &block = *it;
-        block.outOfQuarantine = false;
-    }
-    Q_EMIT categorySpacingChanged(d->categorySpacing);
+void KCategorizedView::selectBlock(const QString &category, QItemSelectionModel::SelectionFlags command)
+{
+    d->selectBlock(blockRange(category), command);
 }
 
-bool KCategorizedView::alternatingBlockColors() const
+void KCategorizedView::selectBlock(const QModelIndex &representative, QItemSelectionModel::SelectionFlags command)
 {
-    return d->alternatingBlockColors;
+    d->selectBlock(blockRange(representative), command);
 }
 
-void KCategorizedView::setAlternatingBlockColors(bool enable)
+QStringList KCategorizedView::categories() const
 {
-    if (d->alternatingBlockColors == enable) {
-        return;
+    QStringList categories;
+    if (!d->isCategorized()) {
+        return categories;
     }
 
-    d->alternatingBlockColors = enable;
-    Q_EMIT alternatingBlockColorsChanged(d->alternatingBlockColors);
+    d->applyPendingChanges();
+    categories.reserve(d->layout->engine.blockCount());
+    for (int block = 0; block < d->layout->engine.blockCount(); ++block) {
+        categories.append(d->categoryForIndex(d->categoryIndex(block)));
+    }
+    return categories;
 }
 
-bool KCategorizedView::collapsibleBlocks() const
+QString KCategorizedView::categoryAt(int y) const
 {
-    return d->collapsibleBlocks;
+    if (!d->isCategorized()) {
+        return QString();
+    }
+
+    d->applyPendingChanges();
+    const int block = d->layout->engine.blockAt(y + verticalOffset());
+    return block == -1 ? QString() : d->categoryForIndex(d->categoryIndex(block));
 }
 
-void KCategorizedView::setCollapsibleBlocks(bool enable)
+void KCategorizedView::scrollToCategory(const QString &category, ScrollHint hint)
 {
-    if (d->collapsibleBlocks == enable) {
+    if (!d->isCategorized()) {
         return;
     }
 
-    d->collapsibleBlocks = enable;
-    Q_EMIT collapsibleBlocksChanged(d->collapsibleBlocks);
-}
-
-QModelIndexList KCategorizedView::block(const QString &category)
-{
-    QModelIndexList res;
-    const KCategorizedViewPrivate::Block &block = d->blocks[category];
-    if (block.height == -1) {
-        return res;
+    d->applyPendingChanges();
+    const int block = d->blockForCategory(category);
+    if (block == -1) {
+        return;
     }
-    QModelIndex current = block.firstIndex;
-    const int first = current.row();
-    for (int i = 1; i <= block.items.count(); ++i) {
-        if (current.isValid()) {
-            res << current;
+
+    // the position of the block is enough, its items are only needed once it is painted
+    KCategorizedLayoutEngine &engine = d->layout->engine;
+    const int top = engine.blockPosition(block).y() - engine.blockHeaderHeight(block);
+    const int bottom = engine.blockPosition(block).y() + engine.blockHeight(block);
+    const int viewportHeight = viewport()->height();
+    const int offset = verticalOffset();
+
+    int value = offset;
+    switch (hint) {
+    case EnsureVisible:
+        if (top < offset) {
+            value = top;
+        } else if (bottom > offset + viewportHeight) {
+            value = qMin(top, bottom - viewportHeight);
         }
-        current = d->proxyModel->index(first + i, modelColumn(), rootIndex());
+        break;
+    case PositionAtTop:
+        value = top;
+        break;
+    case PositionAtBottom:
+        value = bottom - viewportHeight;
+        break;
+    case PositionAtCenter:
+        value = (top + bottom - viewportHeight) / 2;
+        break;
     }
-    return res;
-}
-
-QModelIndexList KCategorizedView::block(const QModelIndex &representative)
-{
-    return block(representative.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString());
+    verticalScrollBar()->setValue(value);
 }
 
 QModelIndex KCategorizedView::indexAt(const QPoint &point) const
@@ -706,73 +1996,53 @@ QModelIndex KCategorizedView::indexAt(const QPoint &point) const
         return QListView::indexAt(point);
     }
 
-    const int rowCount = d->proxyModel->rowCount();
+    const int rowCount = d->model->rowCount();
     if (!rowCount) {
         return QModelIndex();
     }
 
-    // Binary search that will try to spot if there is an index under point
-    int bottom = 0;
-    int top = rowCount - 1;
-    while (bottom <= top) {
-        const int middle = (bottom + top) / 2;
-        const QModelIndex index = d->proxyModel->index(middle, modelColumn(), rootIndex());
-        const QRect rect = visualRect(index);
-        if (rect.contains(point)) {
-            if (index.model()->flags(index) & Qt::ItemIsEnabled) {
-                return index;
-            }
-            return QModelIndex();
-        }
-        bool directionCondition;
-        if (layoutDirection() == Qt::LeftToRight) {
-            directionCondition = point.x() >= rect.bottomLeft().x();
-        } else {
-            directionCondition = point.x() <= rect.bottomRight().x();
-        }
-        if (point.y() < rect.topLeft().y()) {
-            top = middle - 1;
-        } else if (directionCondition) {
-            bottom = middle + 1;
-        } else if (point.y() <= rect.bottomRight().y()) {
-            top = middle - 1;
-        } else {
-            bool after = true;
-            for (int i = middle - 1; i >= bottom; i--) {
-                const QModelIndex newIndex = d->proxyModel->index(i, modelColumn(), rootIndex());
-                const QRect newRect = visualRect(newIndex);
-                if (newRect.topLeft().y() < rect.topLeft().y()) {
-                    break;
-                } else if (newRect.contains(point)) {
-                    if (newIndex.model()->flags(newIndex) & Qt::ItemIsEnabled) {
-                        return newIndex;
-                    }
-                    return QModelIndex();
-                    // clang-format off
-                } else if ((layoutDirection() == Qt::LeftToRight) ?
-                           (newRect.topLeft().x() <= point.x()) :
-                           (newRect.topRight().x() >= point.x())) {
-                    // clang-format on
-                    break;
-                } else if (newRect.bottomRight().y() >= point.y()) {
-                    after = false;
-                }
-            }
-            if (!after) {
-                return QModelIndex();
-            }
-            bottom = middle + 1;
-        }
+    d->applyPendingChanges();
+
+    // items do not overlap, so there is at most one
+    const QList<KCategorizedLayoutEngine::RowSpan> rows = d->intersectingRows(QRect(point, QSize(1, 1)));
+    if (rows.isEmpty()) {
+        return QModelIndex();
+    }
+
+    const QModelIndex index = d->model->index(rows.first().first, modelColumn(), rootIndex());
+    if (index.model()->flags(index) & Qt::ItemIsEnabled) {
+        return index;
     }
     return QModelIndex();
 }
 
 void KCategorizedView::reset()
 {
-    d->blocks.clear();
+    d->invalidateSearchIndex();
+    // as QListView::reset() does with its own
+    d->hiddenRows.clear();
+    if (d->isLayoutLeader()) {
+        d->layout->engine.clear();
+        d->layout->showAllCategories.clear();
+        d->pendingRowCount = -1;
+        d->markRelayoutPending();
+    }
+    d->hoveredBlock = -1;
     QListView::reset();
 }
 
+void KCategorizedView::doItemsLayout()
+{
+    // QListView lays its items out again when the spacing, the flow, the uniformity of item sizes,
+    // the delegate, the model or the root index change, which the layout depends on too
+    if (d->isCategorized()) {
+        d->updateLayoutParams();
+    } else {
+        d->checkLayoutSharing();
+    }
+    QListView::doItemsLayout();
+}
+
 void KCategorizedView::paintEvent(QPaintEvent *event)
 {
     if (!d->isCategorized()) {
@@ -780,69 +2050,51 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
         return;
     }
 
-    const std::pair<QModelIndex, QModelIndex> intersecting = d->intersectingIndexesWithRect(viewport()->rect().intersected(event->rect()));
+    d->applyPendingChanges();
+
+    d->updateEngineVisibleRect();
+    const QList<KCategorizedLayoutEngine::RowSpan> intersecting = d->intersectingRows(viewport()->rect().intersected(event->rect()));
 
     QPainter p(viewport());
     p.save();
 
-    Q_ASSERT(selectionModel()->model() == d->proxyModel);
+    // with fast scroll painting, items that do not fit in half a frame are painted as skeletons,
+    // and painted again with full quality right after. At least one item is always painted with
+    // full quality, so that this converges.
+    QElapsedTimer paintClock;
+    paintClock.start();
+    const int paintBudget = d->fastScrollPainting ? d->frameInterval() / 2 : -1;
+    bool paintedItem = false;
+    QRegion deferred;
 
-    // BEGIN: draw categories
-    auto it = d->blocks.constBegin();
-    while (it != d->blocks.constEnd()) {
-        const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
+    Q_ASSERT(selectionModel()->model() == d->model);
 
-        QStyleOptionViewItem option = d->viewOpts();
-        option.features |= d->alternatingBlockColors && block.alternate //
+    // BEGIN: draw categories
+    const int sortRole = d->proxyModel ? d->proxyModel->sortRole() : int(Qt::DisplayRole);
+    for (int block = 0; block < d->layout->engine.blockCount(); ++block) {
+        QStyleOptionViewItem option = d->blockRect(block);
+        if (!option.rect.intersects(viewport()->rect())) {
+            continue;
+        }
+        option.features |= d->alternatingBlockColors && block % 2 //
             ? QStyleOptionViewItem::Alternate
             : QStyleOptionViewItem::None;
-        option.state |= !d->collapsibleBlocks || !block.collapsed //
+        option.state |= !d->collapsibleBlocks || !d->layout->engine.isBlockCollapsed(block) //
             ? QStyle::State_Open
             : QStyle::State_None;
-        const int height = d->categoryDrawer->categoryHeight(categoryIndex, option);
-        QPoint pos = d->blockPosition(it.key());
-        pos.ry() -= height;
-        option.rect.setTopLeft(pos);
-        option.rect.setWidth(d->viewportWidth() + d->categoryDrawer->leftMargin() + d->categoryDrawer->rightMargin());
-        option.rect.setHeight(height + d->blockHeight(it.key()));
-        option.rect = d->mapToViewport(option.rect);
-        if (!option.rect.intersects(viewport()->rect())) {
-            ++it;
-            continue;
-        }
-        d->categoryDrawer->drawCategory(categoryIndex, d->proxyModel->sortRole(), option, &p);
-        ++it;
+        d->categoryDrawer->drawCategory(d->categoryIndex(block), sortRole, option, &p);
     }
     // END: draw categories
 
-    if (intersecting.first.isValid() && intersecting.second.isValid()) {
-        // BEGIN: draw items
-        int i = intersecting.first.row();
-        int indexToCheckIfBlockCollapsed = i;
-        QModelIndex categoryIndex;
-        QString category;
-        KCategorizedViewPrivate::Block *block = nullptr;
-        while (i <= intersecting.second.row()) {
-            // BEGIN: first check if the block is collapsed. if so, we have to skip the item painting
-            if (i == indexToCheckIfBlockCollapsed) {
-                categoryIndex = d->proxyModel->index(i, d->proxyModel->sortColumn(), rootIndex());
-                category = categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
-                block = &d->blocks[category];
-                indexToCheckIfBlockCollapsed = block->firstIndex.row() + block->items.count();
-                if (block->collapsed) {
-                    i = indexToCheckIfBlockCollapsed;
-                    continue;
-                }
-            }
-            // END: first check if the block is collapsed. if so, we have to skip the item painting
-
-            Q_ASSERT(block);
-
-            const bool alternateItem = (i - block->firstIndex.row()) % 2;
+    // BEGIN: draw items
+    // only the items that intersect the painted rect, skipping collapsed blocks
+    for (const KCategorizedLayoutEngine::RowSpan &span : intersecting) {
+        const int firstRow = d->layout->engine.blockFirstRow(span.block);
+        for (int i = span.first; i <= span.last; ++i) {
+            const bool alternateItem = (i - firstRow) % 2;
 
-            const QModelIndex index = d->proxyModel->index(i, modelColumn(), rootIndex());
-            const Qt::ItemFlags flags = d->proxyModel->flags(index);
+            const QModelIndex index = d->model->index(i, modelColumn(), rootIndex());
+            const Qt::ItemFlags flags = d->model->flags(index);
             QStyleOptionViewItem option(d->viewOpts());
             option.rect = visualRect(index);
             option.widget = this;
@@ -860,10 +2112,31 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
                 option.state |= (index == d->hoveredIndex) ? QStyle::State_MouseOver : QStyle::State_None;
             }
 
-            itemDelegateForIndex(index)->paint(&p, option, index);
-            ++i;
+            if (d->fastScrolling || (paintBudget >= 0 && paintedItem && paintClock.elapsed() > paintBudget)) {
+                if (option.font != d->elidedTextFont) {
+                    d->elidedTextFont = option.font;
+                    d->elidedTextCache.clear();
+                }
+                d->paintSkeleton(&p, option, index);
+                if (!d->fastScrolling) {
+                    deferred += option.rect;
+                }
+            } else {
+                if (d->decorationProvider) {
+                    d->initDecorationOption(&option, index);
+                }
+                itemDelegateForIndex(index)->paint(&p, option, index);
+                paintedItem = true;
+            }
         }
-        // END: draw items
+    }
+    // END: draw items
+
+    if (!deferred.isEmpty()) {
+        d->deferredRegion += deferred;
+        QTimer::singleShot(0, this, [this]() {
+            viewport()->update(std::exchange(d->deferredRegion, QRegion()));
+        });
     }
 
     // BEGIN: draw selection rect
@@ -882,10 +2155,59 @@ void KCategorizedView::paintEvent(QPaintEvent *event)
     p.restore();
 }
 
+void KCategorizedView::showEvent(QShowEvent *event)
+{
+    QListView::showEvent(event);
+
+    if (!d->isCategorized()) {
+        return;
+    }
+
+    d->updateEngineVisibleRect();
+
+    // catch up with all the changes we ignored while being hidden in a single pass
+    if (d->hasPendingChanges()) {
+        d->applyPendingChanges();
+        updateGeometries();
+    }
+}
+
 void KCategorizedView::resizeEvent(QResizeEvent *event)
 {
-    d->regenerateAllElements();
+    // items keep their size, only where they are changes
+    d->updateLayoutParams();
     QListView::resizeEvent(event);
+    if (d->isCategorized()) {
+        d->updateEngineVisibleRect();
+    }
+}
+
+void KCategorizedView::changeEvent(QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::FontChange:
+    case QEvent::StyleChange:
+        d->regenerateAllElements();
+        break;
+    case QEvent::LayoutDirectionChange:
+        d->updateLayoutParams();
+        break;
+    default:
+        break;
+    }
+
+    QListView::changeEvent(event);
+}
+
+void KCategorizedView::scrollContentsBy(int dx, int dy)
+{
+    QListView::scrollContentsBy(dx, dy);
+    if (d->isCategorized()) {
+        d->deferredRegion.translate(dx, dy);
+        d->updateEngineVisibleRect();
+        d->trackScrollVelocity();
+        d->scheduleVisibleRangeUpdate();
+    }
 }
 
 void KCategorizedView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags flags)
@@ -901,40 +2223,61 @@ void KCategorizedView::setSelection(const QRect &rect, QItemSelectionModel::Sele
         return;
     }
 
-    const std::pair<QModelIndex, QModelIndex> intersecting = d->intersectingIndexesWithRect(rect);
-
+    // items of a span are consecutive rows, so each span is a single selection range
     QItemSelection selection;
-
-    // TODO: think of a faster implementation
-    QModelIndex firstIndex;
-    QModelIndex lastIndex;
-    for (int i = intersecting.first.row(); i <= intersecting.second.row(); ++i) {
-        const QModelIndex index = d->proxyModel->index(i, modelColumn(), rootIndex());
-        const bool visualRectIntersects = visualRect(index).intersects(rect);
-        if (firstIndex.isValid()) {
-            if (visualRectIntersects) {
-                lastIndex = index;
-            } else {
-                selection << QItemSelectionRange(firstIndex, lastIndex);
-                firstIndex = QModelIndex();
-            }
-        } else if (visualRectIntersects) {
-            firstIndex = index;
-            lastIndex = index;
-        }
+    const QList<KCategorizedLayoutEngine::RowSpan> intersecting = d->intersectingRows(rect);
+    for (const KCategorizedLayoutEngine::RowSpan &span : intersecting) {
+        selection << QItemSelectionRange(d->model->index(span.first, modelColumn(), rootIndex()),
+                                         d->model->index(span.last, modelColumn(), rootIndex()));
     }
 
-    if (firstIndex.isValid()) {
-        selection << QItemSelectionRange(firstIndex, lastIndex);
+    selectionModel()->select(selection, flags);
+}
+
+QRegion KCategorizedView::visualRegionForSelection(const QItemSelection &selection) const
+{
+    if (!d->isCategorized()) {
+        return QListView::visualRegionForSelection(selection);
     }
 
-    selectionModel()->select(selection, flags);
+    d->applyPendingChanges();
+
+    // one rect per block a range spans, instead of one per index, and evicted blocks are not laid
+    // out again just to be repainted
+    KCategorizedLayoutEngine &engine = d->layout->engine;
+    const QRect viewportRect = viewport()->rect();
+    QRegion region;
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid() || range.parent() != rootIndex() || range.left() > modelColumn() || range.right() < modelColumn()) {
+            continue;
+        }
+        const int bottom = qMin(range.bottom(), engine.rowCount() - 1);
+        for (int row = range.top(); row <= bottom;) {
+            const int block = engine.blockForRow(row);
+            if (block == -1) {
+                break;
+            }
+            const int last = qMin(bottom, engine.blockFirstRow(block) + engine.blockRowCount(block) - 1);
+            const QRect rect = d->mapToViewport(engine.rowsRect(row, last)) & viewportRect;
+            if (!rect.isEmpty()) {
+                region += rect;
+            }
+            row = last + 1;
+        }
+    }
+    return region;
 }
 
 void KCategorizedView::mouseMoveEvent(QMouseEvent *event)
 {
     QListView::mouseMoveEvent(event);
-    d->hoveredIndex = indexAt(event->pos());
+    const QModelIndex hoveredIndex = indexAt(event->pos());
+    if (hoveredIndex != d->hoveredIndex) {
+        // only the items that were and are now hovered look different
+        viewport()->update(visualRect(d->hoveredIndex));
+        viewport()->update(visualRect(hoveredIndex));
+        d->hoveredIndex = hoveredIndex;
+    }
     const SelectionMode itemViewSelectionMode = selectionMode();
     if (state() == DragSelectingState //
         && isSelectionRectVisible() //
@@ -948,45 +2291,28 @@ void KCategorizedView::mouseMoveEvent(QMouseEvent *event)
     if (!d->categoryDrawer) {
         return;
     }
-    auto it = d->blocks.constBegin();
-    while (it != d->blocks.constEnd()) {
-        const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-        QStyleOptionViewItem option(d->viewOpts());
-        const int height = d->categoryDrawer->categoryHeight(categoryIndex, option);
-        QPoint pos = d->blockPosition(it.key());
-        pos.ry() -= height;
-        option.rect.setTopLeft(pos);
-        option.rect.setWidth(d->viewportWidth() + d->categoryDrawer->leftMargin() + d->categoryDrawer->rightMargin());
-        option.rect.setHeight(height + d->blockHeight(it.key()));
-        option.rect = d->mapToViewport(option.rect);
-        const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
+    const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
+    for (int block = 0; block < d->layout->engine.blockCount(); ++block) {
+        const QStyleOptionViewItem option = d->blockRect(block);
         if (option.rect.contains(mousePos)) {
-            if (d->hoveredBlock->height != -1 && *d->hoveredBlock != block) {
-                const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-                const QStyleOptionViewItem option = d->blockRect(categoryIndex);
-                d->categoryDrawer->mouseLeft(categoryIndex, option.rect);
-                *d->hoveredBlock = block;
-                d->hoveredCategory = it.key();
-                viewport()->update(option.rect);
-            } else if (d->hoveredBlock->height == -1) {
-                *d->hoveredBlock = block;
-                d->hoveredCategory = it.key();
+            if (d->hoveredBlock != -1 && d->hoveredBlock != block) {
+                d->categoryDrawer->mouseLeft(d->categoryIndex(d->hoveredBlock), d->blockRect(d->hoveredBlock).rect);
+                viewport()->update(d->categoryHeaderRect(d->hoveredBlock));
+                d->hoveredBlock = block;
+            } else if (d->hoveredBlock == -1) {
+                d->hoveredBlock = block;
             } else {
-                d->categoryDrawer->mouseMoved(categoryIndex, option.rect, event);
+                d->categoryDrawer->mouseMoved(d->categoryIndex(block), option.rect, event);
             }
-            viewport()->update(option.rect);
+            // hovering only changes how the header is drawn, not the whole block
+            viewport()->update(d->categoryHeaderRect(block));
             return;
         }
-        ++it;
     }
-    if (d->hoveredBlock->height != -1) {
-        const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-        const QStyleOptionViewItem option = d->blockRect(categoryIndex);
-        d->categoryDrawer->mouseLeft(categoryIndex, option.rect);
-        *d->hoveredBlock = KCategorizedViewPrivate::Block();
-        d->hoveredCategory = QString();
-        viewport()->update(option.rect);
+    if (d->hoveredBlock != -1) {
+        d->categoryDrawer->mouseLeft(d->categoryIndex(d->hoveredBlock), d->blockRect(d->hoveredBlock).rect);
+        viewport()->update(d->categoryHeaderRect(d->hoveredBlock));
+        d->hoveredBlock = -1;
     }
 }
 
@@ -1001,21 +2327,17 @@ void KCategorizedView::mousePressEvent(QMouseEvent *event)
         QListView::mousePressEvent(event);
         return;
     }
-    auto it = d->blocks.constBegin();
-    while (it != d->blocks.constEnd()) {
-        const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-        const QStyleOptionViewItem option = d->blockRect(categoryIndex);
-        const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
+    const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
+    for (int block = 0; block < d->layout->engine.blockCount(); ++block) {
+        const QStyleOptionViewItem option = d->blockRect(block);
         if (option.rect.contains(mousePos)) {
-            d->categoryDrawer->mouseButtonPressed(categoryIndex, option.rect, event);
+            d->categoryDrawer->mouseButtonPressed(d->categoryIndex(block), option.rect, event);
             viewport()->update(option.rect);
             if (!event->isAccepted()) {
                 QListView::mousePressEvent(event);
             }
             return;
         }
-        ++it;
     }
     QListView::mousePressEvent(event);
 }
@@ -1028,21 +2350,17 @@ void KCategorizedView::mouseReleaseEvent(QMouseEvent *event)
         QListView::mouseReleaseEvent(event);
         return;
     }
-    auto it = d->blocks.constBegin();
-    while (it != d->blocks.constEnd()) {
-        const KCategorizedViewPrivate::Block &block = *it;
-        const QModelIndex categoryIndex = d->proxyModel->index(block.firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-        const QStyleOptionViewItem option = d->blockRect(categoryIndex);
-        const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
+    const QPoint mousePos = viewport()->mapFromGlobal(QCursor::pos());
+    for (int block = 0; block < d->layout->engine.blockCount(); ++block) {
+        const QStyleOptionViewItem option = d->blockRect(block);
         if (option.rect.contains(mousePos)) {
-            d->categoryDrawer->mouseButtonReleased(categoryIndex, option.rect, event);
+            d->categoryDrawer->mouseButtonReleased(d->categoryIndex(block), option.rect, event);
             viewport()->update(option.rect);
             if (!event->isAccepted()) {
                 QListView::mouseReleaseEvent(event);
             }
             return;
         }
-        ++it;
     }
     QListView::mouseReleaseEvent(event);
 }
@@ -1054,13 +2372,10 @@ void KCategorizedView::leaveEvent(QEvent *event)
         viewport()->update(visualRect(d->hoveredIndex));
         d->hoveredIndex = QModelIndex();
     }
-    if (d->categoryDrawer && d->hoveredBlock->height != -1) {
-        const QModelIndex categoryIndex = d->proxyModel->index(d->hoveredBlock->firstIndex.row(), d->proxyModel->sortColumn(), rootIndex());
-        const QStyleOptionViewItem option = d->blockRect(categoryIndex);
-        d->categoryDrawer->mouseLeft(categoryIndex, option.rect);
-        *d->hoveredBlock = KCategorizedViewPrivate::Block();
-        d->hoveredCategory = QString();
-        viewport()->update(option.rect);
+    if (d->categoryDrawer && d->hoveredBlock != -1) {
+        d->categoryDrawer->mouseLeft(d->categoryIndex(d->hoveredBlock), d->blockRect(d->hoveredBlock).rect);
+        viewport()->update(d->categoryHeaderRect(d->hoveredBlock));
+        d->hoveredBlock = -1;
     }
 }
 
@@ -1090,237 +2405,159 @@ void KCategorizedView::dropEvent(QDropEvent *event)
     QListView::dropEvent(event);
 }
 
-// TODO: improve se we take into account collapsed blocks
-// TODO: take into account when there is no grid and no uniformItemSizes
 QModelIndex KCategorizedView::moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers modifiers)
 {
-    if (!d->isCategorized() || viewMode() == QListView::ListMode) {
+    if (!d->isCategorized()) {
         return QListView::moveCursor(cursorAction, modifiers);
     }
 
-    const QModelIndex current = currentIndex();
-    const QRect currentRect = visualRect(current);
-    if (!current.isValid()) {
-        const int rowCount = d->proxyModel->rowCount(rootIndex());
-        if (!rowCount) {
-            return QModelIndex();
-        }
-        return d->proxyModel->index(0, modelColumn(), rootIndex());
-    }
-
-    switch (cursorAction) {
-    case MoveLeft: {
-        if (!current.row()) {
-            return QModelIndex();
-        }
-        const QModelIndex previous = d->proxyModel->index(current.row() - 1, modelColumn(), rootIndex());
-        const QRect previousRect = visualRect(previous);
-        if (previousRect.top() == currentRect.top()) {
-            return previous;
-        }
+    d->applyPendingChanges();
+    KCategorizedLayoutEngine &engine = d->layout->engine;
+    const auto indexForRow = [this](int row) {
+        return row == -1 ? QModelIndex() : d->model->index(row, modelColumn(), rootIndex());
+    };
 
+    // first and last items that are shown, neither hidden, capped nor in a collapsed block
+    const int firstRow = engine.shownRow(0, true);
+    const int lastRow = engine.shownRow(engine.rowCount() - 1, false);
+    if (firstRow == -1) {
         return QModelIndex();
     }
-    case MoveRight: {
-        if (current.row() == d->proxyModel->rowCount() - 1) {
-            return QModelIndex();
-        }
-        const QModelIndex next = d->proxyModel->index(current.row() + 1, modelColumn(), rootIndex());
-        const QRect nextRect = visualRect(next);
-        if (nextRect.top() == currentRect.top()) {
-            return next;
-        }
 
-        return QModelIndex();
+    const QModelIndex current = currentIndex();
+    const int block = current.isValid() ? engine.blockForRow(current.row()) : -1;
+    if (block == -1 || engine.isRowHidden(current.row()) || engine.isRowCapped(current.row())) {
+        return indexForRow(firstRow);
     }
-    case MoveDown: {
-        if (d->hasGrid() || uniformItemSizes()) {
-            const QModelIndex current = currentIndex();
-            const QSize itemSize = d->hasGrid() ? gridSize() : sizeHintForIndex(current);
-            const KCategorizedViewPrivate::Block &block = d->blocks[d->categoryForIndex(current)];
-            const int maxItemsPerRow = qMax(d->viewportWidth() / itemSize.width(), 1);
-            const bool canMove = current.row() + maxItemsPerRow < block.firstIndex.row() + block.items.count();
-
-            if (canMove) {
-                return d->proxyModel->index(current.row() + maxItemsPerRow, modelColumn(), rootIndex());
-            }
-
-            const int currentRelativePos = (current.row() - block.firstIndex.row()) % maxItemsPerRow;
-            const QModelIndex nextIndex = d->proxyModel->index(block.firstIndex.row() + block.items.count(), modelColumn(), rootIndex());
-
-            if (!nextIndex.isValid()) {
-                return QModelIndex();
-            }
-
-            const KCategorizedViewPrivate::Block &nextBlock = d->blocks[d->categoryForIndex(nextIndex)];
 
-            if (nextBlock.items.count() <= currentRelativePos) {
-                return QModelIndex();
-            }
+    // lines of items are looked for from the middle of the current item, in layout terms
+    const QRect currentRect = engine.itemRect(current.row());
+    const int x = currentRect.center().x();
+    const int top = currentRect.top();
+    const int pageHeight = qMax(viewport()->height(), 1);
 
-            if (currentRelativePos < (block.items.count() % maxItemsPerRow)) {
-                return d->proxyModel->index(nextBlock.firstIndex.row() + currentRelativePos, modelColumn(), rootIndex());
-            }
+    switch (cursorAction) {
+    case MoveLeft:
+    case MoveRight: {
+        // the shown item next to the current one in row order, if it is in the same line
+        const bool towardsNext = (cursorAction == MoveRight) != isRightToLeft();
+        const int row = engine.shownRow(current.row() + (towardsNext ? 1 : -1), towardsNext);
+        if (row == -1 || engine.blockForRow(row) != block) {
+            return QModelIndex();
         }
-        return QModelIndex();
+        return engine.itemRect(row).top() == top ? indexForRow(row) : QModelIndex();
+    }
+    case MoveNext:
+    case MovePrevious: {
+        // the next shown item in row order
+        const bool next = cursorAction == MoveNext;
+        return indexForRow(engine.shownRow(current.row() + (next ? 1 : -1), next));
+    }
+    case MoveDown:
+        return indexForRow(engine.rowBelow(x, top));
+    case MoveUp:
+        return indexForRow(engine.rowAbove(x, top));
+    case MovePageDown: {
+        // the last line that starts at most a page below, and at least the next line
+        const int row = engine.rowAbove(x, top + pageHeight + 1);
+        if (row != -1 && engine.itemRect(row).top() > top) {
+            return indexForRow(row);
+        }
+        const int below = engine.rowBelow(x, top);
+        return below == -1 ? indexForRow(lastRow) : indexForRow(below);
     }
-    case MoveUp: {
-        if (d->hasGrid() || uniformItemSizes()) {
-            const QModelIndex current = currentIndex();
-            const QSize itemSize = d->hasGrid() ? gridSize() : sizeHintForIndex(current);
-            const KCategorizedViewPrivate::Block &block = d->blocks[d->categoryForIndex(current)];
-            const int maxItemsPerRow = qMax(d->viewportWidth() / itemSize.width(), 1);
-            const bool canMove = current.row() - maxItemsPerRow >= block.firstIndex.row();
-
-            if (canMove) {
-                return d->proxyModel->index(current.row() - maxItemsPerRow, modelColumn(), rootIndex());
-            }
-
-            const int currentRelativePos = (current.row() - block.firstIndex.row()) % maxItemsPerRow;
-            const QModelIndex prevIndex = d->proxyModel->index(block.firstIndex.row() - 1, modelColumn(), rootIndex());
-
-            if (!prevIndex.isValid()) {
-                return QModelIndex();
-            }
-
-            const KCategorizedViewPrivate::Block &prevBlock = d->blocks[d->categoryForIndex(prevIndex)];
-
-            if (prevBlock.items.count() <= currentRelativePos) {
-                return QModelIndex();
-            }
-
-            const int remainder = prevBlock.items.count() % maxItemsPerRow;
-            if (currentRelativePos < remainder) {
-                return d->proxyModel->index(prevBlock.firstIndex.row() + prevBlock.items.count() - remainder + currentRelativePos, modelColumn(), rootIndex());
-            }
-
-            return QModelIndex();
+    case MovePageUp: {
+        const int row = engine.rowBelow(x, top - pageHeight - 1);
+        if (row != -1 && engine.itemRect(row).top() < top) {
+            return indexForRow(row);
         }
-        break;
+        const int above = engine.rowAbove(x, top);
+        return above == -1 ? indexForRow(firstRow) : indexForRow(above);
     }
-    default:
-        break;
+    case MoveHome:
+        return indexForRow(firstRow);
+    case MoveEnd:
+        return indexForRow(lastRow);
     }
 
     return QModelIndex();
 }
 
-void KCategorizedView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+void KCategorizedView::keyboardSearch(const QString &search)
 {
     if (!d->isCategorized()) {
-        QListView::rowsAboutToBeRemoved(parent, start, end);
+        QListView::keyboardSearch(search);
         return;
     }
 
-    *d->hoveredBlock = KCategorizedViewPrivate::Block();
-    d->hoveredCategory = QString();
-
-    if (end - start + 1 == d->proxyModel->rowCount()) {
-        d->blocks.clear();
-        QListView::rowsAboutToBeRemoved(parent, start, end);
+    const int rowCount = d->model->rowCount(rootIndex());
+    if (!rowCount) {
         return;
     }
 
-    // Removal feels a bit more complicated than insertion. Basically we can consider there are
-    // 3 different cases when going to remove items. (*) represents an item, Items between ([) and
-    // (]) are the ones which are marked for removal.
-    //
-    // - 1st case:
-    //              ... * * * * * * [ * * * ...
-    //
-    //   The items marked for removal are the last part of this category. No need to mark any item
-    //   of this category as in quarantine, because no special offset will be pushed to items at
-    //   the right because of any changes (since the removed items are those on the right most part
-    //   of the category).
-    //
-    // - 2nd case:
-    //              ... * * * * * * ] * * * ...
-    //
-    //   The items marked for removal are the first part of this category. We have to mark as in
-    //   quarantine all items in this category. Absolutely all. All items will have to be moved to
-    //   the left (or moving up, because rows got a different offset).
-    //
-    // - 3rd case:
-    //              ... * * [ * * * * ] * * ...
-    //
-    //   The items marked for removal are in between of this category. We have to mark as in
-    //   quarantine only those items that are at the right of the end of the removal interval,
-    //   (starting on "]").
-    //
-    // It hasn't been explicitly said, but when we remove, we have to mark all blocks that are
-    // located under the top most affected category as in quarantine (the block itself, as a whole),
-    // because such a change can force it to have a different offset (note that items themselves
-    // contain relative positions to the block, so marking the block as in quarantine is enough).
-    //
-    // Also note that removal implicitly means that we have to update correctly firstIndex of each
-    // block, and in general keep updated the internal information of elements.
-
-    QStringList listOfCategoriesMarkedForRemoval;
-
-    QString lastCategory;
-    int alreadyRemoved = 0;
-    for (int i = start; i <= end; ++i) {
-        const QModelIndex index = d->proxyModel->index(i, modelColumn(), parent);
-
-        Q_ASSERT(index.isValid());
-
-        const QString category = d->categoryForIndex(index);
-
-        if (lastCategory != category) {
-            lastCategory = category;
-            alreadyRemoved = 0;
-        }
-
-        KCategorizedViewPrivate::Block &block = d->blocks[category];
-        block.items.removeAt(i - block.firstIndex.row() - alreadyRemoved);
-        ++alreadyRemoved;
+    // BEGIN: what was typed, with the same rules as QAbstractItemView::keyboardSearch()
+    const QModelIndex current = currentIndex();
+    bool skipRow = false;
+    const bool keyboardTimeWasValid = d->keyboardInputTime.isValid();
+    const qint64 keyboardInputTimeElapsed = keyboardTimeWasValid ? d->keyboardInputTime.restart() : 0;
+    if (!keyboardTimeWasValid) {
+        d->keyboardInputTime.start();
+    }
+    if (search.isEmpty() || !keyboardTimeWasValid || keyboardInputTimeElapsed > QApplication::keyboardInputInterval()) {
+        d->keyboardInput = search;
+        skipRow = current.isValid();
+    } else {
+        d->keyboardInput += search;
+    }
 
-        if (block.items.isEmpty()) {
-            listOfCategoriesMarkedForRemoval << category;
-        }
+    // typing the same key over and over again, like "aaa", goes through the items starting with it
+    const QString &input = d->keyboardInput;
+    const bool sameKey = input.size() > 1 && input.count(input.back()) == input.size();
+    if (sameKey) {
+        skipRow = true;
+    }
+    // END: what was typed, with the same rules as QAbstractItemView::keyboardSearch()
 
-        block.height = -1;
+    int first = 0;
+    int end = rowCount;
+    const int block = current.isValid() ? d->layout->engine.blockForRow(current.row()) : -1;
+    if (d->keyboardSearchInBlock && block != -1) {
+        first = d->layout->engine.blockFirstRow(block);
+        end = first + d->layout->engine.blockRowCount(block);
+    }
 
-        viewport()->update();
+    int start = current.isValid() ? current.row() : first;
+    if (skipRow) {
+        start = start + 1 < end ? start + 1 : first;
     }
 
-    // BEGIN: update the items that are in quarantine in affected categories
-    {
-        const QModelIndex lastIndex = d->proxyModel->index(end, modelColumn(), parent);
-        const QString category = d->categoryForIndex(lastIndex);
-        KCategorizedViewPrivate::Block &block = d->blocks[category];
-        if (!block.items.isEmpty() && start <= block.firstIndex.row() && end >= block.firstIndex.row()) {
-            block.firstIndex = d->proxyModel->index(end + 1, modelColumn(), parent);
-        }
-        block.quarantineStart = block.firstIndex;
+    const int row = d->findSearchMatch(sameKey ? QString(input.front()) : input, start, first, end);
+    if (row != -1) {
+        setCurrentIndex(d->model->index(row, modelColumn(), rootIndex()));
     }
-    // END: update the items that are in quarantine in affected categories
+}
 
-    for (const QString &category : std::as_const(listOfCategoriesMarkedForRemoval)) {
-        d->blocks.remove(category);
+void KCategorizedView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+    d->invalidateSearchIndex();
+    if (!d->isCategorized() || parent != rootIndex()) {
+        QListView::rowsAboutToBeRemoved(parent, start, end);
+        return;
     }
 
-    // BEGIN: mark as in quarantine those categories that are under the affected ones
-    {
-        // BEGIN: order for marking as alternate those blocks that are alternate
-        QList<KCategorizedViewPrivate::Block> blockList = d->blocks.values();
-        std::sort(blockList.begin(), blockList.end(), KCategorizedViewPrivate::Block::lessThan);
-        QList<int> firstIndexesRows;
-        for (const KCategorizedViewPrivate::Block &block : std::as_const(blockList)) {
-            firstIndexesRows << block.firstIndex.row();
-        }
-        // END: order for marking as alternate those blocks that are alternate
-        for (auto it = d->blocks.begin(); it != d->blocks.end(); ++it) {
-            KCategorizedViewPrivate::Block &block = *it;
-            if (block.firstIndex.row() > start) {
-                block.outOfQuarantine = false;
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            } else if (block.firstIndex.row() == start) {
-                block.alternate = firstIndexesRows.indexOf(block.firstIndex.row()) % 2;
-            }
-        }
+    d->hoveredBlock = -1;
+
+    // removing all rows, or a big part of them, is handled by rebuilding the blocks afterwards
+    const int rowCount = d->model->rowCount(rootIndex());
+    if (!d->recordStructuralChange(start, -(end - start + 1), rowCount - (end - start + 1))) {
+        QListView::rowsAboutToBeRemoved(parent, start, end);
+        return;
     }
-    // END: mark as in quarantine those categories that are under the affected ones
+
+    // Removed rows can be the last part of their category, the first part or somewhere in between.
+    // Only the items after them in the same block move, and the blocks under it move as a whole,
+    // which the layout engine takes care of.
+    d->layout->engine.removeRows(start, end - start + 1);
 
     QListView::rowsAboutToBeRemoved(parent, start, end);
 }
@@ -1359,7 +2596,16 @@ void KCategorizedView::updateGeometries()
         return;
     }
 
-    const int rowCount = d->proxyModel->rowCount();
+    if (!isVisible()) {
+        // the scroll bars will be updated once we are shown again, see showEvent()
+        setVerticalScrollBarPolicy(verticalP);
+        setHorizontalScrollBarPolicy(horizontalP);
+        return;
+    }
+
+    d->applyPendingChanges();
+
+    const int rowCount = d->model->rowCount();
     if (!rowCount) {
         verticalScrollBar()->setRange(0, 0);
         // unconditional, see function end todo
@@ -1372,7 +2618,7 @@ void KCategorizedView::updateGeometries()
         return;
     }
 
-    const QModelIndex lastIndex = d->proxyModel->index(rowCount - 1, modelColumn(), rootIndex());
+    const QModelIndex lastIndex = d->model->index(rowCount - 1, modelColumn(), rootIndex());
     Q_ASSERT(lastIndex.isValid());
     QRect lastItemRect = visualRect(lastIndex);
 
@@ -1380,13 +2626,15 @@ void KCategorizedView::updateGeometries()
         lastItemRect.setSize(lastItemRect.size().expandedTo(gridSize()));
     } else {
         if (uniformItemSizes()) {
-            QSize itemSize = sizeHintForIndex(lastIndex);
+            QSize itemSize = d->itemSizeHint(lastIndex);
             itemSize.setHeight(itemSize.height() + spacing());
             lastItemRect.setSize(itemSize);
         } else {
-            QSize itemSize = sizeHintForIndex(lastIndex);
-            const QString category = d->categoryForIndex(lastIndex);
-            itemSize.setHeight(d->highestElementInLastRow(d->blocks[category]) + spacing());
+            QSize itemSize = d->itemSizeHint(lastIndex);
+            const int block = d->layout->engine.blockForRow(lastIndex.row());
+            if (block != -1) {
+                itemSize.setHeight(d->layout->engine.lastRowHeight(block) + spacing());
+            }
             lastItemRect.setSize(itemSize);
         }
     }
@@ -1402,6 +2650,12 @@ void KCategorizedView::updateGeometries()
     verticalScrollBar()->setRange(0, bottomRange);
     verticalScrollBar()->setValue(oldVerticalOffset);
 
+    // the items might have been laid out again, or the viewport resized
+    d->scheduleVisibleRangeUpdate();
+    if (d->scrollBarMarkers) {
+        d->scrollBarMarkers->update();
+    }
+
     // TODO: also consider working with the horizontal scroll bar. since at this level I am not still
     //      supporting "top to bottom" flow, there is no real problem. If I support that someday
     //      (think how to draw categories), we would have to take care of the horizontal scroll bar too.
@@ -1431,59 +2685,72 @@ void KCategorizedView::currentChanged(const QModelIndex &current, const QModelIn
 
 void KCategorizedView::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
 {
-    QListView::dataChanged(topLeft, bottomRight, roles);
-    if (!d->isCategorized()) {
-        return;
+    if (roles.isEmpty() || roles.contains(Qt::DisplayRole)) {
+        d->invalidateSearchIndex();
     }
 
-    *d->hoveredBlock = KCategorizedViewPrivate::Block();
-    d->hoveredCategory = QString();
+    if (!d->isCategorized() || topLeft.parent() != rootIndex()) {
+        QListView::dataChanged(topLeft, bottomRight, roles);
+        return;
+    }
 
-    // BEGIN: since the model changed data, we need to reconsider item sizes
-    int i = topLeft.row();
-    int indexToCheck = i;
-    QModelIndex categoryIndex;
-    QString category;
-    KCategorizedViewPrivate::Block *block;
-    while (i <= bottomRight.row()) {
-        const QModelIndex currIndex = d->proxyModel->index(i, modelColumn(), rootIndex());
-        if (i == indexToCheck) {
-            categoryIndex = d->proxyModel->index(i, d->proxyModel->sortColumn(), rootIndex());
-            category = categoryIndex.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
-            block = &d->blocks[category];
-            block->quarantineStart = currIndex;
-            indexToCheck = block->firstIndex.row() + block->items.count();
+    if (d->isDormant()) {
+        QListView::dataChanged(topLeft, bottomRight, roles);
+        if (KItemDataChange::effectOf(roles) == KItemDataChange::Effect::Geometry) {
+            d->markRelayoutPending();
         }
-        visualRect(currIndex);
-        ++i;
+        return;
     }
-    // END: since the model changed data, we need to reconsider item sizes
+
+    // QListView::dataChanged() repaints the whole viewport when more than one item changed. We only
+    // let it run when it has something else to do: updating open editors, or notifying assistive
+    // technologies. Repainting is left to flushDataChanges(), which does it once per frame.
+    bool forwardToBase = state() == EditingState || d->hasEditorInRange(topLeft, bottomRight);
+#if QT_CONFIG(accessibility)
+    forwardToBase = forwardToBase || QAccessible::isActive();
+#endif
+    if (forwardToBase) {
+        QListView::dataChanged(topLeft, bottomRight, roles);
+    }
+
+    d->recordDataChange(topLeft.row(), bottomRight.row(), roles);
 }
 
 void KCategorizedView::rowsInserted(const QModelIndex &parent, int start, int end)
 {
     QListView::rowsInserted(parent, start, end);
-    if (!d->isCategorized()) {
+    d->invalidateSearchIndex();
+    if (!d->isCategorized() || parent != rootIndex()) {
+        return;
+    }
+
+    d->hoveredBlock = -1;
+
+    if (!d->recordStructuralChange(start, end - start + 1, d->model->rowCount(rootIndex()))) {
         return;
     }
 
-    *d->hoveredBlock = KCategorizedViewPrivate::Block();
-    d->hoveredCategory = QString();
     d->rowsInserted(parent, start, end);
 }
 
 void KCategorizedView::slotLayoutChanged()
 {
+    d->invalidateSearchIndex();
     if (!d->isCategorized()) {
         return;
     }
 
-    d->blocks.clear();
-    *d->hoveredBlock = KCategorizedViewPrivate::Block();
-    d->hoveredCategory = QString();
-    if (d->proxyModel->rowCount()) {
-        d->rowsInserted(rootIndex(), 0, d->proxyModel->rowCount() - 1);
+    // the leader rebuilds the blocks for all views sharing the layout
+    if (!d->isLayoutLeader()) {
+        return;
+    }
+
+    if (!d->isLayoutVisible()) {
+        d->markRelayoutPending();
+        return;
     }
+
+    d->rebuildBlocks();
 }
 
 // END: Public part
@@ -13,6 +13,7 @@
 
 #include <kitemviews_export.h>
 
+class KAsyncDecorationProvider;
 class KCategoryDrawer;
 
 /*!
@@ -27,6 +28,7 @@ class KCategoryDrawer;
  * For it to work you will need to set a KCategorizedSortFilterProxyModel and a KCategoryDrawer
  * with methods setModel() and setCategoryDrawer() respectively. Also, the model will need to be
  * flagged as categorized with KCategorizedSortFilterProxyModel::setCategorizedModel(true).
+ * Models that are already grouped by category can be set directly instead, see setGroupedModel().
  *
  * The way it works (if categorization enabled):
  * \list
@@ -60,7 +62,8 @@ class KCategoryDrawer;
  * \warning Note that for really drawing items in blocks you will need some things to be done:
  * \list
  * \li The model set to this view has to be (or inherit if you want to do special stuff
- *               in it) KCategorizedSortFilterProxyModel.
+ *               in it) KCategorizedSortFilterProxyModel, or be already grouped by category,
+ *               see setGroupedModel().
  * \li This model needs to be set setCategorizedModel to true.
  * \li Set a category drawer by calling setCategoryDrawer.
  * \endlist
@@ -86,6 +89,36 @@ class KITEMVIEWS_EXPORT KCategorizedView : public QListView
      */
     Q_PROPERTY(bool collapsibleBlocks READ collapsibleBlocks WRITE setCollapsibleBlocks NOTIFY collapsibleBlocksChanged)
 
+    /*!
+     * \property KCategorizedView::visibleRangeMargin
+     */
+    Q_PROPERTY(int visibleRangeMargin READ visibleRangeMargin WRITE setVisibleRangeMargin NOTIFY visibleRangeMarginChanged)
+
+    /*!
+     * \property KCategorizedView::fastScrollPainting
+     */
+    Q_PROPERTY(bool fastScrollPainting READ fastScrollPainting WRITE setFastScrollPainting NOTIFY fastScrollPaintingChanged)
+
+    /*!
+     * \property KCategorizedView::groupedModel
+     */
+    Q_PROPERTY(bool groupedModel READ groupedModel WRITE setGroupedModel NOTIFY groupedModelChanged)
+
+    /*!
+     * \property KCategorizedView::keyboardSearchInBlock
+     */
+    Q_PROPERTY(bool keyboardSearchInBlock READ keyboardSearchInBlock WRITE setKeyboardSearchInBlock NOTIFY keyboardSearchInBlockChanged)
+
+    /*!
+     * \property KCategorizedView::scrollBarCategoryMarkers
+     */
+    Q_PROPERTY(bool scrollBarCategoryMarkers READ scrollBarCategoryMarkers WRITE setScrollBarCategoryMarkers NOTIFY scrollBarCategoryMarkersChanged)
+
+    /*!
+     * \property KCategorizedView::categoryRowLimit
+     */
+    Q_PROPERTY(int categoryRowLimit READ categoryRowLimit WRITE setCategoryRowLimit NOTIFY categoryRowLimitChanged)
+
 public:
     /*!
      *
@@ -129,6 +162,26 @@ public:
      */
     void setGridSizeOwn(const QSize &size);
 
+    /*!
+     * Hides the item at \a row if \a hide is true, and shows it otherwise. Hidden items are not
+     * drawn, found, selected by selectBlock() nor navigated to with the keyboard, and the other
+     * items of their category are laid out as if they were not there. A category whose items are
+     * all hidden keeps its header.
+     *
+     * Hiding or showing rows lays out the categories they are in again once, when the view gets
+     * back to the event loop, however many rows changed.
+     *
+     * Complexity: O(1) amortized, the rows being laid out again later.
+     *
+     * \warning setRowHidden is not virtual in the base class (QListView) either, the same as
+     *          setGridSize(). Rows hidden through a QListView pointer are not taken into account.
+     *
+     * \note this method will call to QListView::setRowHidden among other operations.
+     *
+     * \since 6.28
+     */
+    void setRowHidden(int row, bool hide);
+
     QRect visualRect(const QModelIndex &index) const override;
 
     /*!
@@ -183,9 +236,320 @@ public:
      */
     void setCollapsibleBlocks(bool enable);
 
+    /*!
+     * Returns whether a model that is not a KCategorizedSortFilterProxyModel is taken as already
+     * grouped by category.
+     *
+     * \since 6.28
+     */
+    bool groupedModel() const;
+
+    /*!
+     * Sets whether a model that is not a KCategorizedSortFilterProxyModel is taken as already
+     * grouped by category. Disabled by default.
+     *
+     * When enabled, such a model is categorized as is: the category of each item is its
+     * KCategorizedSortFilterProxyModel::CategoryDisplayRole in modelColumn(), and rows of the
+     * same category have to be consecutive. Models that are sorted elsewhere, for instance by a
+     * server or a database, then do not need a proxy model, which would duplicate their mapping
+     * tables and sort them again. Rows of a category that are not consecutive are shown as blocks
+     * of their own.
+     *
+     * This has no effect on a KCategorizedSortFilterProxyModel, which is categorized when
+     * KCategorizedSortFilterProxyModel::isCategorizedModel() is true.
+     *
+     * \since 6.28
+     */
+    void setGroupedModel(bool enable);
+
+    /*!
+     * Returns whether keyboardSearch() only looks in the block of the current item.
+     *
+     * \since 6.28
+     */
+    bool keyboardSearchInBlock() const;
+
+    /*!
+     * Sets whether keyboardSearch() only looks in the block of the current item, wrapping around
+     * at its end, instead of in all items. Disabled by default.
+     *
+     * \since 6.28
+     */
+    void setKeyboardSearchInBlock(bool enable);
+
+    /*!
+     * Returns whether the vertical scroll bar shows where each category starts.
+     *
+     * \since 6.28
+     */
+    bool scrollBarCategoryMarkers() const;
+
+    /*!
+     * Sets whether the vertical scroll bar shows where each category starts, with a tick across
+     * its groove for every block but the first one. Disabled by default.
+     *
+     * \note the ticks are drawn over the scroll bar set when this is enabled. Enable it again
+     *       after replacing the scroll bar with setVerticalScrollBar().
+     *
+     * \since 6.28
+     */
+    void setScrollBarCategoryMarkers(bool enable);
+
+    /*!
+     * Returns how many items of each category are shown, 0 if all of them are.
+     *
+     * \since 6.28
+     */
+    int categoryRowLimit() const;
+
+    /*!
+     * Shows only the first \a limit items of each category, or all of them if \a limit is 0, the
+     * default. The other items are capped: they are not measured nor laid out, and like hidden
+     * items they are not drawn, found, selected by selectBlock() nor navigated to with the
+     * keyboard. KCategoryDrawer offers to show all items of a category whose items are capped in
+     * its header, see setShowAllRows().
+     *
+     * This keeps categories of tens of thousands of items as cheap as their first items until
+     * they are expanded. The model still sorts all of them.
+     *
+     * \since 6.28
+     */
+    void setCategoryRowLimit(int limit);
+
+    /*!
+     * Returns how many items of \a category are capped by categoryRowLimit(), 0 if all of them
+     * are shown.
+     *
+     * Complexity: O(1).
+     *
+     * \since 6.28
+     */
+    int cappedRowCount(const QString &category) const;
+
+    /*!
+     * Returns how many items of the block \a representative is in are capped by
+     * categoryRowLimit(), 0 if all of them are shown.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks.
+     *
+     * \since 6.28
+     */
+    int cappedRowCount(const QModelIndex &representative) const;
+
+    /*!
+     * Returns whether all items of \a category are shown whatever categoryRowLimit() is.
+     *
+     * \since 6.28
+     */
+    bool showsAllRows(const QString &category) const;
+
+    /*!
+     * Shows all items of \a category whatever categoryRowLimit() is if \a show is true, and only
+     * the first ones otherwise. This is remembered for the category until the model is reset,
+     * even while it has no items.
+     *
+     * \since 6.28
+     */
+    void setShowAllRows(const QString &category, bool show);
+
+    /*!
+     * Shows all items of the category \a representative is in whatever categoryRowLimit() is if
+     * \a show is true, and only the first ones otherwise.
+     *
+     * \since 6.28
+     */
+    void setShowAllRows(const QModelIndex &representative, bool show);
+
+    /*!
+     * Makes the next item whose display text starts with what was typed the current one, like
+     * QAbstractItemView::keyboardSearch() does.
+     *
+     * While the view is categorized, items are looked for in an index of their case folded
+     * display text, built the first time something is typed and whenever the rows or their
+     * display text changed since. Looking for an item then takes O(log(n) + k), where k is the
+     * number of items starting with what was typed, instead of asking the model for the data of
+     * every item until one matches.
+     *
+     * \sa setKeyboardSearchInBlock()
+     *
+     * \since 6.28
+     */
+    void keyboardSearch(const QString &search) override;
+
+    /*!
+     * Returns how many pixels above and below the viewport are taken into account when computing
+     * the range reported by visibleRangeChanged().
+     *
+     * \since 6.28
+     */
+    int visibleRangeMargin() const;
+
+    /*!
+     * Sets how many pixels above and below the viewport are taken into account when computing the
+     * range reported by visibleRangeChanged(). A margin lets models prepare items a bit before
+     * they get scrolled into view. 0 by default.
+     *
+     * \since 6.28
+     */
+    void setVisibleRangeMargin(int margin);
+
+    /*!
+     * Returns whether items are painted cheaply while scrolling fast.
+     *
+     * \since 6.28
+     */
+    bool fastScrollPainting() const;
+
+    /*!
+     * Sets whether items are painted cheaply while scrolling fast. When enabled, items scrolled
+     * into view faster than about a page every quarter of a second are painted as skeletons:
+     * their background, their cached decoration or a flat rect, and their elided text, without
+     * going through the delegate. Once scrolling settles, the viewport is painted again with full
+     * quality.
+     *
+     * Painting is also limited to half a frame: items that do not fit in that time are painted as
+     * skeletons first, and painted again with full quality right after. Disabled by default.
+     *
+     * \note skeletons only reserve space for the decoration when a decoration provider is set.
+     *
+     * \sa setDecorationProvider()
+     *
+     * \since 6.28
+     */
+    void setFastScrollPainting(bool enable);
+
+    /*!
+     * Returns the provider the decorations of the items are loaded with, if any.
+     *
+     * \since 6.28
+     */
+    KAsyncDecorationProvider *decorationProvider() const;
+
+    /*!
+     * Sets \a provider to load the decorations of the items asynchronously. While painting, the
+     * view passes the decoration of each item, or the placeholder of the provider while it is
+     * being loaded, to the delegate through QStyleOptionViewItem::icon. The space of the
+     * decoration is reserved in any case, so items do not move when their decoration arrives.
+     *
+     * Only the rect of an item is repainted when its decoration is ready, and requests for items
+     * leaving the range reported by visibleRangeChanged() are cancelled.
+     *
+     * Decorations are only provided while the view is categorized. The view does not take
+     * ownership of \a provider. Pass nullptr to stop using it.
+     *
+     * \since 6.28
+     */
+    void setDecorationProvider(KAsyncDecorationProvider *provider);
+
+    /*!
+     * Returns a snapshot of the layout of the items, to be given to restoreLayoutSnapshot() when
+     * the same model is shown again. Returns an empty array if the view is not categorized.
+     *
+     * The snapshot holds the blocks, the size of their items and the categories they show, in a
+     * compact binary format that can be read right from a memory mapped file, for instance with
+     * QFile::map() and QByteArray::fromRawData().
+     *
+     * \sa restoreLayoutSnapshot()
+     *
+     * \since 6.28
+     */
+    QByteArray saveLayoutSnapshot() const;
+
+    /*!
+     * Lays out the items as saved in \a snapshot by saveLayoutSnapshot(), without asking the
+     * model for the category or size of any of them, so that the scroll bars are right and a
+     * scroll position can be restored before the first paint.
+     *
+     * Only a snapshot of a model with the same row count, sorting and view settings is accepted.
+     * The categories of the blocks are then checked against the model a few blocks at a time in
+     * the background, and the items are laid out from scratch if one does not match. Sizes are
+     * trusted, the model has to report changes to the data that affects them through
+     * QAbstractItemModel::dataChanged() as usual.
+     *
+     * Returns whether the snapshot was restored. Call it once the model is populated.
+     *
+     * \since 6.28
+     */
+    bool restoreLayoutSnapshot(const QByteArray &snapshot);
+
+    /*!
+     * \brief How much memory the layout of the items takes, and how often it was evicted.
+     *
+     * \a bytes is what the position and size of the items, and the summaries of the evicted
+     * blocks, currently take. \a evictedBlocks is the number of blocks currently evicted.
+     * \a evictions and \a reloads count how many times a block was evicted, and laid out again
+     * after that.
+     *
+     * \sa setLayoutMemoryBudget()
+     *
+     * \since 6.28
+     */
+    struct LayoutCacheStatistics {
+        qsizetype bytes = 0;
+        int evictedBlocks = 0;
+        quint64 evictions = 0;
+        quint64 reloads = 0;
+    };
+
+    /*!
+     * Returns how many bytes the layout of the items may take, 0 if unlimited.
+     *
+     * \since 6.28
+     */
+    qsizetype layoutMemoryBudget() const;
+
+    /*!
+     * Sets how many bytes the layout of the items may take to \a bytes, 0 for unlimited, the
+     * default.
+     *
+     * Once the budget is exceeded, the blocks farthest from the viewport are evicted: only their
+     * height and the top and height of their rows are kept, and their items are measured and laid
+     * out again when they come back into view. Blocks in view are never evicted.
+     *
+     * Blocks whose items are all the same size take no memory per item, see
+     * KCategorizedSortFilterProxyModel::CategoryItemSizeRole.
+     *
+     * \sa layoutCacheStatistics()
+     *
+     * \since 6.28
+     */
+    void setLayoutMemoryBudget(qsizetype bytes);
+
+    /*!
+     * Returns how much memory the layout of the items takes, and how often blocks were evicted to
+     * stay in layoutMemoryBudget(). Meant for tuning the budget.
+     *
+     * \since 6.28
+     */
+    LayoutCacheStatistics layoutCacheStatistics() const;
+
+    /*!
+     * Makes this view use the layout of the items of \a view, so that each item is measured, and
+     * each model change processed, once for both of them. Pass nullptr to stop sharing it, this
+     * view then keeps a copy of the layout.
+     *
+     * Both views have to be categorized and show the same model, root index and model column,
+     * with the same view settings: grid size, spacing, icon size, font, flow, uniform item sizes
+     * and categoryRowLimit(), as well as the same kind of item delegate and category drawer. Returns false, and
+     * keeps the current layout, if they do not.
+     *
+     * Blocks collapsed in one of the views are collapsed in all of them, categories whose items are
+     * all shown with setShowAllRows() are shown in all of them, and layoutMemoryBudget()
+     * and layoutCacheStatistics() are shared too. A view stops sharing the layout on its own once
+     * one of the settings above changes, for instance when it is resized to another width, or
+     * once it hides rows with setRowHidden(), and starts sharing it again on its own once the
+     * settings match again. Views with hidden rows do not share their layout.
+     *
+     * \since 6.28
+     */
+    bool shareLayoutWith(KCategorizedView *view);
+
     /*!
      * Returns the block of indexes that are in \a category.
      *
+     * \note this creates an index for every item of the block. blockRange() and selectBlock()
+     *       do not.
+     *
      * \since 4.5
      */
     QModelIndexList block(const QString &category);
@@ -197,10 +561,98 @@ public:
      */
     QModelIndexList block(const QModelIndex &representative);
 
+    /*!
+     * \brief The rows of a block, and where its header is.
+     *
+     * The block holds the \a rowCount rows starting at \a firstRow, under rootIndex(), and its
+     * header is at \a headerRect, in viewport coordinates. \a firstRow is -1 and \a rowCount 0
+     * for a block that does not exist.
+     *
+     * \sa blockRange()
+     *
+     * \since 6.28
+     */
+    struct BlockRange {
+        int firstRow = -1;
+        int rowCount = 0;
+        QRect headerRect;
+    };
+
+    /*!
+     * Returns the rows of the block of \a category, and where its header is. Unlike block(), no
+     * index is created.
+     *
+     * Complexity: O(1), once the items are laid out.
+     *
+     * \since 6.28
+     */
+    BlockRange blockRange(const QString &category) const;
+
+    /*!
+     * Returns the rows of the block \a representative is in, and where its header is.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks, once the items are laid out.
+     *
+     * \since 6.28
+     */
+    BlockRange blockRange(const QModelIndex &representative) const;
+
+    /*!
+     * Selects the items of the block of \a category in the selection model of the view, with
+     * \a command, as a single QItemSelectionRange. Hidden items, and items capped by
+     * categoryRowLimit(), are left out, the items between hidden ones then make a range each.
+     *
+     * \since 6.28
+     */
+    void selectBlock(const QString &category, QItemSelectionModel::SelectionFlags command = QItemSelectionModel::ClearAndSelect);
+
+    /*!
+     * Selects the items of the block \a representative is in in the selection model of the view,
+     * with \a command, as a single QItemSelectionRange. Hidden items are left out, the same as
+     * for the other overload.
+     *
+     * \since 6.28
+     */
+    void selectBlock(const QModelIndex &representative, QItemSelectionModel::SelectionFlags command = QItemSelectionModel::ClearAndSelect);
+
+    /*!
+     * Returns the categories of the blocks, in the order they are shown. A category whose rows are
+     * not consecutive appears once for each of its blocks.
+     *
+     * Complexity: O(b) where b is the number of blocks.
+     *
+     * \since 6.28
+     */
+    QStringList categories() const;
+
+    /*!
+     * Returns the category of the block at \a y, in viewport coordinates, that is, of the last
+     * block whose header starts at or above \a y. Returns an empty string if there is none.
+     *
+     * Complexity: O(log(b)) where b is the number of blocks, once the items are laid out.
+     *
+     * \since 6.28
+     */
+    QString categoryAt(int y) const;
+
+    /*!
+     * Scrolls the view to the block of \a category, header included, as \a hint says.
+     *
+     * Only the position of the block is needed, its items are not laid out again if they were
+     * evicted, see setLayoutMemoryBudget().
+     *
+     * Complexity: O(1), once the items are laid out.
+     *
+     * \since 6.28
+     */
+    void scrollToCategory(const QString &category, ScrollHint hint = PositionAtTop);
+
     QModelIndex indexAt(const QPoint &point) const override;
 
     void reset() override;
 
+    void doItemsLayout() override;
+
 Q_SIGNALS:
 
     /*!
@@ -218,13 +670,65 @@ Q_SIGNALS:
      */
     void collapsibleBlocksChanged(bool enable);
 
+    /*!
+     * \since 6.28
+     */
+    void visibleRangeMarginChanged(int margin);
+
+    /*!
+     * \since 6.28
+     */
+    void fastScrollPaintingChanged(bool enable);
+
+    /*!
+     * \since 6.28
+     */
+    void groupedModelChanged(bool enable);
+
+    /*!
+     * \since 6.28
+     */
+    void keyboardSearchInBlockChanged(bool enable);
+
+    /*!
+     * \since 6.28
+     */
+    void scrollBarCategoryMarkersChanged(bool enable);
+
+    /*!
+     * \since 6.28
+     */
+    void categoryRowLimitChanged(int limit);
+
+    /*!
+     * Emitted when the items from \a first to \a last are the ones that are visible, extended by
+     * visibleRangeMargin() above and below the viewport. This happens after scrolling, resizing
+     * and laying out items again, at most once per frame.
+     *
+     * Models that load data lazily can connect to this signal to know which rows to prepare.
+     * Both indexes are invalid when no item is visible.
+     *
+     * \note this signal is only emitted while the view is categorized.
+     *
+     * \since 6.28
+     */
+    void visibleRangeChanged(const QModelIndex &first, const QModelIndex &last);
+
 protected:
     void paintEvent(QPaintEvent *event) override;
 
+    void showEvent(QShowEvent *event) override;
+
     void resizeEvent(QResizeEvent *event) override;
 
+    void changeEvent(QEvent *event) override;
+
+    void scrollContentsBy(int dx, int dy) override;
+
     void setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags flags) override;
 
+    QRegion visualRegionForSelection(const QItemSelection &selection) const override;
+
     void mouseMoveEvent(QMouseEvent *event) override;
 
     void mousePressEvent(QMouseEvent *event) override;
@@ -9,21 +9,75 @@
 #define KCATEGORIZEDVIEW_P_H
 
 #include "kcategorizedview.h"
+#include "kcategorizedlayoutengine_p.h"
 
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QRegion>
+#include <QSet>
+#include <QTimer>
+
+#include <memory>
+
+class KAsyncDecorationProvider;
 class KCategorizedSortFilterProxyModel;
 class KCategoryDrawer;
 class KCategoryDrawerV2;
 class KCategoryDrawerV3;
 
+class QPainter;
+class QScrollBar;
+
+class KCategorizedViewPrivate;
+
 /*!
  * \internal
+ *
+ * The blocks of one view, or of several views showing the same model with the same layout, see
+ * KCategorizedView::shareLayoutWith(). The first view processes the model changes for all of them,
+ * and lets the other ones know what to repaint.
  */
-class KCategorizedViewPrivate
+struct KCategorizedSharedLayout {
+    KCategorizedLayoutEngine engine;
+    // ids of the categories in the engine. Rows of a category that is not sorted together get
+    // blocks with ids of their own, which are not in here.
+    QHash<QString, int> categoryIds;
+    int nextCategoryId = 0;
+    // categories whose rows are all laid out whatever KCategorizedView::categoryRowLimit() is
+    QSet<QString> showAllCategories;
+    // the views using this layout, in the order they started to
+    QList<KCategorizedViewPrivate *> views;
+    // the views that stopped using this layout on their own, because their settings changed. They
+    // use it again once their settings match again.
+    QList<KCategorizedViewPrivate *> formerViews;
+};
+
+/*!
+ * \internal
+ *
+ * Draws a tick on the vertical scroll bar of a KCategorizedView where each category starts. It
+ * covers the scroll bar, and lets mouse events through.
+ */
+class KCategorizedScrollBarMarkers : public QWidget
 {
 public:
-    struct Block;
-    struct Item;
+    KCategorizedScrollBarMarkers(KCategorizedViewPrivate *view, QScrollBar *scrollBar);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    KCategorizedViewPrivate *const m_view;
+    QScrollBar *const m_scrollBar;
+};
 
+/*!
+ * \internal
+ */
+class KCategorizedViewPrivate
+{
+public:
     explicit KCategorizedViewPrivate(KCategorizedView *qq);
     ~KCategorizedViewPrivate();
 
@@ -32,6 +86,12 @@ public:
      */
     bool isCategorized() const;
 
+    /*!
+     * Returns the column the category of the items is asked for: the sort column of a
+     * KCategorizedSortFilterProxyModel, or the model column of the view for a grouped model.
+     */
+    int categoryColumn() const;
+
     /*!
      * Wrapper that returns the view's QStyleOptionViewItem, in Qt5 using viewOptions(), and
      * in Qt6 using initViewItemOption().
@@ -39,32 +99,135 @@ public:
     QStyleOptionViewItem viewOpts();
 
     /*!
-     * Returns the block rect for the representative \a representative.
+     * Returns the size hint of \a index. Same as QAbstractItemView::sizeHintForIndex(), except
+     * that space is reserved for the decoration when a decoration provider is set.
      */
-    QStyleOptionViewItem blockRect(const QModelIndex &representative);
+    QSize itemSizeHint(const QModelIndex &index) const;
 
     /*!
-     * Returns the first and last element that intersects with rect.
-     *
-     * \note see that here we cannot take out items between first and last (as we could
-     *       do with the rubberband).
-     *
-     * Complexity: O(log(n)) where n is model()->rowCount().
+     * Passes the decoration of \a index from the decoration provider in \a option, requesting it
+     * if it is not loaded yet.
      */
-    std::pair<QModelIndex, QModelIndex> intersectingIndexesWithRect(const QRect &rect) const;
+    void initDecorationOption(QStyleOptionViewItem *option, const QModelIndex &index) const;
 
     /*!
-     * Returns the position of the block of \a category.
-     *
-     * Complexity: O(n) where n is the number of different categories when the block has been
-     *             marked as in quarantine. O(1) the rest of the times (the vast majority).
+     * Returns the view that processes the model changes for all views sharing our layout. That
+     * is us if we do not share it.
+     */
+    KCategorizedViewPrivate *layoutLeader() const;
+
+    /*!
+     * Returns whether we process the model changes for all views sharing our layout.
+     */
+    bool isLayoutLeader() const;
+
+    /*!
+     * Returns whether any of the views sharing our layout is visible.
+     */
+    bool isLayoutVisible() const;
+
+    /*!
+     * Returns whether we can share the layout of \a other: same model, root and column, same
+     * layout params and same settings the size of the items depends on.
+     */
+    bool isLayoutCompatibleWith(const KCategorizedViewPrivate *other) const;
+
+    /*!
+     * Sets the engine functions of our layout to ask us for sizes and header heights.
      */
-    QPoint blockPosition(const QString &category);
+    void installLayoutFunctions();
 
     /*!
-     * Returns the height of the block determined by \a category.
+     * Starts using \a layout, leaving the one we used so far. If we were processing the model
+     * changes for other views, the next one takes over.
      */
-    int blockHeight(const QString &category);
+    void setLayout(const std::shared_ptr<KCategorizedSharedLayout> &layout);
+
+    /*!
+     * Stops sharing our layout, keeping a copy of it so that no item has to be measured again.
+     */
+    void leaveLayout();
+
+    /*!
+     * Leaves the layout we share if our settings do not match the ones of the other views anymore,
+     * or shares the layout we left again if they match again. Views that left our layout are
+     * checked too. Called where those settings change, never while painting.
+     */
+    void checkLayoutSharing();
+
+    /*!
+     * Shares the layout we left because of our settings again, if they match the ones of its views
+     * again. Returns whether we did.
+     */
+    bool rejoinFormerLayout();
+
+    /*!
+     * Stops waiting for our settings to match the ones of the layout we left.
+     */
+    void forgetFormerLayout();
+
+    /*!
+     * Lets the other views sharing our layout know that the items from \a firstRow down moved,
+     * or all of them if \a firstRow is -1.
+     */
+    void notifyLayoutFollowers(int firstRow);
+
+    /*!
+     * Returns the rows of \a block and the rect of its header, or an empty range if \a block is
+     * -1.
+     */
+    KCategorizedView::BlockRange blockRange(int block);
+
+    /*!
+     * Selects the rows of \a range with \a command, as a single selection range.
+     */
+    void selectBlock(const KCategorizedView::BlockRange &range, QItemSelectionModel::SelectionFlags command);
+
+    /*!
+     * Returns the rect of \a block, header included, in viewport terms.
+     */
+    QStyleOptionViewItem blockRect(int block);
+
+    /*!
+     * Returns the rect of the header of \a block, in viewport terms. This is the part of the block
+     * that changes when the mouse hovers it.
+     */
+    QRect categoryHeaderRect(int block);
+
+    /*!
+     * Returns the index the category drawer draws the header of \a block for.
+     */
+    QModelIndex categoryIndex(int block) const;
+
+    /*!
+     * Returns the id \a category is known by to the layout engine, making one up if it has none.
+     */
+    int categoryId(const QString &category);
+
+    /*!
+     * Returns the block of \a category, or -1 if there is none.
+     */
+    int blockForCategory(const QString &category) const;
+
+    /*!
+     * Repaints the viewport from the position of \a row down to its bottom, which is the area
+     * that changes when rows get inserted or removed at \a row. If the header of the block starts
+     * at \a row, it gets repainted too. Nothing is repainted if that area is not visible.
+     */
+    void updateFromRow(int row);
+
+    /*!
+     * Returns the rows of the items whose rect intersects \a rect, in viewport terms, as runs of
+     * consecutive rows in model order. See KCategorizedLayoutEngine::findRows().
+     */
+    QList<KCategorizedLayoutEngine::RowSpan> intersectingRows(const QRect &rect);
+
+    /*!
+     * Returns the first and last element that intersects with rect.
+     *
+     * Complexity: same as intersectingRows().
+     */
+    std::pair<QModelIndex, QModelIndex> intersectingIndexesWithRect(const QRect &rect);
 
     /*!
      * Returns the actual viewport width.
@@ -72,7 +235,7 @@ public:
     int viewportWidth() const;
 
     /*!
-     * Marks all elements as in quarantine.
+     * Makes the layout engine ask for the size of every item again.
      *
      * Complexity: O(n) where n is model()->rowCount().
      *
@@ -80,29 +243,219 @@ public:
      */
     void regenerateAllElements();
 
+    /*!
+     * Lays out the items again for the current width of the viewport and settings of the view,
+     * keeping the sizes of the items the layout engine already knows.
+     *
+     * Complexity: O(b) where b is the number of blocks, until the changes are applied.
+     */
+    void updateLayoutParams();
+
     /*!
      * Update internal information, and keep sync with the real information that the model contains.
      */
     void rowsInserted(const QModelIndex &parent, int start, int end);
 
     /*!
-     * Returns \a rect in viewport terms, taking in count horizontal and vertical offsets.
+     * Throws away all blocks and creates them again from the model, computing the position of
+     * every item in model order.
+     *
+     * Complexity: O(n) where n is model()->rowCount().
      */
-    QRect mapToViewport(const QRect &rect) const;
+    void rebuildBlocks();
 
     /*!
-     * Returns \a rect in absolute terms, converted from viewport position.
+     * Forgets the model changes recorded so far, and everything cached about the rows.
      */
-    QRect mapFromViewport(const QRect &rect) const;
+    void resetPendingChanges();
+
+    /*!
+     * Returns what the snapshots of the layout depend on, besides the data of the model: the row
+     * count, the columns and the settings the size of the items depends on.
+     *
+     * The value is saved in the snapshots, so it is part of their format: a 64 bit FNV-1a hash of
+     * the fields in a fixed order, integers in little endian and strings in UTF-8, which does not
+     * change with the Qt version or the platform.
+     */
+    quint64 layoutFingerprint() const;
+
+    /*!
+     * Replaces the blocks with the ones saved in \a snapshot, without asking the model for the
+     * category or size of any item. The categories of the blocks are checked against the model a
+     * few blocks at a time afterwards, see validateRestoredBlocks().
+     *
+     * Complexity: O(n) where n is model()->rowCount().
+     */
+    bool restoreLayoutSnapshot(const QByteArray &snapshot);
+
+    /*!
+     * Hides the rows of hiddenRows in the layout engine, whose blocks were just rebuilt or
+     * restored, and forgets the ones that are gone.
+     */
+    void applyHiddenRows();
+
+    /*!
+     * Tells the layout engine how many rows of each block to lay out, after its blocks were just
+     * rebuilt or restored.
+     */
+    void applyRowLimits();
+
+    /*!
+     * Lays out the blocks again from \a firstRow on, right away, after the number of rows laid out
+     * in some of them changed. This is something the user asked for, so unlike model changes it
+     * is not delayed until the view gets back to the event loop.
+     */
+    void rowLimitChanged(int firstRow);
+
+    /*!
+     * Checks that the first and last rows of the next few restored blocks still have the category
+     * they had when the snapshot was saved, and rebuilds all blocks if one does not.
+     */
+    void validateRestoredBlocks();
+
+    /*!
+     * Builds the index keyboardSearch() looks in, unless it is up to date.
+     *
+     * Complexity: O(n * log(n)) where n is model()->rowCount(), when built.
+     */
+    void ensureSearchIndex();
+
+    /*!
+     * Forgets the index keyboardSearch() looks in, so that it is built again when needed.
+     */
+    void invalidateSearchIndex();
+
+    /*!
+     * Returns the first enabled row from \a start on whose display text starts with \a prefix,
+     * ignoring case. Only rows from \a first to \a end, exclusive, are looked at, and the search
+     * wraps around from the last one to \a first. Returns -1 if no row matches.
+     *
+     * Complexity: O(log(n) + k) where n is model()->rowCount() and k the number of rows whose
+     *             display text starts with \a prefix.
+     */
+    int findSearchMatch(const QString &prefix, int start, int first, int end);
+
+    /*!
+     * Returns whether an editor, persistent or not, or an index widget is open on one of the items
+     * from \a topLeft to \a bottomRight.
+     *
+     * Complexity: O(1) when the viewport has no child widget, O(k) where k is the number of rows
+     * otherwise.
+     */
+    bool hasEditorInRange(const QModelIndex &topLeft, const QModelIndex &bottomRight) const;
+
+    /*!
+     * Returns whether model changes should only be recorded instead of being processed. This is
+     * the case while the view is not visible, or when a rebuild is already pending.
+     */
+    bool isDormant() const;
+
+    /*!
+     * Records that the blocks are out of sync with the model and have to be rebuilt before they
+     * are used again.
+     */
+    void markRelayoutPending();
+
+    /*!
+     * Records a structural change of \a delta rows starting at \a start, after which the model
+     * will contain \a rowCount rows. \a delta is positive for insertions and negative for removals.
+     * Recorded changes are applied all at once by applyPendingChanges() before the next paint.
+     *
+     * Returns whether the change should be patched into the blocks. If false is returned, patching
+     * would be more expensive than rebuilding all blocks, and a rebuild has been scheduled instead.
+     * Views that are not the layout leader always return false, the leader patches the blocks.
+     */
+    bool recordStructuralChange(int start, int delta, int rowCount);
 
     /*!
-     * Returns the height of the highest element in last row. This is only applicable if there is
-     * no grid set and uniformItemSizes is false.
+     * Makes sure applyPendingChanges() gets called on the next event loop iteration.
+     */
+    void scheduleApplyPendingChanges();
+
+    /*!
+     * Returns whether there are model changes that have not been applied to the blocks yet.
+     */
+    bool hasPendingChanges() const;
+
+    /*!
+     * Brings the blocks in sync with all changes recorded since the last call. Depending on what
+     * has been recorded, this either rebuilds all blocks, or it lets the layout engine position
+     * again the items and blocks below the first changed row.
      *
-     * \a block in which block are we searching. Necessary to stop the search if we hit the
-     *              first item in this block.
+     * Complexity: O(n) where n is model()->rowCount() when rebuilding. O(b + m) otherwise, where
+     *             b is the number of blocks and m the number of items whose size changed.
      */
-    int highestElementInLastRow(const Block &block) const;
+    void applyPendingChanges();
+
+    /*!
+     * Records that the data of rows \a first to \a last changed for \a roles. Changes are
+     * accumulated and flushed by flushDataChanges() at most once per display frame.
+     */
+    void recordDataChange(int first, int last, const QList<int> &roles);
+
+    /*!
+     * Repositions the items whose size might have changed since the last call, and repaints the
+     * visible items whose data changed.
+     */
+    void flushDataChanges();
+
+    /*!
+     * Returns the time between two frames of the screen the view is on, in milliseconds.
+     */
+    int frameInterval() const;
+
+    /*!
+     * Makes sure the visible range gets computed again on the next frame.
+     */
+    void scheduleVisibleRangeUpdate();
+
+    /*!
+     * Estimates the scroll velocity from the vertical offset, and switches to painting skeletons
+     * while it is high.
+     */
+    void trackScrollVelocity();
+
+    /*!
+     * Leaves the fast scrolling state, and repaints the viewport with full quality.
+     */
+    void scrollSettled();
+
+    /*!
+     * Paints a cheap approximation of \a index: the background of the item, its cached decoration
+     * or a flat rect, and its elided text from elidedTextCache.
+     */
+    void paintSkeleton(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index);
+
+    /*!
+     * Tells the layout engine what all views sharing the layout show, extended by
+     * visibleRangeMargin, so that it never evicts those blocks. Called whenever that changes:
+     * when a view is shown, resized or scrolled, and before painting.
+     */
+    void updateEngineVisibleRect();
+
+    /*!
+     * Computes the range of visible items, extended by visibleRangeMargin, and emits
+     * KCategorizedView::visibleRangeChanged() if it is not the one we reported last time.
+     *
+     * Complexity: O(log(n)) where n is model()->rowCount().
+     */
+    void updateVisibleRange();
+
+    /*!
+     * Calls fetchMore() on the model if it can provide more rows and the viewport is getting
+     * close to the end of the laid out items.
+     */
+    void fetchMoreIfNeeded();
+
+    /*!
+     * Returns \a rect in viewport terms, taking in count horizontal and vertical offsets.
+     */
+    QRect mapToViewport(const QRect &rect) const;
+
+    /*!
+     * Returns \a rect in absolute terms, converted from viewport position.
+     */
+    QRect mapFromViewport(const QRect &rect) const;
 
     /*!
      * Returns whether the view has a valid grid size.
@@ -115,15 +468,9 @@ public:
     QString categoryForIndex(const QModelIndex &index) const;
 
     /*!
-     * Updates the visual rect for item when flow is LeftToRight.
-     */
-    void leftToRightVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const;
-
-    /*!
-     * Updates the visual rect for item when flow is TopToBottom.
-     * \note we only support viewMode == ListMode in this case.
+     * Returns what the layout of the items depends on, as configured on the view right now.
      */
-    void topToBottomVisualRect(const QModelIndex &index, Item &item, const Block &block, const QPoint &blockPos) const;
+    KCategorizedLayout::Params layoutParams() const;
 
     /*!
      * Called when expand or collapse has been clicked on the category drawer.
@@ -131,20 +478,97 @@ public:
     void _k_slotCollapseOrExpandClicked(QModelIndex);
 
     KCategorizedView *const q;
+    // the model of the view, and the same model if it is a KCategorizedSortFilterProxyModel
+    QAbstractItemModel *model = nullptr;
     KCategorizedSortFilterProxyModel *proxyModel = nullptr;
+    bool groupedModel = false;
     KCategoryDrawer *categoryDrawer = nullptr;
     int categorySpacing = 0;
     bool alternatingBlockColors = false;
     bool collapsibleBlocks = false;
 
-    Block *const hoveredBlock;
-    QString hoveredCategory;
+    // the block whose header the mouse is over, -1 if none
+    int hoveredBlock = -1;
     QModelIndex hoveredIndex;
 
     QPoint pressedPosition;
     QRect rubberBandRect;
 
-    QHash<QString, Block> blocks;
+    // shared with other views by KCategorizedView::shareLayoutWith()
+    std::shared_ptr<KCategorizedSharedLayout> layout;
+    // the layout we stopped sharing because our settings changed, to share again once they match
+    std::weak_ptr<KCategorizedSharedLayout> formerLayout;
+
+    // the category of every block restored from a snapshot, while they are being checked against
+    // the model
+    QStringList restoredCategories;
+    int validatedBlocks = 0;
+    QTimer validationTimer;
+
+    // the case folded display text of every row, with the row, sorted. Built for the root index
+    // and column below when keyboardSearch() first needs it.
+    QList<std::pair<QString, int>> searchIndex;
+    bool searchIndexValid = false;
+    QPersistentModelIndex searchIndexRoot;
+    int searchIndexColumn = 0;
+    // what was typed so far for keyboardSearch(), and when
+    QString keyboardInput;
+    QElapsedTimer keyboardInputTime;
+    bool keyboardSearchInBlock = false;
+
+    QPointer<KCategorizedScrollBarMarkers> scrollBarMarkers;
+
+    // rows hidden with KCategorizedView::setRowHidden(). The layout engine knows about them
+    // too, this is what it is told again once the blocks are rebuilt or restored. Hashed, since
+    // hiding many rows one by one would otherwise be quadratic.
+    QSet<QPersistentModelIndex> hiddenRows;
+
+    int categoryRowLimit = 0;
+
+    // set when model changes arrived while the view was dormant. blocks are not reliable then.
+    // This and the structural changes below are only used by the layout leader.
+    bool relayoutPending = false;
+
+    // structural changes recorded since the last call to applyPendingChanges()
+    int firstPendingRow = -1;
+    int pendingChangedRows = 0;
+    // the row count the model will have once the recorded changes have been carried out. Between
+    // rowsAboutToBeRemoved() and the actual removal the model does not match our blocks yet.
+    int pendingRowCount = -1;
+    bool applyPendingChangesQueued = false;
+
+    // rows whose data changed since the last call to flushDataChanges(), as [first, last] intervals
+    QList<std::pair<int, int>> changedGeometryRows;
+    QList<std::pair<int, int>> changedPaintRows;
+    QTimer dataChangedTimer;
+
+    int visibleRangeMargin = 0;
+    // the range last reported by KCategorizedView::visibleRangeChanged()
+    int visibleFirstRow = -1;
+    int visibleLastRow = -1;
+    QTimer visibleRangeTimer;
+
+    QPointer<KAsyncDecorationProvider> decorationProvider;
+
+    bool fastScrollPainting = false;
+    // set while the view is being scrolled fast enough to paint skeletons
+    bool fastScrolling = false;
+    int lastScrollOffset = 0;
+    // smoothed scroll velocity, in pixels per millisecond
+    qreal scrollVelocity = 0;
+    QElapsedTimer scrollClock;
+    QTimer scrollSettleTimer;
+
+    struct ElidedText {
+        QString text;
+        int width;
+    };
+    // elided display texts of skeletons by row, cleared whenever rows or their data change
+    QHash<int, ElidedText> elidedTextCache;
+    QFont elidedTextFont;
+
+    // items painted as skeletons because the paint time budget ran out, in viewport terms
+    QRegion deferredRegion;
 };
 
 #endif // KCATEGORIZEDVIEW_P_H
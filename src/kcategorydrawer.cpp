@@ -9,6 +9,7 @@
 #include "kcategorydrawer.h"
 
 #include <QApplication>
+#include <QMouseEvent>
 #include <QPainter>
 #include <QStyleOption>
 
@@ -29,7 +30,80 @@ public:
     {
     }
 
+    // around the category name, after Kirigami.Units.largeSpacing and smallSpacing
+    static constexpr int sidePadding = 8;
+    static constexpr int topPadding = 8 + 4;
+
+    /*!
+     * Returns the font the category name is drawn with.
+     */
+    static QFont nameFont()
+    {
+        QFont font(QApplication::font());
+        font.setBold(true);
+        return font;
+    }
+
+    /*!
+     * Returns where the header of the block at \a blockRect draws the name of the category of
+     * \a index, and sets \a category to that name. The rect is as wide as the name.
+     */
+    static QRect nameRect(const QModelIndex &index, const QRect &blockRect, QString *category = nullptr)
+    {
+        const QString name = index.data(KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
+        if (category) {
+            *category = name;
+        }
+        const QFontMetrics fontMetrics(nameFont());
+        return QRect(blockRect.left() + sidePadding, blockRect.top() + topPadding, fontMetrics.horizontalAdvance(name), fontMetrics.height());
+    }
+
+    /*!
+     * Returns where the header of the block at \a blockRect offers to show the items of the
+     * category of \a index that are capped by KCategorizedView::categoryRowLimit(), and sets
+     * \a text to what it says. The link is right of the category name, and elided when the block
+     * is too narrow for both. Returns an invalid rect if no item is capped or the link does not fit.
+     */
+    QRect showAllRect(const QModelIndex &index, const QRect &blockRect, QString *text = nullptr) const
+    {
+        const int cappedRowCount = view ? view->cappedRowCount(index) : 0;
+        if (!cappedRowCount) {
+            return QRect();
+        }
+
+        // on the line of the category name
+        const QRect name = nameRect(index, blockRect);
+        const int left = name.right() + 1 + sidePadding;
+        const int available = blockRect.right() - sidePadding - left;
+
+        const QFontMetrics fontMetrics(QApplication::font());
+        QString label = KCategoryDrawer::tr("Show all (%n more)", "@action:button", cappedRowCount);
+        if (fontMetrics.horizontalAdvance(label) > available) {
+            label = fontMetrics.elidedText(label, Qt::ElideRight, qMax(0, available));
+            if (label.isEmpty()) {
+                return QRect();
+            }
+        }
+        const int width = fontMetrics.horizontalAdvance(label);
+        if (text) {
+            *text = label;
+        }
+        return QRect(blockRect.right() - sidePadding - width, name.top(), width, fontMetrics.height());
+    }
+
+    /*!
+     * Returns whether \a pos is on the show all link of the block at \a blockRect. Only links
+     * KCategoryDrawer::drawCategory() has drawn count, subclasses drawing their headers on their
+     * own do not get clicks on a link they do not show.
+     */
+    bool isOnShowAllLink(const QModelIndex &index, const QRect &blockRect, const QPoint &pos) const
+    {
+        return drawsShowAllLinks && showAllRect(index, blockRect).contains(pos);
+    }
+
     KCategorizedView *const view;
+    // whether the headers are drawn by KCategoryDrawer::drawCategory(), with their show all link
+    mutable bool drawsShowAllLinks = false;
 };
 
 KCategoryDrawer::KCategoryDrawer(KCategorizedView *view)
@@ -45,21 +119,18 @@ void KCategoryDrawer::drawCategory(const QModelIndex &index, int /*sortRole*/, c
     // Keep this in sync with Kirigami.ListSectionHeader
     painter->setRenderHint(QPainter::Antialiasing);
 
-    const QString category = index.model()->data(index, KCategorizedSortFilterProxyModel::CategoryDisplayRole).toString();
-    QFont font(QApplication::font());
-    font.setBold(true);
-    const QFontMetrics fontMetrics = QFontMetrics(font);
+    d->drawsShowAllLinks = true;
 
-    const int topPadding = 8 + 4; // Kirigami.Units.largeSpacing + smallSpacing
-    const int sidePadding = 8; // Kirigami.Units.largeSpacing
+    QString category;
+    const QRect nameRect = KCategoryDrawerPrivate::nameRect(index, option.rect, &category);
+    const QFont font = KCategoryDrawerPrivate::nameFont();
+    const QFontMetrics fontMetrics = QFontMetrics(font);
+    const int sidePadding = KCategoryDrawerPrivate::sidePadding;
 
     // BEGIN: text
     {
-        QRect textRect(option.rect);
-        textRect.setTop(textRect.top() + topPadding);
-        textRect.setLeft(textRect.left() + sidePadding);
-        textRect.setRight(textRect.right() - sidePadding);
-        textRect.setHeight(fontMetrics.height());
+        QRect textRect(nameRect);
+        textRect.setRight(option.rect.right() - sidePadding);
 
         painter->save();
         painter->setFont(font);
@@ -71,20 +142,35 @@ void KCategoryDrawer::drawCategory(const QModelIndex &index, int /*sortRole*/, c
     }
     // END: text
 
+    // BEGIN: show all link
+    QString showAllText;
+    const QRect showAllRect = d->showAllRect(index, option.rect, &showAllText);
+    if (showAllRect.isValid()) {
+        painter->save();
+        painter->setFont(QApplication::font());
+        painter->setPen(option.palette.link().color());
+        painter->drawText(showAllRect, Qt::AlignRight | Qt::AlignVCenter, showAllText);
+        painter->restore();
+    }
+    // END: show all link
+
     // BEGIN: horizontal line
     {
         QColor backgroundColor = option.palette.text().color();
         backgroundColor.setAlphaF(0.7 * 0.15); // replicate Kirigami.Separator color
         QRect backgroundRect(option.rect);
         backgroundRect.setLeft(fontMetrics.horizontalAdvance(category) + sidePadding * 2);
-        backgroundRect.setRight(backgroundRect.right() - sidePadding);
-        backgroundRect.setTop(backgroundRect.top() + topPadding + ceil(fontMetrics.height() / 2));
+        backgroundRect.setRight((showAllRect.isValid() ? showAllRect.left() : backgroundRect.right()) - sidePadding);
+        backgroundRect.setTop(nameRect.top() + ceil(fontMetrics.height() / 2));
         backgroundRect.setHeight(1);
-        painter->save();
-        painter->setBrush(backgroundColor);
-        painter->setPen(Qt::NoPen);
-        painter->drawRect(backgroundRect);
-        painter->restore();
+        // no room left between the name and the show all link
+        if (backgroundRect.width() > 0) {
+            painter->save();
+            painter->setBrush(backgroundColor);
+            painter->setPen(Qt::NoPen);
+            painter->drawRect(backgroundRect);
+            painter->restore();
+        }
     }
     // END: horizontal line
 }
@@ -116,13 +202,22 @@ KCategorizedView *KCategoryDrawer::view() const
     return d->view;
 }
 
-void KCategoryDrawer::mouseButtonPressed(const QModelIndex &, const QRect &, QMouseEvent *event)
+void KCategoryDrawer::mouseButtonPressed(const QModelIndex &index, const QRect &blockRect, QMouseEvent *event)
 {
+    if (event->button() == Qt::LeftButton && d->isOnShowAllLink(index, blockRect, event->pos())) {
+        event->accept();
+        return;
+    }
     event->ignore();
 }
 
-void KCategoryDrawer::mouseButtonReleased(const QModelIndex &, const QRect &, QMouseEvent *event)
+void KCategoryDrawer::mouseButtonReleased(const QModelIndex &index, const QRect &blockRect, QMouseEvent *event)
 {
+    if (event->button() == Qt::LeftButton && d->isOnShowAllLink(index, blockRect, event->pos())) {
+        event->accept();
+        view()->setShowAllRows(index, true);
+        return;
+    }
     event->ignore();
 }
 
@@ -29,6 +29,11 @@ class KCategorizedView;
  * \brief The category drawing is performed by this class.
  *
  * It also gives information about the category height and margins.
+ *
+ * When KCategorizedView::categoryRowLimit() caps a category, the header drawCategory() draws
+ * offers to show all its rows, and mouseButtonReleased() shows them when that link is clicked.
+ * Subclasses that draw their headers without calling drawCategory() do not get that link, nor
+ * its clicks, and call KCategorizedView::setShowAllRows() themselves.
  */
 class KITEMVIEWS_EXPORT KCategoryDrawer : public QObject
 {
@@ -0,0 +1,72 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KITEMDATACHANGE_P_H
+#define KITEMDATACHANGE_P_H
+
+#include <QList>
+
+#include <algorithm>
+
+/*!
+ * \internal
+ *
+ * What changes of the data of an item affect, so that the views and delegates caching what they
+ * know about items agree on what to forget when QAbstractItemModel::dataChanged() is emitted.
+ */
+namespace KItemDataChange
+{
+enum class Effect {
+    // tool tips and alike are neither painted nor take space
+    None,
+    // colors do not take space
+    Painting,
+    Geometry,
+};
+
+/*!
+ * Returns what a change of the data of \a role affects.
+ */
+inline Effect effectOf(int role)
+{
+    switch (role) {
+    case Qt::ToolTipRole:
+    case Qt::StatusTipRole:
+    case Qt::WhatsThisRole:
+    case Qt::AccessibleTextRole:
+    case Qt::AccessibleDescriptionRole:
+        return Effect::None;
+    case Qt::ForegroundRole:
+    case Qt::BackgroundRole:
+        return Effect::Painting;
+    default:
+        return Effect::Geometry;
+    }
+}
+
+/*!
+ * Returns what a change of the data of \a roles affects, the most any of them does. An empty list
+ * means all roles, as in QAbstractItemModel::dataChanged().
+ */
+inline Effect effectOf(const QList<int> &roles)
+{
+    if (roles.isEmpty()) {
+        return Effect::Geometry;
+    }
+
+    Effect effect = Effect::None;
+    for (const int role : roles) {
+        effect = std::max(effect, effectOf(role));
+        if (effect == Effect::Geometry) {
+            break;
+        }
+    }
+    return effect;
+}
+}
+
+#endif // KITEMDATACHANGE_P_H